@@ -0,0 +1,234 @@
+﻿#include "MappedSaveFile.h"
+#include "SavePageStore.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/MemoryReader.h"
+
+
+namespace
+{
+	/**
+	 * \brief The process-wide registry of mapped save files, keyed by file path. Guarded by GetMappedSaveFilesLock.
+	 */
+	TMap<FString, TSharedPtr<FMappedSaveFile>>& GetMappedSaveFiles()
+	{
+		static TMap<FString, TSharedPtr<FMappedSaveFile>> MappedSaveFiles;
+		return MappedSaveFiles;
+	}
+
+	/**
+	 * \brief Guards the registry, which is used for different files from several threads at once. Never held while a file is mapped.
+	 */
+	FCriticalSection& GetMappedSaveFilesLock()
+	{
+		static FCriticalSection MappedSaveFilesLock;
+		return MappedSaveFilesLock;
+	}
+}
+
+
+FMappedSaveFile::~FMappedSaveFile()
+{
+	// The region has to be unmapped before its file handle is closed
+	MappedRegion.Reset();
+	MappedHandle.Reset();
+}
+
+TSharedPtr<FMappedSaveFile> FMappedSaveFile::Map(const FString& SaveFilePath)
+{
+	if (TSharedPtr<FMappedSaveFile> MappedFile = Find(SaveFilePath))
+	{
+		return MappedFile;
+	}
+
+	TSharedPtr<FMappedSaveFile> MappedFile = Open(SaveFilePath);
+	if (!MappedFile)
+	{
+		return nullptr;
+	}
+
+	// Another thread may have mapped the same file meanwhile, the first mapping registered is kept
+	FScopeLock Lock(&GetMappedSaveFilesLock());
+	if (const TSharedPtr<FMappedSaveFile>* RegisteredFile = GetMappedSaveFiles().Find(SaveFilePath))
+	{
+		return *RegisteredFile;
+	}
+
+	GetMappedSaveFiles().Add(SaveFilePath, MappedFile);
+	return MappedFile;
+}
+
+TSharedPtr<FMappedSaveFile> FMappedSaveFile::Find(const FString& SaveFilePath)
+{
+	FScopeLock Lock(&GetMappedSaveFilesLock());
+	const TSharedPtr<FMappedSaveFile>* MappedFile = GetMappedSaveFiles().Find(SaveFilePath);
+	return MappedFile ? *MappedFile : nullptr;
+}
+
+void FMappedSaveFile::Release(const FString& SaveFilePath)
+{
+	// The mapping itself is only closed once the last reference to it is dropped, outside the lock
+	TSharedPtr<FMappedSaveFile> MappedFile;
+	FScopeLock Lock(&GetMappedSaveFilesLock());
+	GetMappedSaveFiles().RemoveAndCopyValue(SaveFilePath, MappedFile);
+}
+
+bool FMappedSaveFile::FindEntry(FSaveKeyView Key, TConstArrayView<uint8>& OutData, EDataType& OutDataType) const
+{
+	const FSaveIndexEntry* Entry = Index.Find(Key);
+	if (!Entry)
+	{
+		return false; // Data not found
+	}
+
+	if (!Entry->IsStoredRaw())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Compressed or compactly encoded save file entries cannot be viewed in place: %s"), *Entry->Key);
+		return false;
+	}
+
+	return FindStoredPayload(*Entry, OutData, OutDataType);
+}
+
+bool FMappedSaveFile::FindEntry(FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType) const
+{
+	const FSaveIndexEntry* Entry = Index.Find(Key);
+	TConstArrayView<uint8> StoredData;
+	if (!Entry || !FindStoredPayload(*Entry, StoredData, OutDataType))
+	{
+		return false; // Data not found
+	}
+
+	return FSaveFileFormat::DecodePayload(*Entry, StoredData, OutData);
+}
+
+bool FMappedSaveFile::FindPinnedEntry(FSaveKeyView Key, FSaveDataView& OutView, bool bKeepCompactEncoding) const
+{
+	const FSaveIndexEntry* Entry = Index.Find(Key);
+	TConstArrayView<uint8> StoredData;
+	if (!Entry || !FindStoredPayload(*Entry, StoredData, OutView.DataType))
+	{
+		return false; // Data not found
+	}
+
+	OutView.bCompactEncoded = bKeepCompactEncoding && Entry->IsCompactEncoded();
+	if (OutView.bCompactEncoded && Entry->IsCompressed())
+	{
+		TSharedRef<TArray<uint8>> Buffer = MakeShared<TArray<uint8>>();
+		if (!FSaveFileFormat::DecompressPayload(*Entry, StoredData, *Buffer, nullptr))
+		{
+			return false;
+		}
+
+		OutView.SetBuffer(Buffer, Entry->DataType);
+		return true;
+	}
+
+	if (!Entry->IsStoredRaw() && !OutView.bCompactEncoded)
+	{
+		TSharedRef<TArray<uint8>> Buffer = MakeShared<TArray<uint8>>();
+		if (!FSaveFileFormat::DecodePayload(*Entry, StoredData, *Buffer))
+		{
+			return false;
+		}
+
+		OutView.SetBuffer(Buffer, Entry->DataType);
+		return true;
+	}
+
+	// A held mapping would make every later write to the file fail, the payload is copied out instead
+	if (!CanPinMapping())
+	{
+		OutView.SetBuffer(MakeShared<TArray<uint8>>(StoredData), Entry->DataType);
+		return true;
+	}
+
+	// Point straight into the mapping and keep it alive, even if it is released from the registry
+	OutView.Data = StoredData;
+	OutView.MappedFile = AsShared();
+	return true;
+}
+
+void FMappedSaveFile::FindByPrefix(const FString& Prefix, TArray<const FSaveIndexEntry*>& OutEntries)
+{
+	// Files that are only looked up by key never pay for the sort. Every query takes the lock, so none reads the keys while another one sorts them
+	FScopeLock Lock(&SortLock);
+	if (!Index.bKeysSorted)
+	{
+		Index.SortKeys();
+	}
+
+	Index.FindByPrefix(Prefix, OutEntries);
+}
+
+bool FMappedSaveFile::FindStoredPayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8>& OutData, EDataType& OutDataType) const
+{
+	if (Entry.DataSize < 0 || Entry.DataOffset < FSaveFileHeader::MinSerializedSize || Entry.DataOffset + Entry.DataSize > FileData.Num())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	OutData = FileData.Slice(static_cast<int32>(Entry.DataOffset), Entry.DataSize);
+	OutDataType = Entry.DataType;
+	return true;
+}
+
+TSharedPtr<FMappedSaveFile> FMappedSaveFile::Open(const FString& SaveFilePath)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	TSharedPtr<FMappedSaveFile> MappedFile = MakeShareable(new FMappedSaveFile());
+	MappedFile->MappedHandle.Reset(PlatformFile.OpenMapped(*SaveFilePath));
+	if (!MappedFile->MappedHandle)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to map file: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	const int64 FileSize = MappedFile->MappedHandle->GetFileSize();
+	if (FileSize < FSaveFileHeader::MinSerializedSize)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Only indexed save files can be mapped: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	if (FileSize > MAX_int32)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Save file is too large to be mapped: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	MappedFile->MappedRegion.Reset(MappedFile->MappedHandle->MapRegion(0, FileSize));
+	if (!MappedFile->MappedRegion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to map file: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	MappedFile->FileData = MakeArrayView(MappedFile->MappedRegion->GetMappedPtr(), static_cast<int32>(MappedFile->MappedRegion->GetMappedSize()));
+
+	// Parse the index straight out of the mapping, once for the lifetime of the mapping
+	FMemoryReaderView MemoryReader(MappedFile->FileData, true);
+	if (FSavePageStore::IsPageStore(MemoryReader))
+	{
+		// The pages of a page store are scattered through the file, there is no contiguous save file to view
+		UE_LOG(LogTemp, Warning, TEXT("Paged save files cannot be mapped: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	FSaveFileHeader Header;
+	if (!FSaveFileFormat::ReadHeader(MemoryReader, Header))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Only indexed save files can be mapped: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	if (!FSaveFileFormat::ReadIndex(MemoryReader, Header, MappedFile->Index))
+	{
+		return nullptr;
+	}
+
+	return MappedFile;
+}
@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SaveFileFormat.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+
+/**
+ * \class FMappedSaveFile
+ * \brief A save file mapped read-only into memory, with its key index parsed once at mapping time.
+ *
+ * Lookups on a mapped file cost no system calls and no copies: payloads are returned as views pointing straight into the mapping. Mapped files are kept in a process-wide
+ * registry keyed by file path, so they stay mapped across calls until they are released explicitly or the file is written through USaveLoadManager. The registry can be used
+ * from several threads at once.
+ *
+ * Only files in the indexed format can be mapped, and only when stored as plain files. Legacy files can be upgraded with USaveLoadManager::CompactFile.
+ */
+class FMappedSaveFile : public TSharedFromThis<FMappedSaveFile>
+{
+public:
+
+	~FMappedSaveFile();
+
+	/**
+	 * \brief Returns the mapping of a save file, mapping it first if it is not mapped yet.
+	 * \param SaveFilePath The file to map.
+	 * \return The mapped file, or nullptr if the file could not be mapped.
+	 */
+	static TSharedPtr<FMappedSaveFile> Map(const FString& SaveFilePath);
+
+	/**
+	 * \brief Returns the mapping of a save file if it is currently mapped.
+	 * \param SaveFilePath The file to look up.
+	 * \return The mapped file, or nullptr if the file is not mapped.
+	 */
+	static TSharedPtr<FMappedSaveFile> Find(const FString& SaveFilePath);
+
+	/**
+	 * \brief Releases the mapping of a save file. Views previously returned for it become invalid once the last reference to the mapping is dropped.
+	 * \param SaveFilePath The file to unmap.
+	 */
+	static void Release(const FString& SaveFilePath);
+
+	/**
+	 * \brief Finds an entry and returns a view of its payload inside the mapping.
+	 * \param Key The key to look for.
+	 * \param OutData Receives the view of the payload. It stays valid as long as the mapping is alive.
+	 * \param OutDataType Receives the data type of the entry.
+	 * \return True if the key was found. Compressed and compactly encoded entries cannot be viewed and return false.
+	 */
+	bool FindEntry(FSaveKeyView Key, TConstArrayView<uint8>& OutData, EDataType& OutDataType) const;
+
+	/**
+	 * \brief Finds an entry and copies its payload out of the mapping, decompressing and expanding it if needed.
+	 * \param Key The key to look for.
+	 * \param OutData Receives the payload bytes.
+	 * \param OutDataType Receives the data type of the entry.
+	 * \return True if the key was found.
+	 */
+	bool FindEntry(FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType) const;
+
+	/**
+	 * \brief Returns whether views can keep a file mapped while it is written.
+	 *
+	 * Mac and Linux replace, extend and delete mapped files, and readers of the mapping keep seeing the bytes it held. Other platforms, such as Windows, fail every write to a
+	 * mapped file, so views never hold on to the mapping there.
+	 */
+	static constexpr bool CanPinMapping() { return PLATFORM_MAC || PLATFORM_LINUX; }
+
+	/**
+	 * \brief Finds an entry and returns a view of its payload that keeps the mapping alive. Compressed and compactly encoded entries are decoded into a buffer of their own, and
+	 * so is every payload when CanPinMapping is false.
+	 * \param Key The key to look for.
+	 * \param OutView Receives the pinned view of the payload.
+	 * \param bKeepCompactEncoding If set, compactly encoded entries are left compact, and viewed in place unless they are compressed. See FSaveDataView::bCompactEncoded.
+	 * \return True if the key was found.
+	 */
+	bool FindPinnedEntry(FSaveKeyView Key, FSaveDataView& OutView, bool bKeepCompactEncoding = false) const;
+
+	/**
+	 * \brief Finds the live entries whose key starts with a prefix, ignoring case, see FSaveFileIndex::FindByPrefix. The keys are sorted by the first prefix query.
+	 * \param Prefix The prefix to match. An empty prefix matches every entry.
+	 * \param OutEntries Receives the matching entries in key order. They stay valid as long as the mapping is alive.
+	 */
+	void FindByPrefix(const FString& Prefix, TArray<const FSaveIndexEntry*>& OutEntries);
+
+	/** \brief Returns the live index of the file. */
+	const FSaveFileIndex& GetIndex() const { return Index; }
+
+private:
+
+	FMappedSaveFile() = default;
+
+	/** \brief Returns a view of the payload of an entry as stored in the mapping, after checking it lies inside the file. */
+	bool FindStoredPayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8>& OutData, EDataType& OutDataType) const;
+
+	/** \brief Maps a file and parses its index. Returns nullptr on failure. */
+	static TSharedPtr<FMappedSaveFile> Open(const FString& SaveFilePath);
+
+	/** \brief The handle of the mapped file. Must outlive MappedRegion. */
+	TUniquePtr<IMappedFileHandle> MappedHandle;
+
+	/** \brief The region covering the whole file. */
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	/** \brief The bytes of the whole file inside the mapping. */
+	TConstArrayView<uint8> FileData;
+
+	/** \brief The live index of the file, parsed once from the mapping. */
+	FSaveFileIndex Index;
+
+	/** \brief Guards the sorting of the keys of Index, which is the only change made to it after mapping. */
+	FCriticalSection SortLock;
+};
@@ -0,0 +1,910 @@
+﻿#include "SaveBTree.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+
+namespace
+{
+	/** \brief Node type tags, the first byte of every node page. */
+	constexpr uint8 LeafNodeType = 1;
+	constexpr uint8 InnerNodeType = 2;
+
+	/** \brief The size of the fixed part of a node: type, reserved byte, entry count and next leaf or first child. */
+	constexpr int32 NodeHeaderSize = sizeof(uint8) + sizeof(uint8) + sizeof(uint16) + sizeof(uint32);
+
+	/** \brief The deepest tree accepted when opening one, far more than MAX_int32 pages can hold. */
+	constexpr int32 MaxHeight = 32;
+
+	/** \brief The size of the fixed part of a leaf entry: key hash, data type, flags, payload size and payload page. */
+	constexpr int32 EntryFixedSize = sizeof(uint64) + sizeof(uint8) + sizeof(uint8) + sizeof(int32) + sizeof(uint32);
+
+	/** \brief The size of the largest leaf entry: a key of FSaveBTree::MaxKeyLength UTF-16 characters and an inline payload of the largest size. */
+	constexpr int32 MaxEntrySize = sizeof(int32) + (FSaveBTree::MaxKeyLength + 1) * sizeof(UTF16CHAR) + EntryFixedSize + FSaveBTree::MaxInlinePayloadSize;
+}
+
+bool FSaveBTree::IsBTree(FArchive& Ar)
+{
+	if (Ar.TotalSize() < PageSize)
+	{
+		return false;
+	}
+
+	uint32 Magic = 0;
+	Ar.Seek(0);
+	Ar << Magic;
+	Ar.Seek(0);
+
+	return !Ar.IsError() && Magic == MagicNumber;
+}
+
+bool FSaveBTree::OpenRead(FArchive& InReader)
+{
+	Reader = &InReader;
+	Store = nullptr;
+	Nodes.Reset();
+	return ReadHeader();
+}
+
+bool FSaveBTree::OpenWrite(FSavePageStore& InStore)
+{
+	Reader = nullptr;
+	Store = &InStore;
+	Nodes.Reset();
+	return ReadHeader();
+}
+
+bool FSaveBTree::Create(FSavePageStore& InStore, const FSaveCompressionSettings& Compression)
+{
+	Reader = nullptr;
+	Store = &InStore;
+	Nodes.Reset();
+
+	if (!Store->SetSize(0))
+	{
+		return false;
+	}
+
+	// An empty tree is a single empty leaf, right after the header page
+	Header = FTreeHeader();
+	Header.Compression = static_cast<uint8>(Compression.Compression);
+	Header.SpatialEncoding = static_cast<uint8>(Compression.SpatialEncoding);
+	Header.MinSizeToCompress = Compression.MinSizeToCompress;
+	Header.RootPage = 1;
+	Header.Height = 1;
+	Header.FirstLeaf = 1;
+	Header.PageCount = 2;
+	Header.LeafCount = 1;
+
+	TUniquePtr<FNode> Root = MakeUnique<FNode>();
+	Root->bDirty = true;
+	Nodes.Add(Header.RootPage, MoveTemp(Root));
+	return true;
+}
+
+float FSaveBTree::GetGarbageRatio() const
+{
+	if (Header.PageCount == 0)
+	{
+		return 0.0f;
+	}
+
+	// A rebuild fills every leaf until the next entry does not fit, so no packed leaf holds less than this
+	constexpr int64 PackedLeafBytes = PageSize - NodeHeaderSize - MaxEntrySize;
+	const int64 PackedLeafCount = FMath::Max<int64>(1, FMath::DivideAndRoundUp<int64>(Header.LeafEntryBytes, PackedLeafBytes));
+	const int64 ReclaimablePages = static_cast<int64>(Header.FreePageCount) + FMath::Max<int64>(0, static_cast<int64>(Header.LeafCount) - PackedLeafCount);
+	return FMath::Min(1.0f, static_cast<float>(ReclaimablePages) / static_cast<float>(Header.PageCount));
+}
+
+FSaveCompressionSettings FSaveBTree::GetCompressionSettings() const
+{
+	FSaveCompressionSettings Settings;
+	Settings.Compression = static_cast<ESaveCompression>(Header.Compression);
+	Settings.MinSizeToCompress = Header.MinSizeToCompress;
+	Settings.SpatialEncoding = static_cast<ESaveSpatialEncoding>(Header.SpatialEncoding);
+	return Settings;
+}
+
+bool FSaveBTree::Find(FSaveKeyView Key, FSaveIndexEntry& OutEntry)
+{
+	const FStringView KeyView(Key.GetData(), Key.Len());
+
+	// One node per level, nothing but the path to the leaf is read
+	FNode Node;
+	uint32 Page = Header.RootPage;
+	for (int32 Level = Header.Height - 1; Level >= 0; --Level)
+	{
+		if (!ReadNode(Page, Node) || Node.bLeaf != (Level == 0))
+		{
+			return false;
+		}
+
+		if (Level > 0)
+		{
+			Page = Node.Children[FindChild(Node, KeyView)];
+		}
+	}
+
+	const int32 Index = LowerBoundEntry(Node, KeyView);
+	if (Index == Node.Entries.Num() || CompareKeys(Node.Entries[Index].Key, KeyView) != 0)
+	{
+		return false;
+	}
+
+	OutEntry = MakeIndexEntry(Node.Entries[Index]);
+	return true;
+}
+
+bool FSaveBTree::FindByPrefix(const FString& Prefix, TArray<FSaveIndexEntry>& OutEntries)
+{
+	// Every key starting with the prefix sorts at or after it, so the scan starts in the leaf the prefix itself would go to
+	FNode Node;
+	uint32 Page = Header.RootPage;
+	for (int32 Level = Header.Height - 1; Level >= 0; --Level)
+	{
+		if (!ReadNode(Page, Node) || Node.bLeaf != (Level == 0))
+		{
+			return false;
+		}
+
+		if (Level > 0)
+		{
+			Page = Node.Children[FindChild(Node, Prefix)];
+		}
+	}
+
+	// Then follows the leaf chain until a key no longer starts with the prefix. Leaves emptied by removals are skipped
+	int32 Index = LowerBoundEntry(Node, Prefix);
+	for (uint32 VisitedLeaves = 1; ; ++Index)
+	{
+		while (Index == Node.Entries.Num())
+		{
+			if (Node.NextLeaf == 0)
+			{
+				return true;
+			}
+
+			const uint32 NextLeaf = Node.NextLeaf;
+			if (++VisitedLeaves > Header.PageCount || !ReadNode(NextLeaf, Node) || !Node.bLeaf)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Corrupted B+tree leaf chain at page %u."), NextLeaf);
+				return false;
+			}
+
+			Index = 0;
+		}
+
+		if (!Node.Entries[Index].Key.StartsWith(Prefix, ESearchCase::IgnoreCase))
+		{
+			return true;
+		}
+
+		OutEntries.Add(MakeIndexEntry(Node.Entries[Index]));
+	}
+}
+
+bool FSaveBTree::ReadIndex(FSaveFileIndex& OutIndex)
+{
+	OutIndex.Header = FSaveFileHeader();
+	OutIndex.Header.SetCompressionSettings(GetCompressionSettings());
+	OutIndex.Entries.Reset();
+	OutIndex.Entries.Reserve(static_cast<int32>(FMath::Min<int64>(Header.KeyCount, MAX_int32)));
+	OutIndex.SortedKeys.Reset();
+	OutIndex.FileSize = Reader ? Reader->TotalSize() : 0;
+	OutIndex.StorageEngine = ESaveStorageEngine::BTree;
+	OutIndex.RecordBytes = 0;
+	OutIndex.LiveRecordBytes = 0;
+
+	// The leaf chain visits every entry in key order
+	FNode Leaf;
+	uint32 VisitedLeaves = 0;
+	for (uint32 Page = Header.FirstLeaf; Page != 0; Page = Leaf.NextLeaf)
+	{
+		if (++VisitedLeaves > Header.PageCount || !ReadNode(Page, Leaf) || !Leaf.bLeaf)
+		{
+			return false;
+		}
+
+		for (const FLeafEntry& LeafEntry : Leaf.Entries)
+		{
+			const FSaveIndexEntry Entry = MakeIndexEntry(LeafEntry);
+			OutIndex.RecordBytes += Entry.DataSize;
+			OutIndex.Entries.Add(Entry.GetSaveKey(), Entry);
+			OutIndex.SortedKeys.Add(Entry.GetSaveKey());
+		}
+	}
+
+	OutIndex.LiveRecordBytes = OutIndex.RecordBytes;
+	OutIndex.bKeysSorted = true;
+	OutIndex.RebuildKeyFilter();
+	return true;
+}
+
+bool FSaveBTree::Insert(const FString& Key, EDataType DataType, ESaveRecordFlags Flags, TConstArrayView<uint8> StoredData)
+{
+	if (!Store)
+	{
+		return false;
+	}
+
+	if (Key.Len() > MaxKeyLength)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Key is longer than %d characters, which B+tree save files do not support: %s"), MaxKeyLength, *Key);
+		return false;
+	}
+
+	FLeafEntry Entry;
+	Entry.Key = Key;
+	Entry.KeyHash = FSaveKey::HashKey(Key);
+	Entry.DataType = DataType;
+	Entry.Flags = static_cast<uint8>(Flags);
+	Entry.DataSize = StoredData.Num();
+
+	if (StoredData.Num() <= MaxInlinePayloadSize)
+	{
+		Entry.InlineData = TArray<uint8>(StoredData.GetData(), StoredData.Num());
+	}
+	else
+	{
+		// Whole pages are written as they are, the last one is padded with zeros so none of its previous content is left behind
+		const int32 PageCount = FMath::DivideAndRoundUp(StoredData.Num(), PageSize);
+		const int32 FullPagesSize = (StoredData.Num() / PageSize) * PageSize;
+		Entry.PayloadPage = AllocatePayloadPages(PageCount);
+		if (Entry.PayloadPage == 0)
+		{
+			return false;
+		}
+
+		const int64 PayloadOffset = static_cast<int64>(Entry.PayloadPage) * PageSize;
+		TArray<uint8> LastPage;
+		LastPage.SetNumZeroed(PageSize);
+		FMemory::Memcpy(LastPage.GetData(), StoredData.GetData() + FullPagesSize, StoredData.Num() - FullPagesSize);
+
+		if (!Store->Write(PayloadOffset, StoredData.GetData(), FullPagesSize)
+			|| (FullPagesSize < StoredData.Num() && !Store->Write(PayloadOffset + FullPagesSize, LastPage.GetData(), PageSize)))
+		{
+			return false;
+		}
+	}
+
+	bool bSplit = false;
+	FString SplitKey;
+	uint32 SplitPage = 0;
+	if (!InsertInto(Header.RootPage, Header.Height - 1, Entry, bSplit, SplitKey, SplitPage))
+	{
+		return false;
+	}
+
+	if (bSplit)
+	{
+		// The root split, a new root above both halves makes the tree one level taller
+		const uint32 RootPage = AllocatePage();
+		if (RootPage == 0)
+		{
+			return false;
+		}
+
+		TUniquePtr<FNode> Root = MakeUnique<FNode>();
+		Root->bLeaf = false;
+		Root->bDirty = true;
+		Root->Keys.Add(MoveTemp(SplitKey));
+		Root->Children.Add(Header.RootPage);
+		Root->Children.Add(SplitPage);
+		Nodes.Add(RootPage, MoveTemp(Root));
+
+		Header.RootPage = RootPage;
+		++Header.Height;
+	}
+
+	return TrimNodes();
+}
+
+bool FSaveBTree::Remove(const FString& Key)
+{
+	if (!Store)
+	{
+		return false;
+	}
+
+	FNode* Node = nullptr;
+	uint32 Page = Header.RootPage;
+	for (int32 Level = Header.Height - 1; Level >= 0; --Level)
+	{
+		Node = GetNode(Page);
+		if (!Node || Node->bLeaf != (Level == 0))
+		{
+			return false;
+		}
+
+		if (Level > 0)
+		{
+			Page = Node->Children[FindChild(*Node, Key)];
+		}
+	}
+
+	// The leaf keeps its room, it fills up again with later inserts or goes away when the tree is rebuilt
+	const int32 Index = LowerBoundEntry(*Node, Key);
+	if (Index < Node->Entries.Num() && CompareKeys(Node->Entries[Index].Key, Key) == 0)
+	{
+		if (!FreePayload(Node->Entries[Index]))
+		{
+			return false;
+		}
+
+		Header.LeafEntryBytes -= GetSerializedEntrySize(Node->Entries[Index]);
+		Node->Entries.RemoveAt(Index);
+		Node->bDirty = true;
+		--Header.KeyCount;
+	}
+
+	return TrimNodes();
+}
+
+bool FSaveBTree::Flush()
+{
+	if (!Store)
+	{
+		return false;
+	}
+
+	// Written in page order, so the page store lays them out the way they are numbered
+	Nodes.KeySort(TLess<uint32>());
+	for (const TPair<uint32, TUniquePtr<FNode>>& Pair : Nodes)
+	{
+		if (Pair.Value->bDirty && !WriteNode(Pair.Key, *Pair.Value))
+		{
+			return false;
+		}
+	}
+
+	TArray<uint8> Bytes;
+	FMemoryWriter HeaderWriter(Bytes);
+	HeaderWriter << Header;
+	Bytes.SetNumZeroed(PageSize);
+
+	// Every page of the tree is part of the image, even those allocated without being written yet
+	const int64 ImageSize = static_cast<int64>(Header.PageCount) * PageSize;
+	return Store->Write(0, Bytes.GetData(), PageSize) && (Store->GetSize() >= ImageSize || Store->SetSize(ImageSize));
+}
+
+int32 FSaveBTree::GetSerializedKeySize(const FString& Key)
+{
+	// Serialized strings are their length, then their characters with a terminator, as ANSI when they can be, otherwise as UTF-16
+	if (Key.IsEmpty())
+	{
+		return sizeof(int32);
+	}
+
+	const int32 CharacterSize = FCString::IsPureAnsi(*Key) ? sizeof(ANSICHAR) : sizeof(UTF16CHAR);
+	return sizeof(int32) + (Key.Len() + 1) * CharacterSize;
+}
+
+int32 FSaveBTree::GetSerializedEntrySize(const FLeafEntry& Entry)
+{
+	return GetSerializedKeySize(Entry.Key) + EntryFixedSize + (Entry.PayloadPage == 0 ? Entry.DataSize : 0);
+}
+
+int32 FSaveBTree::GetSerializedNodeSize(const FNode& Node)
+{
+	int32 Size = NodeHeaderSize;
+	if (Node.bLeaf)
+	{
+		for (const FLeafEntry& Entry : Node.Entries)
+		{
+			Size += GetSerializedEntrySize(Entry);
+		}
+	}
+	else
+	{
+		for (const FString& Key : Node.Keys)
+		{
+			Size += GetSerializedKeySize(Key) + sizeof(uint32);
+		}
+	}
+
+	return Size;
+}
+
+int32 FSaveBTree::LowerBoundEntry(const FNode& Leaf, FStringView Key)
+{
+	int32 First = 0;
+	int32 Count = Leaf.Entries.Num();
+	while (Count > 0)
+	{
+		const int32 Step = Count / 2;
+		if (CompareKeys(Leaf.Entries[First + Step].Key, Key) < 0)
+		{
+			First += Step + 1;
+			Count -= Step + 1;
+		}
+		else
+		{
+			Count = Step;
+		}
+	}
+
+	return First;
+}
+
+int32 FSaveBTree::FindChild(const FNode& Node, FStringView Key)
+{
+	// The number of separators at or before the key
+	int32 First = 0;
+	int32 Count = Node.Keys.Num();
+	while (Count > 0)
+	{
+		const int32 Step = Count / 2;
+		if (CompareKeys(Node.Keys[First + Step], Key) <= 0)
+		{
+			First += Step + 1;
+			Count -= Step + 1;
+		}
+		else
+		{
+			Count = Step;
+		}
+	}
+
+	return First;
+}
+
+FSaveIndexEntry FSaveBTree::MakeIndexEntry(const FLeafEntry& LeafEntry)
+{
+	// The stored payload is all there is of the entry in the image, it stands in for the record
+	FSaveIndexEntry Entry;
+	Entry.Key = LeafEntry.Key;
+	Entry.KeyHash = LeafEntry.KeyHash;
+	Entry.DataType = LeafEntry.DataType;
+	Entry.Flags = LeafEntry.Flags;
+	Entry.RecordOffset = LeafEntry.DataOffset;
+	Entry.DataOffset = LeafEntry.DataOffset;
+	Entry.DataSize = LeafEntry.DataSize;
+	return Entry;
+}
+
+bool FSaveBTree::ReadHeader()
+{
+	TArray<uint8> Bytes;
+	if (!ReadPage(0, Bytes))
+	{
+		return false;
+	}
+
+	FMemoryReader HeaderReader(Bytes);
+	HeaderReader << Header;
+
+	const int64 ImageSize = Reader ? Reader->TotalSize() : Store->GetSize();
+	if (HeaderReader.IsError() || Header.Magic != MagicNumber || Header.Version != CurrentVersion || Header.PageSize != PageSize
+		|| Header.PageCount < 2 || static_cast<int64>(Header.PageCount) * PageSize > ImageSize || Header.Height < 1 || Header.Height > MaxHeight
+		|| Header.RootPage == 0 || Header.RootPage >= Header.PageCount || Header.FirstLeaf == 0 || Header.FirstLeaf >= Header.PageCount
+		|| Header.FreeListHead >= Header.PageCount || Header.KeyCount < 0 || Header.LeafCount == 0 || Header.LeafCount >= Header.PageCount || Header.LeafEntryBytes < 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted B+tree save file."));
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveBTree::ReadPage(uint32 Page, TArray<uint8>& OutBytes)
+{
+	OutBytes.SetNumUninitialized(PageSize);
+	const int64 Offset = static_cast<int64>(Page) * PageSize;
+
+	if (Store)
+	{
+		return Store->Read(Offset, OutBytes.GetData(), PageSize);
+	}
+
+	if (!Reader || Offset + PageSize > Reader->TotalSize())
+	{
+		return false;
+	}
+
+	Reader->Seek(Offset);
+	Reader->Serialize(OutBytes.GetData(), PageSize);
+	return !Reader->IsError();
+}
+
+bool FSaveBTree::ReadNode(uint32 Page, FNode& OutNode)
+{
+	TArray<uint8> Bytes;
+	return Page != 0 && Page < Header.PageCount && ReadPage(Page, Bytes) && ParseNode(Page, Bytes, OutNode);
+}
+
+FSaveBTree::FNode* FSaveBTree::GetNode(uint32 Page)
+{
+	if (const TUniquePtr<FNode>* Node = Nodes.Find(Page))
+	{
+		return Node->Get();
+	}
+
+	TUniquePtr<FNode> Node = MakeUnique<FNode>();
+	if (!ReadNode(Page, *Node))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted B+tree node at page %u."), Page);
+		return nullptr;
+	}
+
+	return Nodes.Add(Page, MoveTemp(Node)).Get();
+}
+
+bool FSaveBTree::ParseNode(uint32 Page, const TArray<uint8>& Bytes, FNode& OutNode) const
+{
+	FMemoryReader NodeReader(Bytes);
+
+	uint8 NodeType = 0;
+	uint8 Reserved = 0;
+	uint16 Count = 0;
+	uint32 Link = 0;
+	NodeReader << NodeType;
+	NodeReader << Reserved;
+	NodeReader << Count;
+	NodeReader << Link;
+
+	OutNode = FNode();
+	OutNode.bLeaf = NodeType == LeafNodeType;
+	if ((NodeType != LeafNodeType && NodeType != InnerNodeType) || Link >= Header.PageCount)
+	{
+		return false;
+	}
+
+	if (!OutNode.bLeaf)
+	{
+		OutNode.Keys.SetNum(Count);
+		OutNode.Children.SetNum(Count + 1);
+		OutNode.Children[0] = Link;
+
+		for (int32 Index = 0; Index < Count && !NodeReader.IsError(); ++Index)
+		{
+			NodeReader << OutNode.Keys[Index];
+			NodeReader << OutNode.Children[Index + 1];
+		}
+
+		return !NodeReader.IsError() && !OutNode.Children.ContainsByPredicate([this](uint32 Child) { return Child == 0 || Child >= Header.PageCount; });
+	}
+
+	OutNode.NextLeaf = Link;
+	OutNode.Entries.SetNum(Count);
+	for (FLeafEntry& Entry : OutNode.Entries)
+	{
+		NodeReader << Entry.Key;
+		NodeReader << Entry.KeyHash;
+		NodeReader << Entry.DataType;
+		NodeReader << Entry.Flags;
+		NodeReader << Entry.DataSize;
+		NodeReader << Entry.PayloadPage;
+
+		if (NodeReader.IsError() || Entry.DataSize < 0 || Entry.PayloadPage >= Header.PageCount)
+		{
+			return false;
+		}
+
+		if (Entry.PayloadPage != 0)
+		{
+			Entry.DataOffset = static_cast<int64>(Entry.PayloadPage) * PageSize;
+			if (Entry.DataOffset + Entry.DataSize > static_cast<int64>(Header.PageCount) * PageSize)
+			{
+				return false;
+			}
+
+			continue;
+		}
+
+		if (Entry.DataSize > MaxInlinePayloadSize || NodeReader.Tell() + Entry.DataSize > PageSize)
+		{
+			return false;
+		}
+
+		Entry.DataOffset = static_cast<int64>(Page) * PageSize + NodeReader.Tell();
+		Entry.InlineData.SetNumUninitialized(Entry.DataSize);
+		NodeReader.Serialize(Entry.InlineData.GetData(), Entry.DataSize);
+	}
+
+	return !NodeReader.IsError();
+}
+
+bool FSaveBTree::WriteNode(uint32 Page, FNode& Node)
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter NodeWriter(Bytes);
+
+	uint8 NodeType = Node.bLeaf ? LeafNodeType : InnerNodeType;
+	uint8 Reserved = 0;
+	uint16 Count = static_cast<uint16>(Node.bLeaf ? Node.Entries.Num() : Node.Keys.Num());
+	uint32 Link = Node.bLeaf ? Node.NextLeaf : Node.Children[0];
+	NodeWriter << NodeType;
+	NodeWriter << Reserved;
+	NodeWriter << Count;
+	NodeWriter << Link;
+
+	if (Node.bLeaf)
+	{
+		for (FLeafEntry& Entry : Node.Entries)
+		{
+			NodeWriter << Entry.Key;
+			NodeWriter << Entry.KeyHash;
+			NodeWriter << Entry.DataType;
+			NodeWriter << Entry.Flags;
+			NodeWriter << Entry.DataSize;
+			NodeWriter << Entry.PayloadPage;
+
+			if (Entry.PayloadPage == 0)
+			{
+				NodeWriter.Serialize(Entry.InlineData.GetData(), Entry.InlineData.Num());
+			}
+		}
+	}
+	else
+	{
+		for (int32 Index = 0; Index < Node.Keys.Num(); ++Index)
+		{
+			NodeWriter << Node.Keys[Index];
+			NodeWriter << Node.Children[Index + 1];
+		}
+	}
+
+	if (Bytes.Num() > PageSize)
+	{
+		UE_LOG(LogTemp, Error, TEXT("B+tree node at page %u does not fit in a page."), Page);
+		return false;
+	}
+
+	Bytes.SetNumZeroed(PageSize);
+	if (!Store->Write(static_cast<int64>(Page) * PageSize, Bytes.GetData(), PageSize))
+	{
+		return false;
+	}
+
+	Node.bDirty = false;
+	return true;
+}
+
+bool FSaveBTree::InsertInto(uint32 Page, int32 Level, FLeafEntry& Entry, bool& bOutSplit, FString& OutSplitKey, uint32& OutSplitPage)
+{
+	bOutSplit = false;
+
+	FNode* Node = GetNode(Page);
+	if (!Node || Node->bLeaf != (Level == 0))
+	{
+		return false;
+	}
+
+	bool bAddedLast = false;
+	if (Node->bLeaf)
+	{
+		const int32 Index = LowerBoundEntry(*Node, Entry.Key);
+		const int32 EntrySize = GetSerializedEntrySize(Entry);
+		if (Index < Node->Entries.Num() && CompareKeys(Node->Entries[Index].Key, Entry.Key) == 0)
+		{
+			if (!FreePayload(Node->Entries[Index]))
+			{
+				return false;
+			}
+
+			Header.LeafEntryBytes -= GetSerializedEntrySize(Node->Entries[Index]);
+			Node->Entries[Index] = MoveTemp(Entry);
+		}
+		else
+		{
+			Node->Entries.Insert(MoveTemp(Entry), Index);
+			++Header.KeyCount;
+		}
+
+		Header.LeafEntryBytes += EntrySize;
+
+		bAddedLast = Index == Node->Entries.Num() - 1;
+	}
+	else
+	{
+		const int32 ChildIndex = FindChild(*Node, Entry.Key);
+
+		bool bChildSplit = false;
+		FString ChildSplitKey;
+		uint32 ChildSplitPage = 0;
+		if (!InsertInto(Node->Children[ChildIndex], Level - 1, Entry, bChildSplit, ChildSplitKey, ChildSplitPage))
+		{
+			return false;
+		}
+
+		if (!bChildSplit)
+		{
+			return true;
+		}
+
+		// The new right sibling goes right after the child that split
+		Node->Keys.Insert(MoveTemp(ChildSplitKey), ChildIndex);
+		Node->Children.Insert(ChildSplitPage, ChildIndex + 1);
+		bAddedLast = ChildIndex == Node->Keys.Num() - 1;
+	}
+
+	Node->bDirty = true;
+	return SplitNode(*Node, bAddedLast, bOutSplit, OutSplitKey, OutSplitPage);
+}
+
+bool FSaveBTree::SplitNode(FNode& Node, bool bAddedLast, bool& bOutSplit, FString& OutSplitKey, uint32& OutSplitPage)
+{
+	const int32 NodeSize = GetSerializedNodeSize(Node);
+	if (NodeSize <= PageSize)
+	{
+		bOutSplit = false;
+		return true;
+	}
+
+	const uint32 RightPage = AllocatePage();
+	if (RightPage == 0)
+	{
+		return false;
+	}
+
+	TUniquePtr<FNode> Right = MakeUnique<FNode>();
+	Right->bLeaf = Node.bLeaf;
+	Right->bDirty = true;
+
+	// Split where the first half of the bytes ends: the left node keeps less than half of them plus one entry, the right node at most half
+	const int32 HalfSize = (NodeSize - NodeHeaderSize) / 2;
+	if (Node.bLeaf)
+	{
+		int32 SplitIndex = Node.Entries.Num() - 1;
+		if (!bAddedLast)
+		{
+			int32 LeftSize = 0;
+			for (int32 Index = 0; Index < Node.Entries.Num(); ++Index)
+			{
+				LeftSize += GetSerializedEntrySize(Node.Entries[Index]);
+				if (LeftSize >= HalfSize)
+				{
+					SplitIndex = FMath::Clamp(Index + 1, 1, Node.Entries.Num() - 1);
+					break;
+				}
+			}
+		}
+
+		for (int32 Index = SplitIndex; Index < Node.Entries.Num(); ++Index)
+		{
+			Right->Entries.Add(MoveTemp(Node.Entries[Index]));
+		}
+
+		Node.Entries.SetNum(SplitIndex);
+		Right->NextLeaf = Node.NextLeaf;
+		Node.NextLeaf = RightPage;
+		OutSplitKey = Right->Entries[0].Key;
+		++Header.LeafCount;
+	}
+	else
+	{
+		// The separator at the split moves up to the parent, the keys after it go to the right node
+		int32 SplitIndex = Node.Keys.Num() - 1;
+		if (!bAddedLast)
+		{
+			int32 LeftSize = 0;
+			for (int32 Index = 0; Index < Node.Keys.Num(); ++Index)
+			{
+				LeftSize += GetSerializedKeySize(Node.Keys[Index]) + sizeof(uint32);
+				if (LeftSize >= HalfSize)
+				{
+					SplitIndex = Index;
+					break;
+				}
+			}
+		}
+
+		for (int32 Index = SplitIndex + 1; Index < Node.Keys.Num(); ++Index)
+		{
+			Right->Keys.Add(MoveTemp(Node.Keys[Index]));
+		}
+
+		for (int32 Index = SplitIndex + 1; Index < Node.Children.Num(); ++Index)
+		{
+			Right->Children.Add(Node.Children[Index]);
+		}
+
+		OutSplitKey = MoveTemp(Node.Keys[SplitIndex]);
+		Node.Keys.SetNum(SplitIndex);
+		Node.Children.SetNum(SplitIndex + 1);
+	}
+
+	Nodes.Add(RightPage, MoveTemp(Right));
+	OutSplitPage = RightPage;
+	bOutSplit = true;
+	return true;
+}
+
+uint32 FSaveBTree::AllocatePage()
+{
+	if (Header.FreeListHead == 0)
+	{
+		if (Header.PageCount >= static_cast<uint32>(MAX_int32))
+		{
+			UE_LOG(LogTemp, Error, TEXT("B+tree save file is full."));
+			return 0;
+		}
+
+		return Header.PageCount++;
+	}
+
+	// A free page starts with the next free page
+	const uint32 Page = Header.FreeListHead;
+	TArray<uint8> Bytes;
+	if (!ReadPage(Page, Bytes))
+	{
+		return 0;
+	}
+
+	uint32 NextFreePage = 0;
+	FMemoryReader FreePageReader(Bytes);
+	FreePageReader << NextFreePage;
+	if (NextFreePage >= Header.PageCount)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted free page list in B+tree save file."));
+		return 0;
+	}
+
+	Header.FreeListHead = NextFreePage;
+	--Header.FreePageCount;
+	return Page;
+}
+
+uint32 FSaveBTree::AllocatePayloadPages(int32 PageCount)
+{
+	if (PageCount == 1)
+	{
+		return AllocatePage();
+	}
+
+	// Free pages are not contiguous, runs always come from the end of the image
+	if (static_cast<int64>(Header.PageCount) + PageCount > MAX_int32)
+	{
+		UE_LOG(LogTemp, Error, TEXT("B+tree save file is full."));
+		return 0;
+	}
+
+	const uint32 FirstPage = Header.PageCount;
+	Header.PageCount += PageCount;
+	return FirstPage;
+}
+
+bool FSaveBTree::FreePayload(const FLeafEntry& Entry)
+{
+	if (Entry.PayloadPage == 0)
+	{
+		return true;
+	}
+
+	TArray<uint8> Bytes;
+	const int32 PageCount = FMath::DivideAndRoundUp(Entry.DataSize, PageSize);
+	for (int32 Index = 0; Index < PageCount; ++Index)
+	{
+		const uint32 Page = Entry.PayloadPage + Index;
+
+		Bytes.Reset();
+		FMemoryWriter FreePageWriter(Bytes);
+		FreePageWriter << Header.FreeListHead;
+		Bytes.SetNumZeroed(PageSize);
+
+		if (!Store->Write(static_cast<int64>(Page) * PageSize, Bytes.GetData(), PageSize))
+		{
+			return false;
+		}
+
+		Header.FreeListHead = Page;
+		++Header.FreePageCount;
+	}
+
+	return true;
+}
+
+bool FSaveBTree::TrimNodes()
+{
+	if (Nodes.Num() <= MaxCachedNodes)
+	{
+		return true;
+	}
+
+	if (!Flush())
+	{
+		return false;
+	}
+
+	Nodes.Reset();
+	return true;
+}
@@ -0,0 +1,272 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SaveFileFormat.h"
+#include "SavePageStore.h"
+
+
+/**
+ * \class FSaveBTree
+ * \brief A B+tree of save entries kept in the image of a page store, for save files with more keys than an in-memory index can handle.
+ *
+ * Logical page 0 of the image holds the tree header, every other page is a node, a payload page or a free page. Leaves hold the entries in case-insensitive key order, each with
+ * its data type, record flags and stored payload, and are chained left to right for ordered scans. Inner nodes hold separator keys and child pages. Payloads of up to
+ * MaxInlinePayloadSize bytes are stored in their leaf, larger ones in a run of pages of their own. Stored payloads are encoded like the records of an indexed file, see
+ * FSaveFileFormat::EncodePayload, and the entries found in the tree point at them, so FSaveFileFormat::ReadPayload reads them back.
+ *
+ * A lookup reads one node per level of the tree. A change writes the nodes on the path to its leaf, which the page store copies and publishes atomically with the next commit.
+ * Nodes are split when they overflow, but never merged: removed entries leave room in their leaf, freed payload pages are reused, and rebuilding the tree compacts it. The tree
+ * header counts the leaves and the bytes of the entries they hold, so the room a rebuild would reclaim is known without reading the leaves, see GetGarbageRatio.
+ *
+ * A tree is either opened for reading, through an archive over the image, or for writing, through the page store itself.
+ */
+class FSaveBTree
+{
+public:
+
+	/** \brief Magic number identifying a B+tree image ('SLBT' on disk). It differs from the magic number of an indexed save file, which is how the two are told apart. */
+	static constexpr uint32 MagicNumber = 0x54424C53;
+
+	/** \brief The current version of the B+tree layout. */
+	static constexpr uint16 CurrentVersion = 1;
+
+	/** \brief The size of a node in bytes, one page of the page store. */
+	static constexpr int32 PageSize = FSavePageStore::PageSize;
+
+	/** \brief The longest key in characters. It keeps at least three entries in every node, which is what splitting a node in two relies on. */
+	static constexpr int32 MaxKeyLength = 255;
+
+	/** \brief The largest stored payload kept in its leaf. Larger payloads get pages of their own. */
+	static constexpr int32 MaxInlinePayloadSize = 768;
+
+	/** \brief The number of nodes held in memory while the tree is written. Beyond it the modified nodes are written to the page store and the nodes are dropped. */
+	static constexpr int32 MaxCachedNodes = 1024;
+
+	/**
+	 * \brief Returns true if the archive holds a B+tree image. The archive is left at its start.
+	 */
+	static bool IsBTree(FArchive& Ar);
+
+	/**
+	 * \brief Opens the tree in an image for reading. The archive must outlive the tree.
+	 * \return True if the tree header is valid.
+	 */
+	bool OpenRead(FArchive& InReader);
+
+	/**
+	 * \brief Opens the tree in the image of a page store for writing. The store must outlive the tree, and is committed by the caller after Flush.
+	 * \return True if the tree header is valid.
+	 */
+	bool OpenWrite(FSavePageStore& InStore);
+
+	/**
+	 * \brief Replaces the image of a page store with an empty tree, opened for writing.
+	 * \param Compression The compression settings recorded in the tree header.
+	 * \return True if the image was reset.
+	 */
+	bool Create(FSavePageStore& InStore, const FSaveCompressionSettings& Compression);
+
+	/** \brief Returns the compression settings recorded in the tree header. */
+	FSaveCompressionSettings GetCompressionSettings() const;
+
+	/** \brief Returns the number of keys in the tree. */
+	int64 GetKeyCount() const { return Header.KeyCount; }
+
+	/**
+	 * \brief Returns the fraction of the pages of the tree that rebuilding it would reclaim, between 0 and 1.
+	 *
+	 * Those are the free pages, and the leaves beyond the ones the live entries would fill once packed. Packed leaves are counted as short of a page by the largest entry,
+	 * which is as empty as a rebuild leaves them, so a freshly rebuilt tree always has no garbage. Leaves emptied or thinned out by removals and replacements count in full.
+	 */
+	float GetGarbageRatio() const;
+
+	/**
+	 * \brief Finds the entry of a key, reading one node per level of the tree.
+	 * \param OutEntry Receives the entry, pointing at its stored payload in the image.
+	 * \return True if the key was found.
+	 */
+	bool Find(FSaveKeyView Key, FSaveIndexEntry& OutEntry);
+
+	/**
+	 * \brief Finds the entries whose key starts with a prefix, ignoring case, in key order. Only the leaves holding them are read, after the path down to the first one.
+	 * \param Prefix The prefix to match. An empty prefix matches every entry.
+	 * \param OutEntries Receives the matching entries, pointing at their stored payloads in the image.
+	 * \return True if the tree was read successfully.
+	 */
+	bool FindByPrefix(const FString& Prefix, TArray<FSaveIndexEntry>& OutEntries);
+
+	/**
+	 * \brief Reads every entry into an index, walking the leaves in key order. For operations that visit every entry anyway, such as rewriting the file.
+	 * \param OutIndex Receives the entries, with its keys sorted and its header carrying the compression settings of the tree.
+	 * \return True if the tree was read successfully.
+	 */
+	bool ReadIndex(FSaveFileIndex& OutIndex);
+
+	/**
+	 * \brief Inserts an entry, replacing the entry of the same key if there is one.
+	 * \param Key The key, at most MaxKeyLength characters.
+	 * \param DataType The data type of the entry.
+	 * \param Flags The record flags describing the stored payload.
+	 * \param StoredData The payload as stored, see FSaveFileFormat::EncodePayload.
+	 * \return True if the entry was inserted.
+	 */
+	bool Insert(const FString& Key, EDataType DataType, ESaveRecordFlags Flags, TConstArrayView<uint8> StoredData);
+
+	/**
+	 * \brief Removes the entry of a key, if there is one.
+	 * \return False if the tree could not be read or written.
+	 */
+	bool Remove(const FString& Key);
+
+	/**
+	 * \brief Writes the modified nodes and the tree header to the page store. Nothing is published until the store is committed.
+	 * \return True if every page was written.
+	 */
+	bool Flush();
+
+private:
+
+	/** \brief The tree header, stored at the start of logical page 0. */
+	struct FTreeHeader
+	{
+		uint32 Magic = MagicNumber;
+		uint16 Version = CurrentVersion;
+		uint16 Reserved = 0;
+		uint32 PageSize = FSaveBTree::PageSize;
+		uint8 Compression = static_cast<uint8>(ESaveCompression::None);
+		uint8 SpatialEncoding = static_cast<uint8>(ESaveSpatialEncoding::Archive);
+		int32 MinSizeToCompress = 0;
+
+		/** \brief The root node and the number of levels of the tree, 1 when the root is a leaf. */
+		uint32 RootPage = 0;
+		int32 Height = 0;
+
+		/** \brief The leftmost leaf, where ordered scans start. */
+		uint32 FirstLeaf = 0;
+		int64 KeyCount = 0;
+
+		/** \brief The number of pages of the image, and the first free page, each free page starting with the next one. */
+		uint32 PageCount = 0;
+		uint32 FreeListHead = 0;
+		uint32 FreePageCount = 0;
+
+		/** \brief The number of leaves, and the serialized bytes of the entries they hold, inline payloads included. */
+		uint32 LeafCount = 0;
+		int64 LeafEntryBytes = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FTreeHeader& TreeHeader)
+		{
+			Ar << TreeHeader.Magic;
+			Ar << TreeHeader.Version;
+			Ar << TreeHeader.Reserved;
+			Ar << TreeHeader.PageSize;
+			Ar << TreeHeader.Compression;
+			Ar << TreeHeader.SpatialEncoding;
+			Ar << TreeHeader.MinSizeToCompress;
+			Ar << TreeHeader.RootPage;
+			Ar << TreeHeader.Height;
+			Ar << TreeHeader.FirstLeaf;
+			Ar << TreeHeader.KeyCount;
+			Ar << TreeHeader.PageCount;
+			Ar << TreeHeader.FreeListHead;
+			Ar << TreeHeader.FreePageCount;
+			Ar << TreeHeader.LeafCount;
+			Ar << TreeHeader.LeafEntryBytes;
+			return Ar;
+		}
+	};
+
+	/** \brief An entry of a leaf. */
+	struct FLeafEntry
+	{
+		FString Key;
+		uint64 KeyHash = 0;
+		EDataType DataType = EDataType::FloatType;
+		uint8 Flags = 0;
+		int32 DataSize = 0;
+
+		/** \brief The first page of a payload stored in pages of its own, 0 for payloads stored in the leaf. */
+		uint32 PayloadPage = 0;
+		TArray<uint8> InlineData;
+
+		/** \brief Offset of the stored payload in the image. Set when the leaf is read. */
+		int64 DataOffset = 0;
+	};
+
+	/** \brief A node as held in memory. Inner nodes have one more child than keys, keys in Children[i + 1] sort at or after Keys[i], keys in Children[i] before it. */
+	struct FNode
+	{
+		bool bLeaf = true;
+		bool bDirty = false;
+		uint32 NextLeaf = 0;
+		TArray<FLeafEntry> Entries;
+		TArray<FString> Keys;
+		TArray<uint32> Children;
+	};
+
+	/** \brief Orders keys the way the tree does, case-insensitively. */
+	static int32 CompareKeys(FStringView A, FStringView B) { return A.Compare(B, ESearchCase::IgnoreCase); }
+
+	/** \brief Returns the size of a serialized key in bytes. */
+	static int32 GetSerializedKeySize(const FString& Key);
+
+	/** \brief Returns the size of a serialized leaf entry in bytes. */
+	static int32 GetSerializedEntrySize(const FLeafEntry& Entry);
+
+	/** \brief Returns the size of a serialized node in bytes. */
+	static int32 GetSerializedNodeSize(const FNode& Node);
+
+	/** \brief Returns the index of the first leaf entry at or after a key. */
+	static int32 LowerBoundEntry(const FNode& Leaf, FStringView Key);
+
+	/** \brief Returns the child of an inner node the subtree of a key goes through. */
+	static int32 FindChild(const FNode& Node, FStringView Key);
+
+	/** \brief Builds the index entry of a leaf entry. */
+	static FSaveIndexEntry MakeIndexEntry(const FLeafEntry& Entry);
+
+	/** \brief Reads and checks the tree header. */
+	bool ReadHeader();
+
+	/** \brief Reads one page of the image. */
+	bool ReadPage(uint32 Page, TArray<uint8>& OutBytes);
+
+	/** \brief Reads and parses a node without keeping it. */
+	bool ReadNode(uint32 Page, FNode& OutNode);
+
+	/** \brief Returns a node held in memory for writing, reading it first if needed. Null if it could not be read. Stays valid until the nodes are dropped by TrimNodes. */
+	FNode* GetNode(uint32 Page);
+
+	/** \brief Parses a node read from a page. */
+	bool ParseNode(uint32 Page, const TArray<uint8>& Bytes, FNode& OutNode) const;
+
+	/** \brief Serializes a node into a page and writes it to the page store. */
+	bool WriteNode(uint32 Page, FNode& Node);
+
+	/** \brief Inserts an entry into the subtree under a node, reporting the new right sibling and its first key if the node was split. */
+	bool InsertInto(uint32 Page, int32 Level, FLeafEntry& Entry, bool& bOutSplit, FString& OutSplitKey, uint32& OutSplitPage);
+
+	/**
+	 * \brief Splits an overflowing node in two. A node whose last entry was just added keeps everything else, so keys inserted in order fill every node, others are split by size.
+	 */
+	bool SplitNode(FNode& Node, bool bAddedLast, bool& bOutSplit, FString& OutSplitKey, uint32& OutSplitPage);
+
+	/** \brief Takes a free page, or a new page at the end of the image. Returns 0 on failure. */
+	uint32 AllocatePage();
+
+	/** \brief Takes a run of contiguous pages for a payload. Returns 0 on failure. */
+	uint32 AllocatePayloadPages(int32 PageCount);
+
+	/** \brief Returns the pages of a payload stored outside its leaf to the free pages. */
+	bool FreePayload(const FLeafEntry& Entry);
+
+	/** \brief Writes the modified nodes once too many are held in memory, and drops them. */
+	bool TrimNodes();
+
+	FArchive* Reader = nullptr;
+	FSavePageStore* Store = nullptr;
+	FTreeHeader Header;
+
+	/** \brief The nodes held in memory for writing, by page. Nodes are held by pointer so they stay in place while more are loaded. */
+	TMap<uint32, TUniquePtr<FNode>> Nodes;
+};
@@ -0,0 +1,309 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include <initializer_list>
+#include <type_traits>
+
+
+/**
+ * \struct FSaveFixedWidthCodec
+ * \brief Encodes and decodes primitive values as fixed-width bytes without going through an archive.
+ *
+ * The bytes are exactly what an FMemoryWriter produces for the same value on the platforms we ship on (little-endian, no byte swapping), so data written by either path reads back
+ * with the other. Booleans keep the 4-byte archive layout for the same reason.
+ *
+ * Encode writes into a caller-provided buffer and never allocates. EncodeInline returns the bytes in an inline array, which does not allocate either.
+ */
+struct FSaveFixedWidthCodec
+{
+	/** \brief Large enough for every fixed-width value. */
+	static constexpr int32 MaxSize = 8;
+
+	/** \brief Fixed-width bytes of a single value, stored inline. */
+	using FInlineBytes = TArray<uint8, TInlineAllocator<MaxSize>>;
+
+	/** \brief Returns the encoded size of a value type in bytes. */
+	template <typename ValueType>
+	static constexpr int32 GetSize()
+	{
+		// Archives store booleans as 32-bit integers
+		return std::is_same_v<ValueType, bool> ? sizeof(uint32) : sizeof(ValueType);
+	}
+
+	/**
+	 * \brief Writes the bytes of a value into a caller-provided buffer.
+	 * \param Value The value to encode.
+	 * \param OutBytes The buffer to write to. It must hold at least GetSize bytes.
+	 * \return The number of bytes written, or 0 if the buffer is too small.
+	 */
+	template <typename ValueType>
+	static int32 Encode(ValueType Value, TArrayView<uint8> OutBytes)
+	{
+		static_assert(std::is_arithmetic_v<ValueType>, "Only primitive values have a fixed-width encoding.");
+
+		constexpr int32 Size = GetSize<ValueType>();
+		if (OutBytes.Num() < Size)
+		{
+			return 0;
+		}
+
+		if constexpr (std::is_same_v<ValueType, bool>)
+		{
+			const uint32 BoolValue = Value ? 1 : 0;
+			FMemory::Memcpy(OutBytes.GetData(), &BoolValue, Size);
+		}
+		else
+		{
+			FMemory::Memcpy(OutBytes.GetData(), &Value, Size);
+		}
+
+		return Size;
+	}
+
+	/**
+	 * \brief Reads a value from the start of a byte view.
+	 * \param Bytes The bytes to decode.
+	 * \param OutValue Receives the value. Left untouched if the view is too short.
+	 * \return True if the view held enough bytes.
+	 */
+	template <typename ValueType>
+	static bool Decode(TConstArrayView<uint8> Bytes, ValueType& OutValue)
+	{
+		static_assert(std::is_arithmetic_v<ValueType>, "Only primitive values have a fixed-width encoding.");
+
+		constexpr int32 Size = GetSize<ValueType>();
+		if (Bytes.Num() < Size)
+		{
+			return false;
+		}
+
+		if constexpr (std::is_same_v<ValueType, bool>)
+		{
+			uint32 BoolValue = 0;
+			FMemory::Memcpy(&BoolValue, Bytes.GetData(), Size);
+			OutValue = BoolValue != 0;
+		}
+		else
+		{
+			FMemory::Memcpy(&OutValue, Bytes.GetData(), Size);
+		}
+
+		return true;
+	}
+
+	/** \brief Returns the bytes of a value in an inline array. */
+	template <typename ValueType>
+	static FInlineBytes EncodeInline(ValueType Value)
+	{
+		FInlineBytes Bytes;
+		Bytes.SetNumUninitialized(GetSize<ValueType>());
+		Encode(Value, MakeArrayView(Bytes));
+		return Bytes;
+	}
+
+	/** \brief Returns the bytes of a value in a regular array, allocated once at its exact size. */
+	template <typename ValueType>
+	static TArray<uint8> EncodeToArray(ValueType Value)
+	{
+		TArray<uint8> Bytes;
+		Bytes.SetNumUninitialized(GetSize<ValueType>());
+		Encode(Value, MakeArrayView(Bytes));
+		return Bytes;
+	}
+
+	/** \brief Reads a value from the start of a byte view, or returns DefaultValue if the view is too short. */
+	template <typename ValueType>
+	static ValueType DecodeOr(TConstArrayView<uint8> Bytes, ValueType DefaultValue)
+	{
+		Decode(Bytes, DefaultValue);
+		return DefaultValue;
+	}
+};
+
+
+/**
+ * \struct FSavePackedArrayCodec
+ * \brief Encodes homogeneous arrays as one contiguous block, copied in bulk instead of element by element through an archive.
+ *
+ * The block starts with a 16-byte header: the element count (int32), the element size in bytes (int32) and 8 bytes of padding, so the elements start 16-byte aligned within the
+ * payload. Elements follow back to back:
+ * - float: 4 bytes.
+ * - FVector: X, Y and Z as doubles, 24 bytes.
+ * - FTransform: the rotation quaternion (X, Y, Z, W), the translation and the scale as doubles, 80 bytes.
+ *
+ * Components are always stored as doubles, so files read the same with and without large world coordinates. Whenever the in-memory layout matches, as for float arrays and
+ * for vectors with large world coordinates, the whole block is a single memcpy.
+ */
+struct FSavePackedArrayCodec
+{
+	/** \brief Size of the block header in bytes. */
+	static constexpr int32 HeaderSize = 16;
+
+	/** \brief Returns the stored size of one element in bytes. */
+	template <typename ElementType>
+	static constexpr int32 GetElementSize()
+	{
+		if constexpr (std::is_same_v<ElementType, float>)
+		{
+			return sizeof(float);
+		}
+		else if constexpr (std::is_same_v<ElementType, FVector>)
+		{
+			return 3 * sizeof(double);
+		}
+		else
+		{
+			static_assert(std::is_same_v<ElementType, FTransform>, "Only float, FVector and FTransform arrays have a packed encoding.");
+			return 10 * sizeof(double);
+		}
+	}
+
+	/**
+	 * \brief Appends the packed block of an array to a byte array, growing it once to its final size.
+	 * \param Values The elements to encode.
+	 * \param OutBytes The array to append to.
+	 * \return False if the block would not fit in a byte array, in which case nothing is appended.
+	 */
+	template <typename ElementType>
+	static bool Encode(TConstArrayView<ElementType> Values, TArray<uint8>& OutBytes)
+	{
+		constexpr int32 ElementSize = GetElementSize<ElementType>();
+		const int32 Count = Values.Num();
+
+		// The size is computed in 64 bits, large arrays would otherwise wrap around and be written past the block
+		const int64 ElementsSize = static_cast<int64>(Count) * ElementSize;
+		if (static_cast<int64>(OutBytes.Num()) + HeaderSize + ElementsSize > MAX_int32)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Array of %d elements is too large to be packed."), Count);
+			return false;
+		}
+
+		const int32 Offset = OutBytes.AddZeroed(HeaderSize + static_cast<int32>(ElementsSize));
+		uint8* Block = OutBytes.GetData() + Offset;
+		FMemory::Memcpy(Block, &Count, sizeof(int32));
+		FMemory::Memcpy(Block + sizeof(int32), &ElementSize, sizeof(int32));
+
+		uint8* Elements = Block + HeaderSize;
+		if constexpr (IsBitwise<ElementType>())
+		{
+			FMemory::Memcpy(Elements, Values.GetData(), ElementsSize);
+		}
+		else
+		{
+			for (const ElementType& Value : Values)
+			{
+				WriteElement(Value, Elements);
+				Elements += ElementSize;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	 * \brief Decodes a packed block.
+	 * \param Bytes The block, exactly as written by Encode.
+	 * \param OutValues Receives the elements.
+	 * \return False if the block is truncated or holds another element type.
+	 */
+	template <typename ElementType>
+	static bool Decode(TConstArrayView<uint8> Bytes, TArray<ElementType>& OutValues)
+	{
+		constexpr int32 ElementSize = GetElementSize<ElementType>();
+		if (Bytes.Num() < HeaderSize)
+		{
+			return false;
+		}
+
+		int32 Count = 0;
+		int32 StoredElementSize = 0;
+		FMemory::Memcpy(&Count, Bytes.GetData(), sizeof(int32));
+		FMemory::Memcpy(&StoredElementSize, Bytes.GetData() + sizeof(int32), sizeof(int32));
+
+		// The stored count is untrusted, its size is checked against the payload in 64 bits before anything is copied
+		const int64 ElementsSize = static_cast<int64>(Count) * ElementSize;
+		if (Count < 0 || StoredElementSize != ElementSize || ElementsSize != static_cast<int64>(Bytes.Num()) - HeaderSize)
+		{
+			return false;
+		}
+
+		const uint8* Elements = Bytes.GetData() + HeaderSize;
+		if constexpr (IsBitwise<ElementType>())
+		{
+			OutValues.SetNumUninitialized(Count);
+			FMemory::Memcpy(OutValues.GetData(), Elements, ElementsSize);
+		}
+		else
+		{
+			OutValues.Reset(Count);
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				OutValues.Add(ReadElement<ElementType>(Elements));
+				Elements += ElementSize;
+			}
+		}
+
+		return true;
+	}
+
+private:
+
+	/** \brief Returns true if the in-memory layout of the element type is exactly its stored layout. */
+	template <typename ElementType>
+	static constexpr bool IsBitwise()
+	{
+		if constexpr (std::is_same_v<ElementType, FVector>)
+		{
+			return std::is_same_v<FVector::FReal, double> && sizeof(FVector) == GetElementSize<FVector>();
+		}
+		else
+		{
+			return std::is_same_v<ElementType, float>;
+		}
+	}
+
+	static void WriteDoubles(std::initializer_list<double> Values, uint8* OutBytes)
+	{
+		for (const double Value : Values)
+		{
+			FMemory::Memcpy(OutBytes, &Value, sizeof(double));
+			OutBytes += sizeof(double);
+		}
+	}
+
+	static double ReadDouble(const uint8* Bytes, int32 Index)
+	{
+		double Value = 0.0;
+		FMemory::Memcpy(&Value, Bytes + Index * sizeof(double), sizeof(double));
+		return Value;
+	}
+
+	static void WriteElement(const FVector& Value, uint8* OutBytes)
+	{
+		WriteDoubles({ Value.X, Value.Y, Value.Z }, OutBytes);
+	}
+
+	static void WriteElement(const FTransform& Value, uint8* OutBytes)
+	{
+		const FQuat Rotation = Value.GetRotation();
+		const FVector Translation = Value.GetTranslation();
+		const FVector Scale = Value.GetScale3D();
+		WriteDoubles({ Rotation.X, Rotation.Y, Rotation.Z, Rotation.W, Translation.X, Translation.Y, Translation.Z, Scale.X, Scale.Y, Scale.Z }, OutBytes);
+	}
+
+	template <typename ElementType>
+	static ElementType ReadElement(const uint8* Bytes)
+	{
+		if constexpr (std::is_same_v<ElementType, FVector>)
+		{
+			return FVector(ReadDouble(Bytes, 0), ReadDouble(Bytes, 1), ReadDouble(Bytes, 2));
+		}
+		else
+		{
+			const FQuat Rotation(ReadDouble(Bytes, 0), ReadDouble(Bytes, 1), ReadDouble(Bytes, 2), ReadDouble(Bytes, 3));
+			const FVector Translation(ReadDouble(Bytes, 4), ReadDouble(Bytes, 5), ReadDouble(Bytes, 6));
+			const FVector Scale(ReadDouble(Bytes, 7), ReadDouble(Bytes, 8), ReadDouble(Bytes, 9));
+			return FTransform(Rotation, Translation, Scale);
+		}
+	}
+};
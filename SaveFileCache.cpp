@@ -0,0 +1,517 @@
+﻿#include "SaveFileCache.h"
+#include "SaveBTree.h"
+#include "HAL/FileManager.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/UniquePtr.h"
+
+
+FSaveFileCache& FSaveFileCache::Get()
+{
+	static FSaveFileCache Cache;
+	return Cache;
+}
+
+bool FSaveFileCache::FindEntry(const FString& SaveFilePath, FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType)
+{
+	if (!IsCaching())
+	{
+		return FSaveFileFormat::FindEntry(SaveFilePath, Key, OutData, OutDataType);
+	}
+
+	bool bReadFile = false;
+	const TSharedPtr<FCachedFile> CachedFile = AcquireFile(SaveFilePath, bReadFile);
+	if (!CachedFile)
+	{
+		return false;
+	}
+
+	bool bFound = false;
+	TUniquePtr<FArchive> Reader;
+	FSaveIndexEntry Entry;
+	if (LookupEntry(SaveFilePath, CachedFile, Key, Reader, Entry))
+	{
+		TSharedPtr<const TArray<uint8>> Payload;
+		bFound = FindPayload(SaveFilePath, CachedFile, Entry, Reader, Payload) && FSaveFileFormat::ExpandPayload(Entry, *Payload, OutData);
+		OutDataType = Entry.DataType;
+	}
+
+	bReadFile |= Reader.IsValid();
+	RecordAccess(SaveFilePath, bReadFile);
+	return bFound;
+}
+
+bool FSaveFileCache::FindPinnedEntry(const FString& SaveFilePath, FSaveKeyView Key, FSaveDataView& OutView, bool bKeepCompactEncoding)
+{
+	if (!IsCaching())
+	{
+		// Nothing is cached, the payload gets a buffer of its own
+		TSharedRef<TArray<uint8>> Payload = MakeShared<TArray<uint8>>();
+		EDataType DataType;
+		if (!FSaveFileFormat::FindEntry(SaveFilePath, Key, *Payload, DataType))
+		{
+			return false;
+		}
+
+		OutView.SetBuffer(Payload, DataType);
+		return true;
+	}
+
+	bool bReadFile = false;
+	const TSharedPtr<FCachedFile> CachedFile = AcquireFile(SaveFilePath, bReadFile);
+	if (!CachedFile)
+	{
+		return false;
+	}
+
+	bool bFound = false;
+	TUniquePtr<FArchive> Reader;
+	FSaveIndexEntry Entry;
+	TSharedPtr<const TArray<uint8>> Payload;
+	if (LookupEntry(SaveFilePath, CachedFile, Key, Reader, Entry) && FindPayload(SaveFilePath, CachedFile, Entry, Reader, Payload))
+	{
+		if (!Entry.IsCompactEncoded() || bKeepCompactEncoding)
+		{
+			OutView.SetBuffer(Payload.ToSharedRef(), Entry.DataType);
+			OutView.bCompactEncoded = Entry.IsCompactEncoded();
+			bFound = true;
+		}
+		else
+		{
+			TSharedRef<TArray<uint8>> ExpandedPayload = MakeShared<TArray<uint8>>();
+			bFound = FSaveFileFormat::ExpandPayload(Entry, *Payload, *ExpandedPayload);
+			OutView.SetBuffer(ExpandedPayload, Entry.DataType);
+		}
+	}
+
+	bReadFile |= Reader.IsValid();
+	RecordAccess(SaveFilePath, bReadFile);
+	return bFound;
+}
+
+bool FSaveFileCache::FindEntries(const FString& SaveFilePath, TConstArrayView<FString> Keys, TMap<FString, FSerializedData>& OutEntries, TArray<FString>& OutMissingKeys)
+{
+	if (!IsCaching())
+	{
+		return FSaveFileFormat::FindEntries(SaveFilePath, Keys, OutEntries, OutMissingKeys);
+	}
+
+	bool bReadFile = false;
+	const TSharedPtr<FCachedFile> CachedFile = AcquireFile(SaveFilePath, bReadFile);
+	if (!CachedFile)
+	{
+		OutMissingKeys.Append(Keys.GetData(), Keys.Num());
+		return false;
+	}
+
+	// The file is opened at most once, for all the payloads that are not cached yet
+	TUniquePtr<FArchive> Reader;
+	for (const FString& Key : Keys)
+	{
+		FSaveIndexEntry Entry;
+		TSharedPtr<const TArray<uint8>> Payload;
+
+		FSerializedData SerializedData;
+		if (LookupEntry(SaveFilePath, CachedFile, FSaveKey(Key), Reader, Entry) && FindPayload(SaveFilePath, CachedFile, Entry, Reader, Payload)
+			&& FSaveFileFormat::ExpandPayload(Entry, *Payload, SerializedData.Data))
+		{
+			SerializedData.Key = Key;
+			SerializedData.DataType = Entry.DataType;
+			OutEntries.Add(Key, MoveTemp(SerializedData));
+		}
+		else
+		{
+			OutMissingKeys.Add(Key);
+		}
+	}
+
+	bReadFile |= Reader.IsValid();
+	RecordAccess(SaveFilePath, bReadFile);
+	return OutMissingKeys.Num() == 0;
+}
+
+bool FSaveFileCache::GetIndexEntries(const FString& SaveFilePath, const FString& Prefix, TArray<FSaveIndexEntry>& OutEntries)
+{
+	const TSharedPtr<FCachedFile> CachedFile = AcquireIndex(SaveFilePath);
+	if (!CachedFile)
+	{
+		return false;
+	}
+
+	if (CachedFile->Index.StorageEngine == ESaveStorageEngine::BTree)
+	{
+		// Only the leaves holding the matching keys are read from the tree, and nothing of them is cached
+		TUniquePtr<FArchive> Reader = FSaveFileFormat::CreateReader(SaveFilePath);
+		FSaveBTree Tree;
+		return Reader && Tree.OpenRead(*Reader) && Tree.FindByPrefix(Prefix, OutEntries);
+	}
+
+	// The keys are sorted by the first prefix query on a cached index, which is the only change made to it once it is loaded. Deciding under the lock means the index can then
+	// be read without it. An index read for this call only is scanned rather than sorted
+	SortKeys(SaveFilePath, CachedFile);
+
+	TArray<const FSaveIndexEntry*> Entries;
+	CachedFile->Index.FindByPrefix(Prefix, Entries);
+
+	OutEntries.Reserve(OutEntries.Num() + Entries.Num());
+	for (const FSaveIndexEntry* Entry : Entries)
+	{
+		OutEntries.Add(*Entry);
+	}
+
+	return true;
+}
+
+bool FSaveFileCache::FindIndexEntry(const FString& SaveFilePath, FSaveKeyView Key, FSaveIndexEntry& OutEntry)
+{
+	const TSharedPtr<FCachedFile> CachedFile = AcquireIndex(SaveFilePath);
+	TUniquePtr<FArchive> Reader;
+	return CachedFile && LookupEntry(SaveFilePath, CachedFile, Key, Reader, OutEntry);
+}
+
+void FSaveFileCache::Invalidate(const FString& SaveFilePath)
+{
+	FScopeLock Lock(&CriticalSection);
+	RemoveFile(SaveFilePath);
+}
+
+void FSaveFileCache::Empty()
+{
+	FScopeLock Lock(&CriticalSection);
+	Files.Empty();
+	MemorySize = 0;
+}
+
+void FSaveFileCache::SetMemoryBudget(int64 InMemoryBudget)
+{
+	FScopeLock Lock(&CriticalSection);
+	MemoryBudget = FMath::Max<int64>(InMemoryBudget, 0);
+	EvictToBudget(FString());
+}
+
+int64 FSaveFileCache::GetMemoryBudget() const
+{
+	FScopeLock Lock(&CriticalSection);
+	return MemoryBudget;
+}
+
+FSaveLoadCacheStats FSaveFileCache::GetStats() const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	FSaveLoadCacheStats Stats;
+	Stats.Hits = Hits;
+	Stats.Misses = Misses;
+	Stats.Evictions = Evictions;
+	Stats.CachedFiles = Files.Num();
+	Stats.MemoryUsage = MemorySize;
+	Stats.MemoryBudget = MemoryBudget;
+	return Stats;
+}
+
+void FSaveFileCache::ResetStats()
+{
+	FScopeLock Lock(&CriticalSection);
+	Hits = 0;
+	Misses = 0;
+	Evictions = 0;
+}
+
+bool FSaveFileCache::IsCaching()
+{
+	FScopeLock Lock(&CriticalSection);
+	if (MemoryBudget > 0)
+	{
+		return true;
+	}
+
+	// Every access reads the file when nothing is cached
+	++Misses;
+	return false;
+}
+
+TSharedPtr<FSaveFileCache::FCachedFile> FSaveFileCache::AcquireFile(const FString& SaveFilePath, bool& bOutReadFile)
+{
+	const FFileStatData StatData = IFileManager::Get().GetStatData(*SaveFilePath);
+	{
+		FScopeLock Lock(&CriticalSection);
+
+		// Drop the cached file if it was changed behind our back
+		TSharedPtr<FCachedFile> CachedFile = Files.FindRef(SaveFilePath);
+		if (CachedFile && (!StatData.bIsValid || CachedFile->ModificationTime != StatData.ModificationTime || CachedFile->FileSize != StatData.FileSize))
+		{
+			RemoveFile(SaveFilePath);
+			CachedFile.Reset();
+		}
+
+		if (!StatData.bIsValid)
+		{
+			++Misses;
+			return nullptr;
+		}
+
+		if (CachedFile)
+		{
+			CachedFile->LastAccess = ++AccessCounter;
+			return CachedFile;
+		}
+	}
+
+	// The file is read without holding the lock, so loads of other files are not blocked behind it
+	bOutReadFile = true;
+	TSharedPtr<FCachedFile> LoadedFile = LoadFile(SaveFilePath);
+
+	FScopeLock Lock(&CriticalSection);
+	if (!LoadedFile)
+	{
+		++Misses;
+		return nullptr;
+	}
+
+	// Another thread may have loaded the same file meanwhile, the first one cached is kept. The stats taken before reading make any write since then invalidate it
+	TSharedPtr<FCachedFile> CachedFile = Files.FindRef(SaveFilePath);
+	if (!CachedFile || CachedFile->ModificationTime != StatData.ModificationTime || CachedFile->FileSize != StatData.FileSize)
+	{
+		RemoveFile(SaveFilePath);
+		CachedFile = LoadedFile;
+		CachedFile->ModificationTime = StatData.ModificationTime;
+		CachedFile->FileSize = StatData.FileSize;
+		Files.Add(SaveFilePath, CachedFile);
+		MemorySize += CachedFile->MemorySize;
+	}
+
+	CachedFile->LastAccess = ++AccessCounter;
+	return CachedFile;
+}
+
+TSharedPtr<FSaveFileCache::FCachedFile> FSaveFileCache::AcquireIndex(const FString& SaveFilePath)
+{
+	if (!IsCaching())
+	{
+		// Nothing is cached, the index is read for this call only
+		return LoadFile(SaveFilePath);
+	}
+
+	bool bReadFile = false;
+	const TSharedPtr<FCachedFile> CachedFile = AcquireFile(SaveFilePath, bReadFile);
+	if (CachedFile)
+	{
+		RecordAccess(SaveFilePath, bReadFile);
+	}
+
+	return CachedFile;
+}
+
+bool FSaveFileCache::LookupEntry(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile, FSaveKeyView Key, TUniquePtr<FArchive>& Reader,
+	FSaveIndexEntry& OutEntry)
+{
+	{
+		FScopeLock Lock(&CriticalSection);
+		if (const FSaveIndexEntry* Entry = CachedFile->Index.Find(Key))
+		{
+			OutEntry = *Entry;
+			return true;
+		}
+
+		if (CachedFile->Index.StorageEngine != ESaveStorageEngine::BTree)
+		{
+			return false;
+		}
+	}
+
+	// The entry is not cached yet, look it up in the tree, which reads one node per level
+	if (!Reader)
+	{
+		Reader = FSaveFileFormat::CreateReader(SaveFilePath);
+		if (!Reader)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+			return false;
+		}
+	}
+
+	FSaveBTree Tree;
+	if (!Tree.OpenRead(*Reader) || !Tree.Find(Key, OutEntry))
+	{
+		return false;
+	}
+
+	// Only files that are still cached keep the entry, files read for a single call or evicted meanwhile do not count against the budget
+	FScopeLock Lock(&CriticalSection);
+	const FSaveKey EntryKey = OutEntry.GetSaveKey();
+	if (Files.FindRef(SaveFilePath) == CachedFile && !CachedFile->Index.Entries.Contains(EntryKey))
+	{
+		const int64 EntrySize = sizeof(TPair<FSaveKey, FSaveIndexEntry>) + 2 * OutEntry.Key.GetAllocatedSize();
+		CachedFile->MemorySize += EntrySize;
+		MemorySize += EntrySize;
+		CachedFile->Index.Entries.Add(EntryKey, OutEntry);
+	}
+
+	return true;
+}
+
+bool FSaveFileCache::FindPayload(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile, const FSaveIndexEntry& Entry, TUniquePtr<FArchive>& Reader,
+	TSharedPtr<const TArray<uint8>>& OutPayload)
+{
+	const FSaveKeyView EntryKey = Entry.GetKeyView();
+	{
+		FScopeLock Lock(&CriticalSection);
+		if (const TSharedRef<const TArray<uint8>>* Payload = CachedFile->Payloads.FindByHash(GetTypeHash(EntryKey), EntryKey))
+		{
+			OutPayload = *Payload;
+			return true;
+		}
+	}
+
+	// The index is cached but this payload was never loaded, read just this payload, without holding the lock
+	if (!Reader)
+	{
+		Reader = FSaveFileFormat::CreateReader(SaveFilePath);
+		if (!Reader)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+			return false;
+		}
+	}
+
+	// Compact payloads are cached compact, LoadValue decodes them straight into values and everything else expands them on the way out
+	TSharedRef<TArray<uint8>> Payload = MakeShared<TArray<uint8>>();
+	if (!FSaveFileFormat::ReadDecompressedPayload(*Reader, Entry, *Payload))
+	{
+		return false;
+	}
+
+	FScopeLock Lock(&CriticalSection);
+	AddPayload(SaveFilePath, CachedFile, Entry.GetSaveKey(), Payload);
+	OutPayload = Payload;
+	return true;
+}
+
+void FSaveFileCache::RecordAccess(const FString& SaveFilePath, bool bReadFile)
+{
+	FScopeLock Lock(&CriticalSection);
+	if (bReadFile)
+	{
+		++Misses;
+		EvictToBudget(SaveFilePath);
+	}
+	else
+	{
+		++Hits;
+	}
+}
+
+TSharedPtr<FSaveFileCache::FCachedFile> FSaveFileCache::LoadFile(const FString& SaveFilePath)
+{
+	TSharedPtr<FCachedFile> CachedFile = MakeShared<FCachedFile>();
+	TUniquePtr<FArchive> Reader = FSaveFileFormat::CreateReader(SaveFilePath, &CachedFile->Index.StorageEngine);
+	if (!Reader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		return nullptr;
+	}
+
+	// Trees can hold more keys than fit in memory, their entries are cached as they are looked up
+	if (CachedFile->Index.StorageEngine == ESaveStorageEngine::BTree)
+	{
+		FSaveBTree Tree;
+		if (!Tree.OpenRead(*Reader))
+		{
+			return nullptr;
+		}
+
+		CachedFile->MemorySize = sizeof(FCachedFile);
+		return CachedFile;
+	}
+
+	FSaveFileHeader Header;
+	if (FSaveFileFormat::ReadHeader(*Reader, Header))
+	{
+		if (!FSaveFileFormat::ReadIndex(*Reader, Header, CachedFile->Index))
+		{
+			return nullptr;
+		}
+	}
+	else
+	{
+		// Legacy files are indexed by a scan that skips every payload, payloads are then loaded on demand just like for indexed files
+		if (Reader->IsError() || !FSaveFileFormat::ReadLegacyIndex(*Reader, CachedFile->Index))
+		{
+			return nullptr;
+		}
+	}
+
+	// Only the index is cached up front, payloads are loaded on demand and the keys are sorted by the first prefix query
+	CachedFile->MemorySize = sizeof(FCachedFile) + CachedFile->Index.KeyFilter.GetAllocatedSize();
+	for (const TPair<FSaveKey, FSaveIndexEntry>& Pair : CachedFile->Index.Entries)
+	{
+		CachedFile->MemorySize += sizeof(TPair<FSaveKey, FSaveIndexEntry>) + Pair.Key.GetKey().GetAllocatedSize() + Pair.Value.Key.GetAllocatedSize();
+	}
+
+	return CachedFile;
+}
+
+void FSaveFileCache::SortKeys(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile)
+{
+	FScopeLock Lock(&CriticalSection);
+	if (CachedFile->Index.bKeysSorted || Files.FindRef(SaveFilePath) != CachedFile)
+	{
+		return;
+	}
+
+	CachedFile->Index.SortKeys();
+
+	// The sorted keys hold a second copy of every key
+	int64 SortedKeysSize = CachedFile->Index.SortedKeys.GetAllocatedSize();
+	for (const FSaveKey& Key : CachedFile->Index.SortedKeys)
+	{
+		SortedKeysSize += Key.GetKey().GetAllocatedSize();
+	}
+
+	CachedFile->MemorySize += SortedKeysSize;
+	MemorySize += SortedKeysSize;
+}
+
+void FSaveFileCache::AddPayload(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile, const FSaveKey& Key, const TSharedRef<const TArray<uint8>>& Payload)
+{
+	// The file may have been evicted or invalidated, or the payload loaded by another thread, while it was read
+	if (Files.FindRef(SaveFilePath) != CachedFile || CachedFile->Payloads.Contains(Key))
+	{
+		return;
+	}
+
+	const int64 PayloadSize = sizeof(TPair<FSaveKey, TSharedRef<const TArray<uint8>>>) + sizeof(TArray<uint8>) + Key.GetKey().GetAllocatedSize() + Payload->GetAllocatedSize();
+	CachedFile->Payloads.Add(Key, Payload);
+	CachedFile->MemorySize += PayloadSize;
+	MemorySize += PayloadSize;
+}
+
+void FSaveFileCache::EvictToBudget(const FString& InUseFilePath)
+{
+	while (MemorySize > MemoryBudget && Files.Num() > 0)
+	{
+		// Find the least recently used file, keeping the one in use as the last resort
+		const FString* EvictedPath = nullptr;
+		uint64 OldestAccess = MAX_uint64;
+		for (const TPair<FString, TSharedPtr<FCachedFile>>& Pair : Files)
+		{
+			if (Pair.Value->LastAccess < OldestAccess && Pair.Key != InUseFilePath)
+			{
+				OldestAccess = Pair.Value->LastAccess;
+				EvictedPath = &Pair.Key;
+			}
+		}
+
+		const FString PathToEvict = EvictedPath ? *EvictedPath : InUseFilePath;
+		RemoveFile(PathToEvict);
+		++Evictions;
+	}
+}
+
+void FSaveFileCache::RemoveFile(const FString& SaveFilePath)
+{
+	TSharedPtr<FCachedFile> CachedFile;
+	if (Files.RemoveAndCopyValue(SaveFilePath, CachedFile))
+	{
+		MemorySize -= CachedFile->MemorySize;
+	}
+}
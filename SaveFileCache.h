@@ -0,0 +1,182 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SaveFileFormat.h"
+
+
+/**
+ * \class FSaveFileCache
+ * \brief A process-wide cache of parsed save files, keyed by file path.
+ *
+ * For every cached file it holds the live key index and the payloads loaded so far, so repeated lookups in the same file are served from memory. Legacy files have no stored
+ * index, so one is built for them by a scan that skips every payload. B+tree files are never indexed as a whole, their entries are looked up in the tree and cached one by one.
+ *
+ * Cached files are invalidated by writes through USaveLoadManager and whenever the modification time or size of the file on disk no longer matches. The cache stays within a
+ * memory budget by evicting the least recently used files. Files are read without holding the lock of the cache, so a load that has to go to disk does not block the others.
+ */
+class FSaveFileCache
+{
+public:
+
+	/** \brief Returns the process-wide cache. */
+	static FSaveFileCache& Get();
+
+	/**
+	 * \brief Finds an entry of a save file, serving it from memory when possible.
+	 * \param SaveFilePath The file to search.
+	 * \param Key The key to look for.
+	 * \param OutData Receives the payload bytes.
+	 * \param OutDataType Receives the data type of the entry.
+	 * \return True if the key was found.
+	 */
+	bool FindEntry(const FString& SaveFilePath, FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType);
+
+	/**
+	 * \brief Finds an entry of a save file and returns a view of its cached payload buffer itself instead of a copy.
+	 *
+	 * The viewed buffer is shared with the cache and must not be modified. It stays alive while it is referenced, even after the file is evicted or invalidated, in which case
+	 * it no longer counts against the memory budget. Compactly encoded payloads are cached compact, so they are only shared when bKeepCompactEncoding is set and are otherwise
+	 * expanded into a buffer of their own.
+	 *
+	 * \param SaveFilePath The file to search.
+	 * \param Key The key to look for.
+	 * \param OutView Receives the pinned view of the payload and its data type.
+	 * \param bKeepCompactEncoding If set, compactly encoded payloads are viewed as they are cached, see FSaveDataView::bCompactEncoded.
+	 * \return True if the key was found.
+	 */
+	bool FindPinnedEntry(const FString& SaveFilePath, FSaveKeyView Key, FSaveDataView& OutView, bool bKeepCompactEncoding = false);
+
+	/**
+	 * \brief Finds many entries of a save file at once, reading the file at most once for everything that is not cached yet.
+	 * \param SaveFilePath The file to search.
+	 * \param Keys The keys to look for.
+	 * \param OutEntries Receives the found entries by key.
+	 * \param OutMissingKeys Receives the keys that were not found.
+	 * \return True if every key was found.
+	 */
+	bool FindEntries(const FString& SaveFilePath, TConstArrayView<FString> Keys, TMap<FString, FSerializedData>& OutEntries, TArray<FString>& OutMissingKeys);
+
+	/**
+	 * \brief Returns the live index entries of a save file whose key starts with a prefix, without loading any payload.
+	 * \param SaveFilePath The file to list.
+	 * \param Prefix The prefix the keys must start with, ignoring case. An empty prefix matches every entry.
+	 * \param OutEntries Receives a copy of the matching index entries, in key order.
+	 * \return False if the file could not be read.
+	 */
+	bool GetIndexEntries(const FString& SaveFilePath, const FString& Prefix, TArray<FSaveIndexEntry>& OutEntries);
+
+	/**
+	 * \brief Finds the index entry of a key without loading its payload.
+	 * \param SaveFilePath The file to search.
+	 * \param Key The key to look for.
+	 * \param OutEntry Receives a copy of the index entry.
+	 * \return True if the key was found.
+	 */
+	bool FindIndexEntry(const FString& SaveFilePath, FSaveKeyView Key, FSaveIndexEntry& OutEntry);
+
+	/**
+	 * \brief Drops a file from the cache. Called for every write through USaveLoadManager.
+	 * \param SaveFilePath The file to drop.
+	 */
+	void Invalidate(const FString& SaveFilePath);
+
+	/** \brief Drops every cached file. */
+	void Empty();
+
+	/** \brief Sets the memory budget in bytes and evicts files until the cache fits. A budget of 0 disables caching. */
+	void SetMemoryBudget(int64 InMemoryBudget);
+
+	/** \brief Returns the memory budget in bytes. */
+	int64 GetMemoryBudget() const;
+
+	/** \brief Returns the hit and miss counters and the current memory usage. */
+	FSaveLoadCacheStats GetStats() const;
+
+	/** \brief Resets the hit, miss and eviction counters. */
+	void ResetStats();
+
+private:
+
+	/** \brief A single cached file. */
+	struct FCachedFile
+	{
+		/** \brief Modification time of the file when it was cached. */
+		FDateTime ModificationTime;
+
+		/** \brief Size of the file when it was cached. */
+		int64 FileSize = 0;
+
+		/** \brief The live index of the file. For legacy files it is built by scanning the record headers, for B+tree files it only holds the entries found so far. */
+		FSaveFileIndex Index;
+
+		/**
+		 * \brief The payloads loaded so far, by key, decompressed but with compactly encoded payloads left compact. They are shared so pinned views can outlive the cache entry.
+		 */
+		TMap<FSaveKey, TSharedRef<const TArray<uint8>>> Payloads;
+
+		/** \brief Approximate memory used by this file in bytes. */
+		int64 MemorySize = 0;
+
+		/** \brief Value of the access counter at the last access, used for LRU eviction. */
+		uint64 LastAccess = 0;
+	};
+
+	/** \brief Returns true if the memory budget allows caching, otherwise counts the access as a miss. */
+	bool IsCaching();
+
+	/** \brief Returns the cached file for a path, loading it if it is not cached or out of date. Sets bOutReadFile if the file had to be read. Counts a missing file as a miss. */
+	TSharedPtr<FCachedFile> AcquireFile(const FString& SaveFilePath, bool& bOutReadFile);
+
+	/** \brief Returns the cached file for a path with its index, and counts the access. Without a memory budget the index is read for this call only. */
+	TSharedPtr<FCachedFile> AcquireIndex(const FString& SaveFilePath);
+
+	/**
+	 * \brief Copies the index entry of a key from memory, or looks it up in the tree of B+tree files and caches it, using Reader, which is opened on first use. The tree is read
+	 * without holding the lock.
+	 */
+	bool LookupEntry(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile, FSaveKeyView Key, TUniquePtr<FArchive>& Reader, FSaveIndexEntry& OutEntry);
+
+	/**
+	 * \brief Returns the payload of an entry from memory, or reads it without holding the lock using Reader, which is opened on first use, and caches it. Compactly encoded
+	 * payloads are returned compact, see FSaveFileFormat::ExpandPayload.
+	 */
+	bool FindPayload(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile, const FSaveIndexEntry& Entry, TUniquePtr<FArchive>& Reader,
+		TSharedPtr<const TArray<uint8>>& OutPayload);
+
+	/** \brief Counts an access as a hit or a miss, and evicts files after a miss since it may have grown the cache. */
+	void RecordAccess(const FString& SaveFilePath, bool bReadFile);
+
+	/** \brief Reads the index of a file, or scans the record headers of legacy files. B+tree files start with an empty index. Returns nullptr on failure. */
+	static TSharedPtr<FCachedFile> LoadFile(const FString& SaveFilePath);
+
+	/** \brief Sorts the keys of a cached file for prefix queries and accounts for their memory, unless they are sorted already or the file is no longer cached. */
+	void SortKeys(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile);
+
+	/** \brief Adds a payload to a cached file and accounts for its memory, unless the file is no longer cached or already holds the payload. */
+	void AddPayload(const FString& SaveFilePath, const TSharedPtr<FCachedFile>& CachedFile, const FSaveKey& Key, const TSharedRef<const TArray<uint8>>& Payload);
+
+	/** \brief Evicts least recently used files until the cache fits its memory budget. The file being used is evicted last. */
+	void EvictToBudget(const FString& InUseFilePath);
+
+	/** \brief Removes a file and its memory from the cache. */
+	void RemoveFile(const FString& SaveFilePath);
+
+	/** \brief Guards all members and the contents of the cached files, the cache can be used from several threads. Never held while a file is read. */
+	mutable FCriticalSection CriticalSection;
+
+	/** \brief The cached files by path. */
+	TMap<FString, TSharedPtr<FCachedFile>> Files;
+
+	/** \brief Memory budget in bytes. */
+	int64 MemoryBudget = 64 * 1024 * 1024;
+
+	/** \brief Approximate memory used by all cached files in bytes. */
+	int64 MemorySize = 0;
+
+	/** \brief Monotonic counter stamped on files when they are accessed. */
+	uint64 AccessCounter = 0;
+
+	int64 Hits = 0;
+	int64 Misses = 0;
+	int64 Evictions = 0;
+};
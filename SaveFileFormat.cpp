@@ -0,0 +1,1581 @@
+﻿#include "SaveFileFormat.h"
+#include "SaveBTree.h"
+#include "SavePageStore.h"
+#include "SaveSpatialCodec.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/StableSort.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Templates/UniquePtr.h"
+
+
+bool FSaveFileFormat::ReadHeader(FArchive& Ar, FSaveFileHeader& OutHeader)
+{
+	// Legacy files have no header, and an empty file has nothing to read at all
+	if (Ar.TotalSize() < FSaveFileHeader::MinSerializedSize)
+	{
+		Ar.Seek(0);
+		return false;
+	}
+
+	Ar << OutHeader;
+
+	if (OutHeader.Magic != FSaveFileHeader::MagicNumber)
+	{
+		// No magic number, this is a legacy file starting with its first entry
+		Ar.Seek(0);
+		return false;
+	}
+
+	if (!OutHeader.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Unsupported save file version: %d"), OutHeader.Version);
+		Ar.SetError();
+		return false;
+	}
+
+	return !Ar.IsError();
+}
+
+void FSaveFileIndex::ApplyRecord(const FSaveIndexEntry& Record)
+{
+	RecordBytes += Record.GetRecordSize();
+	SortedKeys.Reset();
+	bKeysSorted = false;
+
+	// The previous record of the key, if any, becomes garbage
+	const FSaveKey RecordKey = Record.GetSaveKey();
+	if (const FSaveIndexEntry* Previous = Entries.Find(RecordKey))
+	{
+		LiveRecordBytes -= Previous->GetRecordSize();
+	}
+
+	if (EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Record.Flags), ESaveRecordFlags::Tombstone))
+	{
+		Entries.Remove(RecordKey);
+	}
+	else
+	{
+		LiveRecordBytes += Record.GetRecordSize();
+		Entries.Add(RecordKey, Record);
+		KeyFilter.Add(Record.KeyHash);
+	}
+}
+
+void FSaveFileIndex::RebuildKeyFilter()
+{
+	KeyFilter.Reset(Entries.Num());
+	for (const TPair<FSaveKey, FSaveIndexEntry>& Pair : Entries)
+	{
+		KeyFilter.Add(Pair.Key.GetHash());
+	}
+}
+
+void FSaveFileIndex::SortKeys()
+{
+	Entries.GenerateKeyArray(SortedKeys);
+	SortedKeys.Sort([](const FSaveKey& A, const FSaveKey& B)
+	{
+		return A.GetKey().Compare(B.GetKey(), ESearchCase::IgnoreCase) < 0;
+	});
+	bKeysSorted = true;
+}
+
+void FSaveFileIndex::FindByPrefix(const FString& Prefix, TArray<const FSaveIndexEntry*>& OutEntries) const
+{
+	if (!bKeysSorted)
+	{
+		for (const TPair<FSaveKey, FSaveIndexEntry>& Pair : Entries)
+		{
+			if (Pair.Key.GetKey().StartsWith(Prefix, ESearchCase::IgnoreCase))
+			{
+				OutEntries.Add(&Pair.Value);
+			}
+		}
+		return;
+	}
+
+	// Every key starting with the prefix sorts at or after it, and before any key that does not
+	const int32 First = Algo::LowerBound(SortedKeys, Prefix, [](const FSaveKey& SortedKey, const FString& Value)
+	{
+		return SortedKey.GetKey().Compare(Value, ESearchCase::IgnoreCase) < 0;
+	});
+
+	for (int32 KeyIndex = First; KeyIndex < SortedKeys.Num() && SortedKeys[KeyIndex].GetKey().StartsWith(Prefix, ESearchCase::IgnoreCase); ++KeyIndex)
+	{
+		if (const FSaveIndexEntry* Entry = Entries.Find(SortedKeys[KeyIndex]))
+		{
+			OutEntries.Add(Entry);
+		}
+	}
+}
+
+bool FSaveFileFormat::ReadIndex(FArchive& Ar, const FSaveFileHeader& Header, FSaveFileIndex& OutIndex)
+{
+	int64 IndexEndOffset = 0;
+	const bool bStoredKeyFilter = ReadKeyFilter(Ar, Header, OutIndex.KeyFilter, IndexEndOffset);
+	return !Ar.IsError() && ReadIndexAfterKeyFilter(Ar, Header, bStoredKeyFilter, OutIndex);
+}
+
+bool FSaveFileFormat::ReadIndexAfterKeyFilter(FArchive& Ar, const FSaveFileHeader& Header, bool bStoredKeyFilter, FSaveFileIndex& OutIndex)
+{
+	if (Header.IndexOffset < Header.GetSerializedSize() || Header.IndexOffset > Ar.TotalSize())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted save file index offset: %lld"), Header.IndexOffset);
+		return false;
+	}
+
+	if (!bStoredKeyFilter)
+	{
+		Ar.Seek(Header.IndexOffset);
+	}
+
+	TArray<FSaveIndexEntry> StoredIndex;
+	SerializeIndex(Ar, StoredIndex, Header.Version);
+
+	if (Ar.IsError())
+	{
+		return false;
+	}
+
+	OutIndex.Header = Header;
+	OutIndex.FileSize = Ar.TotalSize();
+	OutIndex.bTornTail = false;
+	OutIndex.RecordBytes = Header.IndexOffset - Header.GetSerializedSize();
+	OutIndex.LiveRecordBytes = 0;
+	OutIndex.Entries.Reset();
+	OutIndex.Entries.Reserve(StoredIndex.Num());
+
+	for (FSaveIndexEntry& Entry : StoredIndex)
+	{
+		// Entries deleted in place keep their record in the file as garbage, but are not live anymore
+		if (EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Entry.Flags), ESaveRecordFlags::Tombstone))
+		{
+			continue;
+		}
+
+		OutIndex.LiveRecordBytes += Entry.GetRecordSize();
+		const FSaveKey EntryKey = Entry.GetSaveKey();
+		OutIndex.Entries.Add(EntryKey, MoveTemp(Entry));
+	}
+
+	if (!bStoredKeyFilter)
+	{
+		OutIndex.RebuildKeyFilter();
+	}
+
+	// Replay the record log appended after the index, reading record headers only
+	while (Ar.Tell() < OutIndex.FileSize)
+	{
+		FSaveIndexEntry Record;
+		Record.RecordOffset = Ar.Tell();
+
+		Ar << Record.Flags;
+		Ar << Record.DataType;
+		Ar << Record.Key;
+		Ar << Record.DataSize;
+
+		Record.DataOffset = Ar.Tell();
+		Record.KeyHash = FSaveKey::HashKey(Record.Key);
+
+		if (Ar.IsError() || Record.DataSize < 0 || Record.DataOffset + Record.DataSize > OutIndex.FileSize)
+		{
+			// A torn append, e.g. from a crash mid-write, only loses the record that was being written. The file ends there until it is rewritten
+			UE_LOG(LogTemp, Warning, TEXT("Ignoring truncated save file record at offset %lld"), Record.RecordOffset);
+			Ar.ClearError();
+			OutIndex.FileSize = Record.RecordOffset;
+			OutIndex.bTornTail = true;
+			break;
+		}
+
+		Ar.Seek(Record.DataOffset + Record.DataSize);
+		OutIndex.ApplyRecord(Record);
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::ReadKeyFilter(FArchive& Ar, const FSaveFileHeader& Header, FSaveKeyFilter& OutKeyFilter, int64& OutIndexEndOffset)
+{
+	if (Header.Version < FSaveFileHeader::KeyFilterVersion || Header.IndexOffset < Header.GetSerializedSize() || Header.IndexOffset > Ar.TotalSize())
+	{
+		return false;
+	}
+
+	Ar.Seek(Header.IndexOffset);
+	Ar << OutIndexEndOffset;
+	Ar << OutKeyFilter;
+
+	if (Ar.IsError() || OutIndexEndOffset < Ar.Tell() || OutIndexEndOffset > Ar.TotalSize())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted save file key filter at offset %lld"), Header.IndexOffset);
+		Ar.SetError();
+		return false;
+	}
+
+	return true;
+}
+
+TUniquePtr<FArchive> FSaveFileFormat::CreateReader(const FString& SaveFilePath, ESaveStorageEngine* OutStorageEngine)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*SaveFilePath));
+	const bool bPaged = Reader && FSavePageStore::IsPageStore(*Reader);
+	if (OutStorageEngine)
+	{
+		*OutStorageEngine = bPaged ? ESaveStorageEngine::Paged : ESaveStorageEngine::File;
+	}
+
+	if (!bPaged)
+	{
+		return Reader;
+	}
+
+	// The save file bytes of a page store are read through its current page table
+	Reader.Reset();
+	TUniquePtr<FSavePageStore> PageStore = MakeUnique<FSavePageStore>();
+	if (!PageStore->OpenRead(SaveFilePath))
+	{
+		return nullptr;
+	}
+
+	TUniquePtr<FArchive> PagedReader = MakeUnique<FSavePageStoreReader>(MoveTemp(PageStore), SaveFilePath);
+
+	// Page stores hold either an indexed save file or a B+tree, told apart by the magic number at the start of the image
+	if (OutStorageEngine && FSaveBTree::IsBTree(*PagedReader))
+	{
+		*OutStorageEngine = ESaveStorageEngine::BTree;
+	}
+
+	return PagedReader;
+}
+
+ESaveStorageEngine FSaveFileFormat::GetStorageEngine(const FString& SaveFilePath)
+{
+	ESaveStorageEngine StorageEngine = ESaveStorageEngine::File;
+	CreateReader(SaveFilePath, &StorageEngine);
+	return StorageEngine;
+}
+
+bool FSaveFileFormat::ReadTreeIndex(FArchive& Ar, FSaveFileIndex& OutIndex)
+{
+	FSaveBTree Tree;
+	if (!Tree.OpenRead(Ar) || !Tree.ReadIndex(OutIndex))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted B+tree save file: %s"), *Ar.GetArchiveName());
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::ReadIndex(const FString& SaveFilePath, FSaveFileIndex& OutIndex)
+{
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath, &OutIndex.StorageEngine);
+	if (!Reader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	if (OutIndex.StorageEngine == ESaveStorageEngine::BTree)
+	{
+		return ReadTreeIndex(*Reader, OutIndex);
+	}
+
+	FSaveFileHeader Header;
+	return ReadHeader(*Reader, Header) && ReadIndex(*Reader, Header, OutIndex);
+}
+
+bool FSaveFileFormat::ReadCompressionSettings(const FString& SaveFilePath, FSaveCompressionSettings& OutSettings)
+{
+	ESaveStorageEngine StorageEngine = ESaveStorageEngine::File;
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath, &StorageEngine);
+	if (!Reader)
+	{
+		return false;
+	}
+
+	// Trees record their settings in the tree header
+	if (StorageEngine == ESaveStorageEngine::BTree)
+	{
+		FSaveBTree Tree;
+		if (!Tree.OpenRead(*Reader))
+		{
+			return false;
+		}
+
+		OutSettings = Tree.GetCompressionSettings();
+		return true;
+	}
+
+	FSaveFileHeader Header;
+	if (!ReadHeader(*Reader, Header) || Header.Version < FSaveFileHeader::CompressionVersion)
+	{
+		return false;
+	}
+
+	OutSettings = Header.GetCompressionSettings();
+	return true;
+}
+
+bool FSaveFileFormat::ReadPayload(FArchive& Ar, const FSaveIndexEntry& Entry, TArray<uint8>& OutData, ESaveCompression* OutCompression,
+	ESaveSpatialEncoding* OutSpatialEncoding)
+{
+	if (Entry.DataSize < 0 || Entry.DataOffset < 0 || Entry.DataOffset + Entry.DataSize > Ar.TotalSize())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	// Seek straight to the payload, nothing else of the record is needed
+	Ar.Seek(Entry.DataOffset);
+
+	if (Entry.IsStoredRaw())
+	{
+		// Raw payloads are read straight into the output
+		OutData.SetNumUninitialized(Entry.DataSize);
+		Ar.Serialize(OutData.GetData(), Entry.DataSize);
+
+		if (OutCompression)
+		{
+			*OutCompression = GetRawEntryCompression(Entry);
+		}
+
+		if (OutSpatialEncoding)
+		{
+			*OutSpatialEncoding = GetKeptSpatialEncoding(Entry, ESaveSpatialEncoding::Archive);
+		}
+
+		return !Ar.IsError();
+	}
+
+	TArray<uint8> StoredData;
+	StoredData.SetNumUninitialized(Entry.DataSize);
+	Ar.Serialize(StoredData.GetData(), Entry.DataSize);
+
+	return !Ar.IsError() && DecodePayload(Entry, StoredData, OutData, OutCompression, OutSpatialEncoding);
+}
+
+bool FSaveFileFormat::DecodePayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8> StoredData, TArray<uint8>& OutData, ESaveCompression* OutCompression,
+	ESaveSpatialEncoding* OutSpatialEncoding)
+{
+	TArray<uint8> DecompressedData;
+	if (Entry.IsCompressed())
+	{
+		if (!DecompressPayload(Entry, StoredData, DecompressedData, OutCompression))
+		{
+			return false;
+		}
+	}
+	else if (OutCompression)
+	{
+		*OutCompression = GetRawEntryCompression(Entry);
+	}
+
+	if (!Entry.IsCompactEncoded())
+	{
+		if (Entry.IsCompressed())
+		{
+			OutData = MoveTemp(DecompressedData);
+		}
+		else
+		{
+			OutData = TArray<uint8>(StoredData.GetData(), StoredData.Num());
+		}
+
+		if (OutSpatialEncoding)
+		{
+			*OutSpatialEncoding = GetKeptSpatialEncoding(Entry, ESaveSpatialEncoding::Archive);
+		}
+
+		return true;
+	}
+
+	// Compact payloads are expanded back to the archive layout every converter reads
+	const TConstArrayView<uint8> EncodedData = Entry.IsCompressed() ? TConstArrayView<uint8>(DecompressedData) : StoredData;
+	ESaveSpatialEncoding SpatialEncoding = ESaveSpatialEncoding::Archive;
+	if (!FSaveSpatialCodec::Decode(Entry.DataType, EncodedData, OutData, SpatialEncoding))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted compactly encoded save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	if (OutSpatialEncoding)
+	{
+		*OutSpatialEncoding = GetKeptSpatialEncoding(Entry, SpatialEncoding);
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::ReadDecompressedPayload(FArchive& Ar, const FSaveIndexEntry& Entry, TArray<uint8>& OutData)
+{
+	if (Entry.DataSize < 0 || Entry.DataOffset < 0 || Entry.DataOffset + Entry.DataSize > Ar.TotalSize())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	Ar.Seek(Entry.DataOffset);
+
+	if (!Entry.IsCompressed())
+	{
+		OutData.SetNumUninitialized(Entry.DataSize);
+		Ar.Serialize(OutData.GetData(), Entry.DataSize);
+		return !Ar.IsError();
+	}
+
+	TArray<uint8> StoredData;
+	StoredData.SetNumUninitialized(Entry.DataSize);
+	Ar.Serialize(StoredData.GetData(), Entry.DataSize);
+
+	return !Ar.IsError() && DecompressPayload(Entry, StoredData, OutData, nullptr);
+}
+
+bool FSaveFileFormat::ExpandPayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8> Data, TArray<uint8>& OutData)
+{
+	if (!Entry.IsCompactEncoded())
+	{
+		OutData = TArray<uint8>(Data.GetData(), Data.Num());
+		return true;
+	}
+
+	ESaveSpatialEncoding SpatialEncoding = ESaveSpatialEncoding::Archive;
+	if (!FSaveSpatialCodec::Decode(Entry.DataType, Data, OutData, SpatialEncoding))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted compactly encoded save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::GetLoadedDataSize(const FString& SaveFilePath, const FSaveIndexEntry& Entry, int64& OutDataSize)
+{
+	if (Entry.IsCompactEncoded())
+	{
+		OutDataSize = FSaveSpatialCodec::GetArchiveSize(Entry.DataType);
+		return true;
+	}
+
+	if (!Entry.IsCompressed())
+	{
+		OutDataSize = Entry.DataSize;
+		return true;
+	}
+
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath);
+	if (!Reader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	// Same prefix as read by DecompressPayload: the codec, then the uncompressed size
+	uint8 Codec = 0;
+	int32 UncompressedSize = 0;
+	if (Entry.DataOffset >= 0 && Entry.DataOffset < Reader->TotalSize())
+	{
+		Reader->Seek(Entry.DataOffset);
+		*Reader << Codec;
+		*Reader << UncompressedSize;
+	}
+	else
+	{
+		Reader->SetError();
+	}
+
+	if (Reader->IsError() || UncompressedSize < 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted compressed save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	OutDataSize = UncompressedSize;
+	return true;
+}
+
+bool FSaveFileFormat::DecompressPayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8> StoredData, TArray<uint8>& OutData, ESaveCompression* OutCompression)
+{
+	FMemoryReaderView PrefixReader(StoredData);
+	uint8 Codec = 0;
+	int32 UncompressedSize = 0;
+	PrefixReader << Codec;
+	PrefixReader << UncompressedSize;
+
+	const ESaveCompression Compression = static_cast<ESaveCompression>(Codec);
+	const FName FormatName = GetCompressionFormat(Compression);
+	if (PrefixReader.IsError() || UncompressedSize < 0 || FormatName.IsNone())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Corrupted compressed save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	const int64 PrefixSize = PrefixReader.Tell();
+	OutData.SetNumUninitialized(UncompressedSize);
+	if (!FCompression::UncompressMemory(FormatName, OutData.GetData(), UncompressedSize, StoredData.GetData() + PrefixSize, StoredData.Num() - static_cast<int32>(PrefixSize)))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to decompress save file entry: %s"), *Entry.Key);
+		return false;
+	}
+
+	if (OutCompression)
+	{
+		*OutCompression = EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Entry.Flags), ESaveRecordFlags::ExplicitCompression) ? Compression : ESaveCompression::FileDefault;
+	}
+
+	return true;
+}
+
+void FSaveFileFormat::SerializeIndex(FArchive& Ar, TArray<FSaveIndexEntry>& Index, uint16 Version)
+{
+	// Same layout as serializing the array itself: the count followed by the entries
+	int32 Count = Index.Num();
+	Ar << Count;
+
+	if (Ar.IsLoading())
+	{
+		if (Count < 0)
+		{
+			Ar.SetError();
+			return;
+		}
+
+		Index.Reset();
+	}
+
+	for (int32 EntryIndex = 0; EntryIndex < Count && !Ar.IsError(); ++EntryIndex)
+	{
+		FSaveIndexEntry& Entry = Ar.IsLoading() ? Index.AddDefaulted_GetRef() : Index[EntryIndex];
+		Entry.Serialize(Ar, Version);
+	}
+}
+
+ESaveCompression FSaveFileFormat::GetRawEntryCompression(const FSaveIndexEntry& Entry)
+{
+	// Raw entries with an explicit choice either asked for no compression or did not shrink, both are kept raw
+	return EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Entry.Flags), ESaveRecordFlags::ExplicitCompression) ? ESaveCompression::None : ESaveCompression::FileDefault;
+}
+
+ESaveSpatialEncoding FSaveFileFormat::GetKeptSpatialEncoding(const FSaveIndexEntry& Entry, ESaveSpatialEncoding StoredEncoding)
+{
+	return EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Entry.Flags), ESaveRecordFlags::ExplicitSpatialEncoding) ? StoredEncoding : ESaveSpatialEncoding::FileDefault;
+}
+
+FName FSaveFileFormat::GetCompressionFormat(ESaveCompression Compression)
+{
+	switch (Compression)
+	{
+	case ESaveCompression::Zlib:
+		return NAME_Zlib;
+	case ESaveCompression::LZ4:
+		return NAME_LZ4;
+	case ESaveCompression::Oodle:
+		return NAME_Oodle;
+	default:
+		return NAME_None;
+	}
+}
+
+bool FSaveFileFormat::FindEntry(const FString& SaveFilePath, FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType)
+{
+	ESaveStorageEngine StorageEngine = ESaveStorageEngine::File;
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath, &StorageEngine);
+	if (!Reader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	if (StorageEngine == ESaveStorageEngine::BTree)
+	{
+		// Only the path down to the leaf of the key is read, then the payload
+		FSaveBTree Tree;
+		FSaveIndexEntry Entry;
+		if (!Tree.OpenRead(*Reader) || !Tree.Find(Key, Entry))
+		{
+			return false; // Data not found
+		}
+
+		OutDataType = Entry.DataType;
+		return ReadPayload(*Reader, Entry, OutData);
+	}
+
+	FSaveFileHeader Header;
+	if (ReadHeader(*Reader, Header))
+	{
+		// Without a record log after the index the key filter alone decides a miss, and the index is never read
+		FSaveFileIndex Index;
+		int64 IndexEndOffset = 0;
+		const bool bStoredKeyFilter = ReadKeyFilter(*Reader, Header, Index.KeyFilter, IndexEndOffset);
+		if (bStoredKeyFilter && IndexEndOffset == Reader->TotalSize() && !Index.KeyFilter.MayContain(Key.GetHash()))
+		{
+			return false; // Data not found
+		}
+
+		// On a possible hit the key index is read right behind the filter, which is kept rather than read a second time
+		if (Reader->IsError() || !ReadIndexAfterKeyFilter(*Reader, Header, bStoredKeyFilter, Index))
+		{
+			return false;
+		}
+
+		if (const FSaveIndexEntry* Entry = Index.Find(Key))
+		{
+			OutDataType = Entry->DataType;
+			return ReadPayload(*Reader, *Entry, OutData);
+		}
+
+		return false; // Data not found
+	}
+
+	if (Reader->IsError())
+	{
+		return false;
+	}
+
+	// Legacy file, scan record headers until the key is found, skipping every other payload unread
+	FSaveIndexEntry Entry;
+	while (!Reader->AtEnd())
+	{
+		if (!ReadLegacyRecordHeader(*Reader, Entry))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted save file: %s"), *SaveFilePath);
+			return false;
+		}
+
+		if (Key.Matches(Entry.Key, Entry.KeyHash))
+		{
+			OutDataType = Entry.DataType;
+			return ReadPayload(*Reader, Entry, OutData); // Data found
+		}
+
+		Reader->Seek(Entry.DataOffset + Entry.DataSize);
+	}
+
+	return false; // Data not found
+}
+
+bool FSaveFileFormat::FindEntries(const FString& SaveFilePath, TConstArrayView<FString> Keys, TMap<FString, FSerializedData>& OutEntries, TArray<FString>& OutMissingKeys)
+{
+	ESaveStorageEngine StorageEngine = ESaveStorageEngine::File;
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath, &StorageEngine);
+	if (!Reader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		OutMissingKeys.Append(Keys.GetData(), Keys.Num());
+		return false;
+	}
+
+	if (StorageEngine == ESaveStorageEngine::BTree)
+	{
+		// Every key is looked up in the tree on its own, nothing but the paths to their leaves is read
+		FSaveBTree Tree;
+		const bool bOpened = Tree.OpenRead(*Reader);
+		for (const FString& Key : Keys)
+		{
+			FSaveIndexEntry Entry;
+			FSerializedData SerializedData;
+
+			if (bOpened && Tree.Find(FSaveKey(Key), Entry) && ReadPayload(*Reader, Entry, SerializedData.Data))
+			{
+				SerializedData.Key = Key;
+				SerializedData.DataType = Entry.DataType;
+				OutEntries.Add(Key, MoveTemp(SerializedData));
+			}
+			else
+			{
+				OutMissingKeys.Add(Key);
+			}
+		}
+
+		return OutMissingKeys.Num() == 0;
+	}
+
+	FSaveFileHeader Header;
+	if (ReadHeader(*Reader, Header))
+	{
+		// Read the index once, then seek to every requested payload
+		FSaveFileIndex Index;
+		if (!ReadIndex(*Reader, Header, Index))
+		{
+			OutMissingKeys.Append(Keys.GetData(), Keys.Num());
+			return false;
+		}
+
+		for (const FString& Key : Keys)
+		{
+			const FSaveIndexEntry* Entry = Index.Find(Key);
+			FSerializedData SerializedData;
+
+			if (Entry && ReadPayload(*Reader, *Entry, SerializedData.Data))
+			{
+				SerializedData.Key = Key;
+				SerializedData.DataType = Entry->DataType;
+				OutEntries.Add(Key, MoveTemp(SerializedData));
+			}
+			else
+			{
+				OutMissingKeys.Add(Key);
+			}
+		}
+
+		return OutMissingKeys.Num() == 0;
+	}
+
+	// Legacy file, scan it once and pick up every requested key on the way. Only requested payloads are read.
+	TSet<FSaveKey> PendingKeys;
+	PendingKeys.Reserve(Keys.Num());
+	for (const FString& Key : Keys)
+	{
+		PendingKeys.Add(FSaveKey(Key));
+	}
+
+	FSaveIndexEntry Entry;
+	while (!Reader->IsError() && !Reader->AtEnd() && PendingKeys.Num() > 0 && ReadLegacyRecordHeader(*Reader, Entry))
+	{
+		if (PendingKeys.Remove(Entry.GetSaveKey()) > 0)
+		{
+			FSerializedData SerializedData;
+			SerializedData.Key = Entry.Key;
+			SerializedData.DataType = Entry.DataType;
+
+			if (ReadPayload(*Reader, Entry, SerializedData.Data))
+			{
+				OutEntries.Add(Entry.Key, MoveTemp(SerializedData));
+			}
+		}
+
+		Reader->Seek(Entry.DataOffset + Entry.DataSize);
+	}
+
+	for (const FString& Key : Keys)
+	{
+		if (!OutEntries.Contains(Key))
+		{
+			OutMissingKeys.Add(Key);
+		}
+	}
+
+	return OutMissingKeys.Num() == 0;
+}
+
+bool FSaveFileFormat::ReadAllEntries(const FString& SaveFilePath, TArray<FSerializedData>& OutEntries)
+{
+	ESaveStorageEngine StorageEngine = ESaveStorageEngine::File;
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath, &StorageEngine);
+	if (!Reader)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	FSaveFileIndex Index;
+	if (StorageEngine == ESaveStorageEngine::BTree)
+	{
+		if (!ReadTreeIndex(*Reader, Index))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		FSaveFileHeader Header;
+		if (!ReadHeader(*Reader, Header))
+		{
+			return !Reader->IsError() && ReadLegacyEntries(*Reader, OutEntries);
+		}
+
+		if (!ReadIndex(*Reader, Header, Index))
+		{
+			return false;
+		}
+	}
+
+	OutEntries.Reserve(OutEntries.Num() + Index.Entries.Num());
+	for (const TPair<FSaveKey, FSaveIndexEntry>& Pair : Index.Entries)
+	{
+		const FSaveIndexEntry& Entry = Pair.Value;
+		FSerializedData& SerializedData = OutEntries.AddDefaulted_GetRef();
+		SerializedData.Key = Entry.Key;
+		SerializedData.DataType = Entry.DataType;
+
+		// Keep per-entry compression and encoding choices, so rewriting the file does not lose them
+		if (!ReadPayload(*Reader, Entry, SerializedData.Data, &SerializedData.Compression, &SerializedData.SpatialEncoding))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::WriteAllEntries(const FString& SaveFilePath, TArray<FSerializedData>& Entries, const FSaveCompressionSettings& Compression,
+	ESaveStorageEngine StorageEngine)
+{
+	return WriteFile(SaveFilePath, nullptr, nullptr, [](const FString&) { return false; }, Entries, Compression, StorageEngine);
+}
+
+bool FSaveFileFormat::RewriteFile(const FString& SaveFilePath, TArrayView<FSerializedData> NewEntries, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+	const FSaveCompressionSettings& Compression, ESaveStorageEngine StorageEngine)
+{
+	// The existing file stays open for the whole rewrite, its records are streamed over one at a time
+	ESaveStorageEngine SourceStorageEngine = ESaveStorageEngine::File;
+	TUniquePtr<FArchive> Reader = CreateReader(SaveFilePath, &SourceStorageEngine);
+	if (!Reader)
+	{
+		return WriteFile(SaveFilePath, nullptr, nullptr, ShouldDropExisting, NewEntries, Compression, StorageEngine);
+	}
+
+	// Only the live index of the source is held in memory
+	FSaveFileIndex SourceIndex;
+	bool bIndexed = true;
+	bool bSourceRead = true;
+	if (SourceStorageEngine == ESaveStorageEngine::BTree)
+	{
+		bSourceRead = ReadTreeIndex(*Reader, SourceIndex);
+	}
+	else
+	{
+		FSaveFileHeader SourceHeader;
+		bIndexed = ReadHeader(*Reader, SourceHeader);
+		if (bIndexed)
+		{
+			bSourceRead = ReadIndex(*Reader, SourceHeader, SourceIndex);
+		}
+		else if (!Reader->IsError() && StorageEngine == ESaveStorageEngine::BTree)
+		{
+			// Trees are built in key order, which takes an index of legacy sources as well. It is built by a scan of their record headers
+			bIndexed = true;
+			bSourceRead = ReadLegacyIndex(*Reader, SourceIndex);
+		}
+	}
+
+	if (!bSourceRead || Reader->IsError())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	return WriteFile(SaveFilePath, Reader.Get(), bIndexed ? &SourceIndex : nullptr, ShouldDropExisting, NewEntries, Compression, StorageEngine);
+}
+
+bool FSaveFileFormat::WriteFile(const FString& SaveFilePath, FArchive* SourceReader, const FSaveFileIndex* SourceIndex, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+	TArrayView<FSerializedData> NewEntries, const FSaveCompressionSettings& Compression, ESaveStorageEngine StorageEngine)
+{
+	if (StorageEngine == ESaveStorageEngine::BTree)
+	{
+		return WriteTreeFile(SaveFilePath, SourceReader, SourceIndex, ShouldDropExisting, NewEntries, Compression);
+	}
+
+	// Write next to the target and move over it at the end, so a failed write never leaves a torn save file behind. An existing page store is written in place instead: the new
+	// image goes to free pages and only replaces the previous one once committed, and the pages that come out unchanged are not written again. That takes positioned writes,
+	// platforms without them always go through the temporary file
+	const FString TempFilePath = SaveFilePath + TEXT(".tmp");
+	const bool bPaged = StorageEngine == ESaveStorageEngine::Paged;
+	const bool bInPlace = bPaged && CanUpdateInPlace() && FSavePageStore::IsPageStore(SaveFilePath);
+	const FString& WriterPath = bInPlace ? SaveFilePath : TempFilePath;
+
+	TUniquePtr<FArchive> Writer;
+	if (bPaged)
+	{
+		TUniquePtr<FSavePageStore> PageStore = MakeUnique<FSavePageStore>();
+		if (bInPlace ? PageStore->OpenWrite(SaveFilePath) : PageStore->Create(TempFilePath))
+		{
+			Writer = MakeUnique<FSavePageStoreWriter>(MoveTemp(PageStore), WriterPath);
+		}
+	}
+	else
+	{
+		Writer.Reset(IFileManager::Get().CreateFileWriter(*TempFilePath));
+	}
+
+	if (!Writer)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write file: %s"), *WriterPath);
+		return false;
+	}
+
+	// Reserve room for the header, it is rewritten once the index offset is known
+	FSaveFileHeader Header;
+	Header.SetCompressionSettings(Compression);
+	*Writer << Header;
+
+	TArray<FSaveIndexEntry> Index;
+	Index.Reserve(NewEntries.Num());
+
+	bool bSuccess = true;
+	if (SourceReader && SourceIndex)
+	{
+		bSuccess = CopyLiveRecords(*SourceReader, *SourceIndex, *Writer, ShouldDropExisting, Compression, Index);
+	}
+	else if (SourceReader)
+	{
+		// Legacy files are upgraded entry by entry, only one entry is held in memory at a time and dropped payloads are never read. The legacy scan always returned the first
+		// entry of a key, see ReadLegacyIndex, so later duplicates are dropped as well
+		FSaveIndexEntry SourceEntry;
+		TSet<FSaveKey> UpgradedKeys;
+		while (bSuccess && !SourceReader->AtEnd())
+		{
+			bSuccess = ReadLegacyRecordHeader(*SourceReader, SourceEntry);
+
+			bool bAlreadyUpgraded = false;
+			if (bSuccess)
+			{
+				UpgradedKeys.Add(SourceEntry.GetSaveKey(), &bAlreadyUpgraded);
+			}
+
+			if (bSuccess && !bAlreadyUpgraded && !ShouldDropExisting(SourceEntry.Key))
+			{
+				FSerializedData SerializedData;
+				SerializedData.Key = SourceEntry.Key;
+				SerializedData.DataType = SourceEntry.DataType;
+				bSuccess = ReadPayload(*SourceReader, SourceEntry, SerializedData.Data);
+
+				if (bSuccess)
+				{
+					WriteRecord(*Writer, SerializedData, ESaveRecordFlags::None, Compression, 0, Index.AddDefaulted_GetRef());
+				}
+			}
+
+			SourceReader->Seek(SourceEntry.DataOffset + SourceEntry.DataSize);
+		}
+	}
+
+	// Write the new entry records, remembering where each payload ends up
+	for (int32 EntryIndex = 0; bSuccess && EntryIndex < NewEntries.Num(); ++EntryIndex)
+	{
+		WriteRecord(*Writer, NewEntries[EntryIndex], ESaveRecordFlags::None, Compression, 0, Index.AddDefaulted_GetRef());
+	}
+
+	if (bSuccess)
+	{
+		// Append the key filter and the index, then patch the end of the index and the index offset into the header
+		Header.IndexOffset = Writer->Tell();
+
+		int64 IndexEndOffset = 0;
+		*Writer << IndexEndOffset;
+
+		FSaveKeyFilter KeyFilter;
+		KeyFilter.Reset(Index.Num());
+		for (const FSaveIndexEntry& Entry : Index)
+		{
+			KeyFilter.Add(Entry.KeyHash);
+		}
+		*Writer << KeyFilter;
+
+		SerializeIndex(*Writer, Index, Header.Version);
+		IndexEndOffset = Writer->Tell();
+
+		Writer->Seek(Header.IndexOffset);
+		*Writer << IndexEndOffset;
+
+		Writer->Seek(0);
+		*Writer << Header;
+	}
+
+	bSuccess = bSuccess && Writer->Close() && !Writer->IsError();
+	Writer.Reset();
+
+	if (!bSuccess)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write file: %s"), *SaveFilePath);
+		if (!bInPlace)
+		{
+			IFileManager::Get().Delete(*TempFilePath);
+		}
+
+		return false;
+	}
+
+	// The source has to be closed before the file it reads from can be replaced
+	if (SourceReader)
+	{
+		SourceReader->Close();
+	}
+
+	// Closing the writer committed the page store, there is nothing to replace
+	if (bInPlace)
+	{
+		return true;
+	}
+
+	if (!IFileManager::Get().Move(*SaveFilePath, *TempFilePath, true, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to replace file: %s"), *SaveFilePath);
+		IFileManager::Get().Delete(*TempFilePath);
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::CopyLiveRecords(FArchive& SourceReader, const FSaveFileIndex& SourceIndex, FArchive& Writer, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+	const FSaveCompressionSettings& Compression, TArray<FSaveIndexEntry>& InOutIndex)
+{
+	// Visit the records in file order, so the source is read front to back
+	TArray<FSaveIndexEntry> LiveEntries;
+	SourceIndex.Entries.GenerateValueArray(LiveEntries);
+	LiveEntries.Sort([](const FSaveIndexEntry& A, const FSaveIndexEntry& B) { return A.RecordOffset < B.RecordOffset; });
+
+	const FSaveCompressionSettings SourceCompression = SourceIndex.Header.GetCompressionSettings();
+
+	TArray<uint8> CopyBuffer;
+	CopyBuffer.SetNumUninitialized(StreamingChunkSize);
+	InOutIndex.Reserve(InOutIndex.Num() + LiveEntries.Num());
+
+	for (FSaveIndexEntry& SourceEntry : LiveEntries)
+	{
+		if (ShouldDropExisting(SourceEntry.Key))
+		{
+			continue;
+		}
+
+		if (!CanCopyStoredPayload(SourceEntry, SourceCompression, Compression))
+		{
+			// Re-encode with the new file settings, one entry at a time
+			FSerializedData SerializedData;
+			SerializedData.Key = SourceEntry.Key;
+			SerializedData.DataType = SourceEntry.DataType;
+			if (!ReadPayload(SourceReader, SourceEntry, SerializedData.Data, &SerializedData.Compression, &SerializedData.SpatialEncoding))
+			{
+				return false;
+			}
+
+			WriteRecord(Writer, SerializedData, ESaveRecordFlags::None, Compression, 0, InOutIndex.AddDefaulted_GetRef());
+			continue;
+		}
+
+		if (SourceEntry.DataSize < 0 || SourceEntry.DataOffset + SourceEntry.DataSize > SourceReader.TotalSize())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted save file entry: %s"), *SourceEntry.Key);
+			return false;
+		}
+
+		FSaveIndexEntry& IndexEntry = InOutIndex.AddDefaulted_GetRef();
+		WriteRecordHeader(Writer, SourceEntry.Key, SourceEntry.DataType, static_cast<ESaveRecordFlags>(SourceEntry.Flags), SourceEntry.DataSize, 0, IndexEntry);
+
+		// Copy the stored bytes through a bounded buffer
+		SourceReader.Seek(SourceEntry.DataOffset);
+		for (int64 Remaining = SourceEntry.DataSize; Remaining > 0; )
+		{
+			const int32 ChunkSize = static_cast<int32>(FMath::Min<int64>(Remaining, StreamingChunkSize));
+			SourceReader.Serialize(CopyBuffer.GetData(), ChunkSize);
+			Writer.Serialize(CopyBuffer.GetData(), ChunkSize);
+			Remaining -= ChunkSize;
+		}
+
+		if (SourceReader.IsError())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::CanCopyStoredPayload(const FSaveIndexEntry& Entry, const FSaveCompressionSettings& SourceCompression, const FSaveCompressionSettings& Compression)
+{
+	// Stored payloads can be copied byte for byte unless the file default compression or spatial encoding they were stored with changes
+	const ESaveRecordFlags Flags = static_cast<ESaveRecordFlags>(Entry.Flags);
+	const bool bKeepCompression = (SourceCompression.Compression == Compression.Compression && SourceCompression.MinSizeToCompress == Compression.MinSizeToCompress)
+		|| EnumHasAnyFlags(Flags, ESaveRecordFlags::ExplicitCompression);
+	const bool bKeepSpatialEncoding = SourceCompression.SpatialEncoding == Compression.SpatialEncoding || EnumHasAnyFlags(Flags, ESaveRecordFlags::ExplicitSpatialEncoding)
+		|| !FSaveSpatialCodec::IsSpatialType(Entry.DataType);
+
+	return bKeepCompression && bKeepSpatialEncoding;
+}
+
+bool FSaveFileFormat::WriteTreeFile(const FString& SaveFilePath, FArchive* SourceReader, const FSaveFileIndex* SourceIndex,
+	TFunctionRef<bool(const FString& Key)> ShouldDropExisting, TArrayView<FSerializedData> NewEntries, const FSaveCompressionSettings& Compression)
+{
+	// Like paged files, an existing page store gets the new tree in free pages, which only replace the previous image once committed
+	const FString TempFilePath = SaveFilePath + TEXT(".tmp");
+	const bool bInPlace = CanUpdateInPlace() && FSavePageStore::IsPageStore(SaveFilePath);
+	const FString& StorePath = bInPlace ? SaveFilePath : TempFilePath;
+
+	FSavePageStore PageStore;
+	FSaveBTree Tree;
+	if (!(bInPlace ? PageStore.OpenWrite(SaveFilePath) : PageStore.Create(TempFilePath)) || !Tree.Create(PageStore, Compression))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write file: %s"), *StorePath);
+		return false;
+	}
+
+	const auto KeyLess = [](const FString& A, const FString& B) { return A.Compare(B, ESearchCase::IgnoreCase) < 0; };
+
+	// Both sides are visited in key order and merged, so every node is filled before the next one is started
+	TArray<const FSaveIndexEntry*> SourceEntries;
+	if (SourceReader && SourceIndex)
+	{
+		SourceEntries.Reserve(SourceIndex->Entries.Num());
+		for (const TPair<FSaveKey, FSaveIndexEntry>& Pair : SourceIndex->Entries)
+		{
+			if (!ShouldDropExisting(Pair.Value.Key))
+			{
+				SourceEntries.Add(&Pair.Value);
+			}
+		}
+
+		// The index of a tree already lists its entries in key order
+		if (SourceIndex->StorageEngine != ESaveStorageEngine::BTree)
+		{
+			SourceEntries.Sort([&KeyLess](const FSaveIndexEntry& A, const FSaveIndexEntry& B) { return KeyLess(A.Key, B.Key); });
+		}
+	}
+
+	// New entries of the same key stay in order, the last one inserted wins
+	TArray<FSerializedData*> SortedNewEntries;
+	SortedNewEntries.Reserve(NewEntries.Num());
+	for (FSerializedData& Entry : NewEntries)
+	{
+		SortedNewEntries.Add(&Entry);
+	}
+	Algo::StableSort(SortedNewEntries, [&KeyLess](const FSerializedData* A, const FSerializedData* B) { return KeyLess(A->Key, B->Key); });
+
+	const FSaveCompressionSettings SourceCompression = SourceIndex ? SourceIndex->Header.GetCompressionSettings() : Compression;
+	TArray<uint8> StoredData;
+	bool bSuccess = true;
+	int32 SourcePosition = 0;
+	int32 NewPosition = 0;
+
+	while (bSuccess && (SourcePosition < SourceEntries.Num() || NewPosition < SortedNewEntries.Num()))
+	{
+		const int32 Order = SourcePosition == SourceEntries.Num() ? 1
+			: NewPosition == SortedNewEntries.Num() ? -1
+			: SourceEntries[SourcePosition]->Key.Compare(SortedNewEntries[NewPosition]->Key, ESearchCase::IgnoreCase);
+
+		if (Order >= 0)
+		{
+			// A new entry, replacing the source entry of the same key if there is one
+			SourcePosition += Order == 0 ? 1 : 0;
+			const FSerializedData& Entry = *SortedNewEntries[NewPosition++];
+			ESaveRecordFlags RecordFlags = ESaveRecordFlags::None;
+			const TConstArrayView<uint8> Payload = EncodePayload(Entry, Compression, RecordFlags, StoredData);
+			bSuccess = Tree.Insert(Entry.Key, Entry.DataType, RecordFlags, Payload);
+			continue;
+		}
+
+		const FSaveIndexEntry& SourceEntry = *SourceEntries[SourcePosition++];
+		if (!CanCopyStoredPayload(SourceEntry, SourceCompression, Compression))
+		{
+			// Re-encode with the new file settings, one entry at a time
+			FSerializedData SerializedData;
+			SerializedData.Key = SourceEntry.Key;
+			SerializedData.DataType = SourceEntry.DataType;
+			bSuccess = ReadPayload(*SourceReader, SourceEntry, SerializedData.Data, &SerializedData.Compression, &SerializedData.SpatialEncoding);
+			if (bSuccess)
+			{
+				ESaveRecordFlags RecordFlags = ESaveRecordFlags::None;
+				const TConstArrayView<uint8> Payload = EncodePayload(SerializedData, Compression, RecordFlags, StoredData);
+				bSuccess = Tree.Insert(SerializedData.Key, SerializedData.DataType, RecordFlags, Payload);
+			}
+			continue;
+		}
+
+		if (SourceEntry.DataSize < 0 || SourceEntry.DataOffset + SourceEntry.DataSize > SourceReader->TotalSize())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted save file entry: %s"), *SourceEntry.Key);
+			bSuccess = false;
+			break;
+		}
+
+		// The stored bytes go over as they are, one payload in memory at a time
+		StoredData.SetNumUninitialized(SourceEntry.DataSize);
+		SourceReader->Seek(SourceEntry.DataOffset);
+		SourceReader->Serialize(StoredData.GetData(), SourceEntry.DataSize);
+		bSuccess = !SourceReader->IsError() && Tree.Insert(SourceEntry.Key, SourceEntry.DataType, static_cast<ESaveRecordFlags>(SourceEntry.Flags), StoredData);
+	}
+
+	bSuccess = bSuccess && Tree.Flush() && PageStore.Commit();
+	if (!bSuccess)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write file: %s"), *SaveFilePath);
+		if (!bInPlace)
+		{
+			IFileManager::Get().Delete(*TempFilePath);
+		}
+
+		return false;
+	}
+
+	// The source has to be closed before the file it reads from can be replaced
+	if (SourceReader)
+	{
+		SourceReader->Close();
+	}
+
+	if (bInPlace)
+	{
+		return true;
+	}
+
+	if (!IFileManager::Get().Move(*SaveFilePath, *TempFilePath, true, true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to replace file: %s"), *SaveFilePath);
+		IFileManager::Get().Delete(*TempFilePath);
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::UpdateTree(const FString& SaveFilePath, TArrayView<FSerializedData> Entries, TConstArrayView<FString> DeletedKeys,
+	const FSaveCompressionSettings& Compression, float& OutGarbageRatio)
+{
+	FSavePageStore PageStore;
+	FSaveBTree Tree;
+	if (!PageStore.OpenWrite(SaveFilePath) || !Tree.OpenWrite(PageStore))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to open file for writing: %s"), *SaveFilePath);
+		return false;
+	}
+
+	// Entries sharing a leaf follow each other, so the leaf is written once for all of them
+	TArray<FSerializedData*> SortedEntries;
+	SortedEntries.Reserve(Entries.Num());
+	for (FSerializedData& Entry : Entries)
+	{
+		SortedEntries.Add(&Entry);
+	}
+	Algo::StableSort(SortedEntries, [](const FSerializedData* A, const FSerializedData* B) { return A->Key.Compare(B->Key, ESearchCase::IgnoreCase) < 0; });
+
+	TArray<uint8> StoredData;
+	bool bSuccess = true;
+	for (int32 EntryIndex = 0; bSuccess && EntryIndex < SortedEntries.Num(); ++EntryIndex)
+	{
+		const FSerializedData& Entry = *SortedEntries[EntryIndex];
+		ESaveRecordFlags RecordFlags = ESaveRecordFlags::None;
+		const TConstArrayView<uint8> Payload = EncodePayload(Entry, Compression, RecordFlags, StoredData);
+		bSuccess = Tree.Insert(Entry.Key, Entry.DataType, RecordFlags, Payload);
+	}
+
+	for (int32 KeyIndex = 0; bSuccess && KeyIndex < DeletedKeys.Num(); ++KeyIndex)
+	{
+		bSuccess = Tree.Remove(DeletedKeys[KeyIndex]);
+	}
+
+	if (!bSuccess || !Tree.Flush() || !PageStore.Commit())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	OutGarbageRatio = Tree.GetGarbageRatio();
+	return true;
+}
+
+bool FSaveFileFormat::AppendRecords(const FString& SaveFilePath, TArrayView<FSerializedData> Entries, TConstArrayView<FString> DeletedKeys, FSaveFileIndex& InOutIndex,
+	const FSaveCompressionSettings& Compression)
+{
+	// Records appended after a torn record would never be read back, the file must be rewritten first
+	if (InOutIndex.bTornTail)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Cannot append to file ending with a torn record: %s"), *SaveFilePath);
+		return false;
+	}
+
+	// Serialize the records on their own, positioned where they will land at the end of the file
+	TArray<uint8> ByteArray;
+	FMemoryWriter MemoryWriter(ByteArray, true);
+
+	TArray<FSaveIndexEntry> Records;
+	Records.Reserve(Entries.Num() + DeletedKeys.Num());
+	for (FSerializedData& Entry : Entries)
+	{
+		WriteRecord(MemoryWriter, Entry, ESaveRecordFlags::None, Compression, InOutIndex.FileSize, Records.AddDefaulted_GetRef());
+	}
+
+	for (const FString& Key : DeletedKeys)
+	{
+		FSerializedData Tombstone;
+		Tombstone.Key = Key;
+		WriteRecord(MemoryWriter, Tombstone, ESaveRecordFlags::Tombstone, Compression, InOutIndex.FileSize, Records.AddDefaulted_GetRef());
+	}
+
+	// Paged files get the records written into the pages at the end of the image, published with one commit
+	bool bAppended = false;
+	if (InOutIndex.StorageEngine == ESaveStorageEngine::Paged)
+	{
+		FSavePageStore PageStore;
+		bAppended = PageStore.OpenWrite(SaveFilePath) && PageStore.Write(InOutIndex.FileSize, ByteArray.GetData(), ByteArray.Num()) && PageStore.Commit();
+	}
+	else
+	{
+		bAppended = FFileHelper::SaveArrayToFile(ByteArray, *SaveFilePath, &IFileManager::Get(), FILEWRITE_Append);
+	}
+
+	if (!bAppended)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to append to file: %s"), *SaveFilePath);
+		return false;
+	}
+
+	InOutIndex.FileSize += ByteArray.Num();
+	for (const FSaveIndexEntry& Record : Records)
+	{
+		InOutIndex.ApplyRecord(Record);
+	}
+
+	return true;
+}
+
+bool FSaveFileFormat::TombstoneRecords(const FString& SaveFilePath, TConstArrayView<FString> DeletedKeys, FSaveFileIndex& InOutIndex)
+{
+	if (InOutIndex.Header.Version < FSaveFileHeader::IndexTombstoneVersion)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Save file version %d does not support deleting in place: %s"), InOutIndex.Header.Version, *SaveFilePath);
+		return false;
+	}
+
+	// Opened without truncating it, then every flag is written at its own position. Paged files get the flags written into copies of their pages
+	const bool bPaged = InOutIndex.StorageEngine == ESaveStorageEngine::Paged;
+	FSavePageStore PageStore;
+	TUniquePtr<IFileHandle> FileHandle;
+	if (bPaged)
+	{
+		if (!PageStore.OpenWrite(SaveFilePath))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		FileHandle.Reset(OpenForUpdate(SaveFilePath, false));
+		if (!FileHandle)
+		{
+			return false;
+		}
+	}
+
+	for (const FString& Key : DeletedKeys)
+	{
+		const FSaveKey SaveKey(Key);
+		const FSaveIndexEntry* Entry = InOutIndex.Find(SaveKey);
+		if (!Entry)
+		{
+			continue;
+		}
+
+		const int64 FlagsOffset = Entry->IndexFlagsOffset != INDEX_NONE ? Entry->IndexFlagsOffset : Entry->RecordOffset;
+		const uint8 Flags = Entry->Flags | static_cast<uint8>(ESaveRecordFlags::Tombstone);
+		const bool bWritten = bPaged ? PageStore.Write(FlagsOffset, &Flags, sizeof(Flags)) : FileHandle->Seek(FlagsOffset) && FileHandle->Write(&Flags, sizeof(Flags));
+		if (!bWritten)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to mark a tombstone in file: %s"), *SaveFilePath);
+			return false;
+		}
+
+		// The record stays in the file as garbage until the next compaction
+		InOutIndex.LiveRecordBytes -= Entry->GetRecordSize();
+		InOutIndex.Entries.Remove(SaveKey);
+		InOutIndex.SortedKeys.Reset();
+		InOutIndex.bKeysSorted = false;
+	}
+
+	return bPaged ? PageStore.Commit() : FileHandle->Flush();
+}
+
+IFileHandle* FSaveFileFormat::OpenForUpdate(const FString& FilePath, bool bAllowRead)
+{
+	if (!CanUpdateInPlace())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Files cannot be updated in place on this platform: %s"), *FilePath);
+		return nullptr;
+	}
+
+	// Append mode is only used to keep the contents, the platform files above seek to the end once on open and honor every later seek
+	IFileHandle* FileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*FilePath, true, bAllowRead);
+	if (!FileHandle)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to open file for writing: %s"), *FilePath);
+	}
+
+	return FileHandle;
+}
+
+void FSaveFileFormat::WriteRecord(FArchive& Ar, FSerializedData& Entry, ESaveRecordFlags RecordFlags, const FSaveCompressionSettings& Compression, int64 BaseOffset,
+	FSaveIndexEntry& OutIndexEntry)
+{
+	const bool bTombstone = EnumHasAnyFlags(RecordFlags, ESaveRecordFlags::Tombstone);
+
+	TArray<uint8> StoredData;
+	const TConstArrayView<uint8> Payload = bTombstone ? TConstArrayView<uint8>() : EncodePayload(Entry, Compression, RecordFlags, StoredData);
+
+	WriteRecordHeader(Ar, Entry.Key, Entry.DataType, RecordFlags, Payload.Num(), BaseOffset, OutIndexEntry);
+	Ar.Serialize(const_cast<uint8*>(Payload.GetData()), OutIndexEntry.DataSize);
+}
+
+TConstArrayView<uint8> FSaveFileFormat::EncodePayload(const FSerializedData& Entry, const FSaveCompressionSettings& Compression, ESaveRecordFlags& InOutRecordFlags,
+	TArray<uint8>& OutBuffer)
+{
+	OutBuffer.Reset();
+
+	// Entries using the file default skip compression below the size threshold, explicit choices always apply
+	ESaveCompression EntryCompression = Entry.Compression;
+	if (EntryCompression == ESaveCompression::FileDefault)
+	{
+		EntryCompression = Entry.Data.Num() >= Compression.MinSizeToCompress ? Compression.Compression : ESaveCompression::None;
+	}
+	else
+	{
+		InOutRecordFlags |= ESaveRecordFlags::ExplicitCompression;
+	}
+
+	// Vectors, rotators and transforms are encoded first, the compact bytes are then compressed like any other payload
+	ESaveSpatialEncoding EntrySpatialEncoding = Entry.SpatialEncoding;
+	if (EntrySpatialEncoding == ESaveSpatialEncoding::FileDefault)
+	{
+		EntrySpatialEncoding = Compression.SpatialEncoding;
+	}
+	else if (FSaveSpatialCodec::IsSpatialType(Entry.DataType))
+	{
+		InOutRecordFlags |= ESaveRecordFlags::ExplicitSpatialEncoding;
+	}
+
+	TArray<uint8> EncodedData;
+	const bool bCompactEncoded = FSaveSpatialCodec::Encode(Entry.DataType, EntrySpatialEncoding, Entry.Data, EncodedData);
+	if (bCompactEncoded)
+	{
+		InOutRecordFlags |= ESaveRecordFlags::CompactEncoding;
+	}
+
+	if (CompressPayload(EntryCompression, bCompactEncoded ? EncodedData : Entry.Data, OutBuffer))
+	{
+		InOutRecordFlags |= ESaveRecordFlags::Compressed;
+		return OutBuffer;
+	}
+
+	if (bCompactEncoded)
+	{
+		OutBuffer = MoveTemp(EncodedData);
+		return OutBuffer;
+	}
+
+	return Entry.Data;
+}
+
+void FSaveFileFormat::WriteRecordHeader(FArchive& Ar, const FString& Key, EDataType DataType, ESaveRecordFlags RecordFlags, int32 DataSize, int64 BaseOffset,
+	FSaveIndexEntry& OutIndexEntry)
+{
+	OutIndexEntry.Key = Key;
+	OutIndexEntry.KeyHash = FSaveKey::HashKey(Key);
+	OutIndexEntry.DataType = DataType;
+	OutIndexEntry.Flags = static_cast<uint8>(RecordFlags);
+	OutIndexEntry.RecordOffset = BaseOffset + Ar.Tell();
+	OutIndexEntry.DataSize = DataSize;
+
+	Ar << OutIndexEntry.Flags;
+	Ar << OutIndexEntry.DataType;
+	Ar << OutIndexEntry.Key;
+	Ar << OutIndexEntry.DataSize;
+
+	OutIndexEntry.DataOffset = BaseOffset + Ar.Tell();
+}
+
+bool FSaveFileFormat::CompressPayload(ESaveCompression Compression, TConstArrayView<uint8> Data, TArray<uint8>& OutStoredData)
+{
+	const FName FormatName = GetCompressionFormat(Compression);
+	if (FormatName.IsNone() || Data.Num() == 0)
+	{
+		return false;
+	}
+
+	if (!FCompression::IsFormatValid(FormatName))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Compression format %s is not available, storing the entry raw."), *FormatName.ToString());
+		return false;
+	}
+
+	// Stored layout: codec, uncompressed size, compressed bytes
+	uint8 Codec = static_cast<uint8>(Compression);
+	int32 UncompressedSize = Data.Num();
+	FMemoryWriter PrefixWriter(OutStoredData);
+	PrefixWriter << Codec;
+	PrefixWriter << UncompressedSize;
+
+	const int32 PrefixSize = OutStoredData.Num();
+	int32 CompressedSize = FCompression::CompressMemoryBound(FormatName, UncompressedSize);
+	OutStoredData.SetNumUninitialized(PrefixSize + CompressedSize);
+
+	if (!FCompression::CompressMemory(FormatName, OutStoredData.GetData() + PrefixSize, CompressedSize, Data.GetData(), UncompressedSize))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Failed to compress a save file entry with %s, storing it raw."), *FormatName.ToString());
+		return false;
+	}
+
+	// Incompressible payloads are cheaper to store raw
+	if (PrefixSize + CompressedSize >= UncompressedSize)
+	{
+		return false;
+	}
+
+	OutStoredData.SetNum(PrefixSize + CompressedSize);
+	return true;
+}
+
+bool FSaveFileFormat::ReadLegacyIndex(FArchive& Ar, FSaveFileIndex& OutIndex)
+{
+	OutIndex.FileSize = Ar.TotalSize();
+	OutIndex.RecordBytes = 0;
+	OutIndex.LiveRecordBytes = 0;
+	OutIndex.Entries.Reset();
+
+	FSaveIndexEntry Entry;
+	while (!Ar.AtEnd())
+	{
+		if (!ReadLegacyRecordHeader(Ar, Entry))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted legacy save file."));
+			return false;
+		}
+
+		// The legacy scan always returned the first entry of a key, keep it that way
+		const FSaveKey EntryKey = Entry.GetSaveKey();
+		if (!OutIndex.Entries.Contains(EntryKey))
+		{
+			OutIndex.Entries.Add(EntryKey, Entry);
+		}
+
+		Ar.Seek(Entry.DataOffset + Entry.DataSize);
+	}
+
+	OutIndex.RebuildKeyFilter();
+	return true;
+}
+
+bool FSaveFileFormat::ReadLegacyRecordHeader(FArchive& Ar, FSaveIndexEntry& OutEntry)
+{
+	// A legacy entry is a serialized FSerializedData: data type, key, then the data array as its length followed by its bytes
+	OutEntry.RecordOffset = Ar.Tell();
+	Ar << OutEntry.DataType;
+	Ar << OutEntry.Key;
+	Ar << OutEntry.DataSize;
+	OutEntry.DataOffset = Ar.Tell();
+	OutEntry.KeyHash = FSaveKey::HashKey(OutEntry.Key);
+	OutEntry.Flags = 0;
+
+	return !Ar.IsError() && OutEntry.DataSize >= 0 && OutEntry.DataOffset + OutEntry.DataSize <= Ar.TotalSize();
+}
+
+bool FSaveFileFormat::ReadLegacyEntries(FArchive& Ar, TArray<FSerializedData>& OutEntries)
+{
+	while (!Ar.AtEnd())
+	{
+		FSerializedData SerializedData;
+		Ar << SerializedData;
+
+		if (Ar.IsError())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted legacy save file."));
+			return false;
+		}
+
+		OutEntries.Add(MoveTemp(SerializedData));
+	}
+
+	return true;
+}
@@ -0,0 +1,633 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SaveLoadManager.h"
+#include "SaveKeyFilter.h"
+
+class IFileHandle;
+
+
+/**
+ * \brief The fixed-size header written at the start of every indexed save file.
+ *
+ * Files written before the indexed format existed have no header and start directly with the first serialized entry. Those files are detected by the missing magic number and are
+ * read through the legacy path until they are rewritten.
+ */
+struct FSaveFileHeader
+{
+	/** \brief Magic number identifying an indexed save file ('SLMF' on disk). Its first byte can never be a valid EDataType, which is how legacy files are told apart. */
+	static constexpr uint32 MagicNumber = 0x464D4C53;
+
+	/** \brief The current version of the indexed file format. Version 2 added the appended record log after the key index, version 3 the compression settings,
+	 * version 4 compactly encoded vectors, rotators and transforms, version 5 the key hashes in the index, version 6 the key filter, version 7 index entries deleted in place. */
+	static constexpr uint16 CurrentVersion = 7;
+
+	/** \brief The first version that records compression settings in the header. */
+	static constexpr uint16 CompressionVersion = 3;
+
+	/** \brief The first version that records the spatial encoding in the header and may hold compactly encoded records. */
+	static constexpr uint16 SpatialEncodingVersion = 4;
+
+	/** \brief The first version that stores the hash of every key in the index. */
+	static constexpr uint16 KeyHashVersion = 5;
+
+	/** \brief The first version that stores a key filter in front of the index. */
+	static constexpr uint16 KeyFilterVersion = 6;
+
+	/** \brief The first version whose readers skip index entries carrying the tombstone flag. Older files must never get one, their readers would bring the key back. */
+	static constexpr uint16 IndexTombstoneVersion = 7;
+
+	/** \brief The size of the smallest serialized header (version 2) in bytes. */
+	static constexpr int64 MinSerializedSize = 16;
+
+	uint32 Magic = MagicNumber;
+	uint16 Version = CurrentVersion;
+	uint16 Flags = 0;
+
+	/** \brief Absolute file offset of the key index. */
+	int64 IndexOffset = 0;
+
+	/** \brief The default codec of the file, an ESaveCompression value. */
+	uint8 Compression = static_cast<uint8>(ESaveCompression::None);
+
+	/** \brief The default spatial encoding of the file, an ESaveSpatialEncoding value. Reserved and zero before version 4. */
+	uint8 SpatialEncoding = static_cast<uint8>(ESaveSpatialEncoding::Archive);
+
+	/** \brief Unused, keeps the header a multiple of 8 bytes. */
+	uint8 Reserved[2] = {};
+
+	/** \brief Payloads using the file default that are smaller than this are stored raw. */
+	int32 MinSizeToCompress = 0;
+
+	/** \brief Returns true if the header carries the magic number and a version this build can read. */
+	bool IsValid() const { return Magic == MagicNumber && Version > 0 && Version <= CurrentVersion; }
+
+	/** \brief Returns the size of the serialized header in bytes. Entry records start right after it. */
+	int64 GetSerializedSize() const { return Version >= CompressionVersion ? 24 : MinSerializedSize; }
+
+	/** \brief Returns the compression settings recorded in the header. Headers older than version 3 have none, headers older than version 4 store everything in archive layout. */
+	FSaveCompressionSettings GetCompressionSettings() const
+	{
+		FSaveCompressionSettings Settings;
+		Settings.Compression = Version >= CompressionVersion ? static_cast<ESaveCompression>(Compression) : ESaveCompression::None;
+		Settings.MinSizeToCompress = MinSizeToCompress;
+
+		const ESaveSpatialEncoding RecordedEncoding = static_cast<ESaveSpatialEncoding>(SpatialEncoding);
+		Settings.SpatialEncoding = Version >= SpatialEncodingVersion && RecordedEncoding != ESaveSpatialEncoding::FileDefault ? RecordedEncoding : ESaveSpatialEncoding::Archive;
+		return Settings;
+	}
+
+	/** \brief Records compression settings in the header. */
+	void SetCompressionSettings(const FSaveCompressionSettings& Settings)
+	{
+		Compression = static_cast<uint8>(Settings.Compression);
+		MinSizeToCompress = Settings.MinSizeToCompress;
+		SpatialEncoding = static_cast<uint8>(Settings.SpatialEncoding);
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FSaveFileHeader& Header)
+	{
+		Ar << Header.Magic;
+		Ar << Header.Version;
+		Ar << Header.Flags;
+		Ar << Header.IndexOffset;
+
+		// Only headers that are known to carry them have the compression settings
+		if (Header.Magic == MagicNumber && Header.Version >= CompressionVersion)
+		{
+			Ar << Header.Compression;
+			Ar << Header.SpatialEncoding;
+			Ar.Serialize(Header.Reserved, sizeof(Header.Reserved));
+			Ar << Header.MinSizeToCompress;
+		}
+
+		return Ar;
+	}
+};
+
+/**
+ * \brief Flags stored in the first byte of every entry record.
+ */
+enum class ESaveRecordFlags : uint8
+{
+	None = 0,
+
+	/** \brief The record marks its key as deleted. It has no payload and hides every older record of the same key. */
+	Tombstone = 1 << 0,
+
+	/** \brief The payload is compressed. It starts with the ESaveCompression codec (uint8) and the uncompressed size (int32), followed by the compressed bytes. */
+	Compressed = 1 << 1,
+
+	/** \brief The compression was chosen for the entry itself instead of taken from the file settings, and is kept when the file is rewritten. */
+	ExplicitCompression = 1 << 2,
+
+	/** \brief The payload is a vector, rotator or transform in a compact encoding. See FSaveSpatialCodec for its layout. Compression applies on top of it. */
+	CompactEncoding = 1 << 3,
+
+	/** \brief The spatial encoding was chosen for the entry itself instead of taken from the file settings, and is kept when the file is rewritten. */
+	ExplicitSpatialEncoding = 1 << 4
+};
+ENUM_CLASS_FLAGS(ESaveRecordFlags);
+
+/**
+ * \brief A single entry of the key index stored after the entry records.
+ *
+ * Maps a key to the position of its record and payload, so a lookup can seek straight to the bytes it needs instead of deserializing the whole file.
+ */
+struct FSaveIndexEntry
+{
+	/** \brief The key of the entry. */
+	FString Key;
+
+	/** \brief The hash of the key, see FSaveKey::HashKey. Stored in the index since version 5, computed when older indexes and record headers are read. */
+	uint64 KeyHash = 0;
+
+	/** \brief The data type stored for the key. */
+	EDataType DataType = EDataType::FloatType;
+
+	/** \brief Record flags, mirrored from the record header. See ESaveRecordFlags. */
+	uint8 Flags = 0;
+
+	/** \brief Absolute file offset of the record header. */
+	int64 RecordOffset = 0;
+
+	/** \brief Absolute file offset of the first payload byte. */
+	int64 DataOffset = 0;
+
+	/** \brief Size of the payload in bytes, as stored in the file. */
+	int32 DataSize = 0;
+
+	/** \brief Returns true if the stored payload is compressed. */
+	bool IsCompressed() const { return EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Flags), ESaveRecordFlags::Compressed); }
+
+	/** \brief Returns true if the stored payload is a compactly encoded vector, rotator or transform. */
+	bool IsCompactEncoded() const { return EnumHasAnyFlags(static_cast<ESaveRecordFlags>(Flags), ESaveRecordFlags::CompactEncoding); }
+
+	/** \brief Returns true if the stored bytes are the payload itself, neither compressed nor compactly encoded, so they can be used in place. */
+	bool IsStoredRaw() const { return !IsCompressed() && !IsCompactEncoded(); }
+
+	/** \brief Size of the whole record (header and payload) in bytes. */
+	int64 GetRecordSize() const { return DataOffset + DataSize - RecordOffset; }
+
+	/** \brief Offset of the flags of this entry inside the stored key index, or INDEX_NONE for entries of the record log. Set when the index is read, never serialized. */
+	int64 IndexFlagsOffset = INDEX_NONE;
+
+	/** \brief Returns the key together with its hash. */
+	FSaveKey GetSaveKey() const { return FSaveKey(Key, KeyHash); }
+
+	/** \brief Returns a view of the key and its hash, valid as long as the entry. */
+	FSaveKeyView GetKeyView() const { return FSaveKeyView(*Key, Key.Len(), KeyHash); }
+
+	/** \brief Serializes the entry in the index layout of the given file version. Hashes missing from older versions are computed on load. */
+	void Serialize(FArchive& Ar, uint16 Version)
+	{
+		Ar << Key;
+		if (Version >= FSaveFileHeader::KeyHashVersion)
+		{
+			Ar << KeyHash;
+		}
+		else if (Ar.IsLoading())
+		{
+			KeyHash = FSaveKey::HashKey(Key);
+		}
+
+		Ar << DataType;
+
+		if (Ar.IsLoading())
+		{
+			IndexFlagsOffset = Ar.Tell();
+		}
+		Ar << Flags;
+		Ar << RecordOffset;
+		Ar << DataOffset;
+		Ar << DataSize;
+	}
+};
+
+/**
+ * \brief The live view of an indexed save file: the stored key index with the appended record log replayed on top of it.
+ *
+ * Besides the entries it tracks how many record bytes are still live, which tells how much space a compaction would reclaim.
+ */
+struct FSaveFileIndex
+{
+	/** \brief The header of the file. */
+	FSaveFileHeader Header;
+
+	/** \brief The live entries by key. Keys compare by hash first, then case-insensitively, matching FSerializedData key lookups. */
+	TMap<FSaveKey, FSaveIndexEntry> Entries;
+
+	/** \brief Filter over the keys of the file, checked before Entries. Covers every live key, and may still match keys deleted since it was built. */
+	FSaveKeyFilter KeyFilter;
+
+	/** \brief The live keys in case-insensitive order, for prefix queries. Built by SortKeys and dropped whenever a record is applied. */
+	TArray<FSaveKey> SortedKeys;
+
+	/** \brief True while SortedKeys matches Entries. */
+	bool bKeysSorted = false;
+
+	/** \brief Total size of the file in bytes, or the offset of the torn record that ends the record log. Appended records go here. */
+	int64 FileSize = 0;
+
+	/** \brief True if the record log ends with a torn record, whose bytes stay in the file after FileSize. Nothing can be appended until the file is rewritten. */
+	bool bTornTail = false;
+
+	/** \brief How the file is stored. Set when the index is read from a file path. */
+	ESaveStorageEngine StorageEngine = ESaveStorageEngine::File;
+
+	/** \brief Total bytes of all records in the file, including superseded records and tombstones. */
+	int64 RecordBytes = 0;
+
+	/** \brief Bytes of the records that are still live. */
+	int64 LiveRecordBytes = 0;
+
+	/** \brief Finds the live entry for a key, or returns nullptr if the key is not present. */
+	const FSaveIndexEntry* Find(FSaveKeyView Key) const
+	{
+		return KeyFilter.MayContain(Key.GetHash()) ? Entries.FindByHash(GetTypeHash(Key), Key) : nullptr;
+	}
+
+	/** \brief Same as above, hashing the key first. */
+	const FSaveIndexEntry* Find(const FString& Key) const { return Entries.Find(FSaveKey(Key)); }
+
+	/** \brief Applies a record of the record log to the index. Newer records replace older ones and tombstones remove the key. */
+	void ApplyRecord(const FSaveIndexEntry& Record);
+
+	/** \brief Rebuilds the key filter from the live entries, for files that do not store one. */
+	void RebuildKeyFilter();
+
+	/** \brief Sorts the live keys for prefix queries. Indexes that are kept around, such as cached and mapped ones, sort their keys on their first prefix query. */
+	void SortKeys();
+
+	/**
+	 * \brief Finds the live entries whose key starts with a prefix, ignoring case.
+	 *
+	 * Keys starting with the prefix form one contiguous range of the sorted keys, which is found by binary search. Indexes whose keys are not sorted scan every entry instead.
+	 *
+	 * \param Prefix The prefix to match. An empty prefix matches every entry.
+	 * \param OutEntries Receives the matching entries, in key order if the keys are sorted. They stay valid until the index is changed.
+	 */
+	void FindByPrefix(const FString& Prefix, TArray<const FSaveIndexEntry*>& OutEntries) const;
+
+	/** \brief Returns the fraction of record bytes that are garbage, between 0 and 1. */
+	float GetGarbageRatio() const { return RecordBytes > 0 ? 1.0f - static_cast<float>(LiveRecordBytes) / static_cast<float>(RecordBytes) : 0.0f; }
+};
+
+/**
+ * \class FSaveFileFormat
+ * \brief Reads and writes the on-disk layout of save files.
+ *
+ * An indexed save file is laid out as follows:
+ * - FSaveFileHeader (24 bytes, 16 bytes before version 3).
+ * - Entry records: uint8 flags, EDataType, FString key, int32 payload size, payload bytes. Compressed payloads are prefixed with their codec and uncompressed size. Compactly
+ *   encoded payloads are prefixed with their spatial encoding, and compressed after encoding.
+ * - Key filter (since version 6): int64 offset of the end of the key index, followed by the FSaveKeyFilter of the live keys.
+ * - Key index: int32 count followed by one FSaveIndexEntry per live key, each with the 64-bit hash of its key since version 5. Since version 7 an entry may carry the
+ *   tombstone flag, set in place when its key is deleted, and is then skipped.
+ * - Record log: entry records appended after the index. They are replayed on top of the index in file order, so the newest record of a key wins and tombstones delete it.
+ *
+ * Legacy files (a plain sequence of FSerializedData without header) are still readable. They are converted to the indexed layout the next time they are written.
+ *
+ * Files stored with ESaveStorageEngine::Paged hold the same layout inside an FSavePageStore. They are opened through CreateReader, which reads the bytes through the page table.
+ * Files stored with ESaveStorageEngine::BTree hold an FSaveBTree inside an FSavePageStore instead. Their lookups go down the tree, and functions that need every entry walk its
+ * leaves to build the same live index.
+ */
+struct FSaveFileFormat
+{
+	/**
+	 * \brief Reads the header of an open save file.
+	 * \param Ar The archive to read from. Its position is left right after the header for indexed files and at the start of the file for legacy files.
+	 * \param OutHeader Receives the header when the file is indexed.
+	 * \return True if the file uses the indexed format, false if it is a legacy (or empty) file.
+	 */
+	static bool ReadHeader(FArchive& Ar, FSaveFileHeader& OutHeader);
+
+	/**
+	 * \brief Reads the key index of an indexed save file and replays the record log appended after it.
+	 *
+	 * Only record headers of the log are read, payloads are skipped using their serialized size.
+	 *
+	 * \param Ar The archive to read from.
+	 * \param Header The header previously read from the same archive.
+	 * \param OutIndex Receives the live index.
+	 * \return True if the index was read successfully.
+	 */
+	static bool ReadIndex(FArchive& Ar, const FSaveFileHeader& Header, FSaveFileIndex& OutIndex);
+
+	/**
+	 * \brief Opens a save file for reading, through its page store if it is stored in pages.
+	 * \param SaveFilePath The file to open.
+	 * \param OutStorageEngine Receives how the file is stored, if not null. Callers that read more than payloads must check it, B+tree images are not in the indexed layout.
+	 * \return The reader, positioned at the start of the save file bytes, or nullptr if the file could not be opened.
+	 */
+	static TUniquePtr<FArchive> CreateReader(const FString& SaveFilePath, ESaveStorageEngine* OutStorageEngine = nullptr);
+
+	/**
+	 * \brief Returns how a save file is stored. Files that cannot be opened are reported as plain files.
+	 */
+	static ESaveStorageEngine GetStorageEngine(const FString& SaveFilePath);
+
+	/**
+	 * \brief Opens a save file and reads its live index. B+tree files get every entry read from their leaves.
+	 * \param SaveFilePath The file to read.
+	 * \param OutIndex Receives the live index.
+	 * \return True if the file uses the indexed format and its index was read successfully. False for legacy files and read errors.
+	 */
+	static bool ReadIndex(const FString& SaveFilePath, FSaveFileIndex& OutIndex);
+
+	/**
+	 * \brief Reads the header of a save file to find the compression settings recorded in it.
+	 * \param SaveFilePath The file to read.
+	 * \param OutSettings Receives the recorded settings.
+	 * \return True if the file records compression settings, false for missing, legacy and older indexed files.
+	 */
+	static bool ReadCompressionSettings(const FString& SaveFilePath, FSaveCompressionSettings& OutSettings);
+
+	/**
+	 * \brief Reads the payload of a single entry by seeking straight to it, and decompresses and expands it if needed.
+	 * \param Ar The archive to read from.
+	 * \param Entry The index entry describing the payload.
+	 * \param OutData Receives the payload bytes. Compactly encoded entries are returned in archive layout.
+	 * \param OutCompression If set, receives the compression to keep for the entry when it is written again: its own codec if it was chosen per entry, FileDefault otherwise.
+	 * \param OutSpatialEncoding If set, receives the spatial encoding to keep for the entry when it is written again, following the same rule.
+	 * \return True if the payload was read successfully.
+	 */
+	static bool ReadPayload(FArchive& Ar, const FSaveIndexEntry& Entry, TArray<uint8>& OutData, ESaveCompression* OutCompression = nullptr,
+		ESaveSpatialEncoding* OutSpatialEncoding = nullptr);
+
+	/**
+	 * \brief Turns a payload as stored in the file into the payload bytes, decompressing and expanding it if needed.
+	 * \param Entry The index entry describing the payload.
+	 * \param StoredData The stored payload bytes.
+	 * \param OutData Receives the payload bytes.
+	 * \param OutCompression If set, receives the compression to keep for the entry when it is written again. See ReadPayload.
+	 * \param OutSpatialEncoding If set, receives the spatial encoding to keep for the entry when it is written again. See ReadPayload.
+	 * \return True if the payload was decoded successfully.
+	 */
+	static bool DecodePayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8> StoredData, TArray<uint8>& OutData, ESaveCompression* OutCompression = nullptr,
+		ESaveSpatialEncoding* OutSpatialEncoding = nullptr);
+
+	/**
+	 * \brief Reads the payload of a single entry like ReadPayload, but only decompresses it. Compactly encoded payloads stay compact, see ExpandPayload.
+	 * \param Ar The archive to read from.
+	 * \param Entry The index entry describing the payload.
+	 * \param OutData Receives the decompressed payload bytes.
+	 * \return True if the payload was read successfully.
+	 */
+	static bool ReadDecompressedPayload(FArchive& Ar, const FSaveIndexEntry& Entry, TArray<uint8>& OutData);
+
+	/**
+	 * \brief Expands a decompressed payload to the archive layout every converter reads. Payloads that are not compactly encoded are copied as they are.
+	 * \param Entry The index entry describing the payload.
+	 * \param Data The decompressed payload bytes, as returned by ReadDecompressedPayload.
+	 * \param OutData Receives the payload bytes in archive layout.
+	 * \return False if the compact payload is corrupted.
+	 */
+	static bool ExpandPayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8> Data, TArray<uint8>& OutData);
+
+	/**
+	 * \brief Returns the size of the payload of an entry as it is loaded, decompressed and in archive layout, without reading it.
+	 *
+	 * Compactly encoded payloads expand to a fixed size per data type. Other compressed payloads record their size in their prefix, which is the only part of the file read.
+	 *
+	 * \param SaveFilePath The file the entry belongs to, only opened for compressed payloads.
+	 * \param Entry The index entry describing the payload.
+	 * \param OutDataSize Receives the loaded size in bytes.
+	 * \return False if the size prefix could not be read.
+	 */
+	static bool GetLoadedDataSize(const FString& SaveFilePath, const FSaveIndexEntry& Entry, int64& OutDataSize);
+
+	/** \brief Decompresses a compressed stored payload. OutCompression receives the compression to keep for the entry, see ReadPayload. */
+	static bool DecompressPayload(const FSaveIndexEntry& Entry, TConstArrayView<uint8> StoredData, TArray<uint8>& OutData, ESaveCompression* OutCompression);
+
+	/**
+	 * \brief Returns the name of the FCompression format implementing a codec, or NAME_None for no compression.
+	 */
+	static FName GetCompressionFormat(ESaveCompression Compression);
+
+	/**
+	 * \brief Turns payload bytes into the payload as stored, encoding and compressing it as configured. Tombstones have no payload and are not encoded.
+	 * \param Entry The entry to encode. Its own compression and spatial encoding apply if they are set.
+	 * \param Compression The compression settings of the file, used for entries that use the file default.
+	 * \param InOutRecordFlags Receives the record flags describing the stored payload.
+	 * \param OutBuffer Holds the stored payload when it differs from the payload bytes.
+	 * \return The stored payload, pointing into OutBuffer or into the entry data.
+	 */
+	static TConstArrayView<uint8> EncodePayload(const FSerializedData& Entry, const FSaveCompressionSettings& Compression, ESaveRecordFlags& InOutRecordFlags,
+		TArray<uint8>& OutBuffer);
+
+	/**
+	 * \brief Finds a single entry in a save file, reading only the header, the index and the matching payload for indexed files.
+	 * \param SaveFilePath The file to search.
+	 * \param Key The key to look for.
+	 * \param OutData Receives the payload bytes.
+	 * \param OutDataType Receives the data type of the entry.
+	 * \return True if the key was found.
+	 */
+	static bool FindEntry(const FString& SaveFilePath, FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType);
+
+	/**
+	 * \brief Finds many entries of a save file with a single pass over it.
+	 * \param SaveFilePath The file to search.
+	 * \param Keys The keys to look for.
+	 * \param OutEntries Receives the found entries by key.
+	 * \param OutMissingKeys Receives the keys that were not found.
+	 * \return True if every key was found.
+	 */
+	static bool FindEntries(const FString& SaveFilePath, TConstArrayView<FString> Keys, TMap<FString, FSerializedData>& OutEntries, TArray<FString>& OutMissingKeys);
+
+	/**
+	 * \brief Reads every live entry of a save file, in either format.
+	 * \param SaveFilePath The file to read.
+	 * \param OutEntries Receives the entries, in file order for legacy files and in no particular order otherwise. Entries whose compression or spatial encoding was chosen per
+	 * entry keep it.
+	 * \return True if the file was read successfully.
+	 */
+	static bool ReadAllEntries(const FString& SaveFilePath, TArray<FSerializedData>& OutEntries);
+
+	/** \brief The largest chunk of payload bytes held in memory while records are copied from one file to another. */
+	static constexpr int32 StreamingChunkSize = 256 * 1024;
+
+	/**
+	 * \brief Writes the given entries to a save file using the indexed format, replacing its previous content.
+	 *
+	 * Records are streamed to a temporary file next to the save file, which then replaces it. Nothing but the index is built up in memory.
+	 *
+	 * \param SaveFilePath The file to write.
+	 * \param Entries The entries to write.
+	 * \param Compression The compression settings of the file, recorded in its header.
+	 * \param StorageEngine How the file is stored.
+	 * \return True if the file was written successfully.
+	 */
+	static bool WriteAllEntries(const FString& SaveFilePath, TArray<FSerializedData>& Entries, const FSaveCompressionSettings& Compression = FSaveCompressionSettings(),
+		ESaveStorageEngine StorageEngine = ESaveStorageEngine::File);
+
+	/**
+	 * \brief Rewrites a save file with its live entries and the given new entries, streaming the existing records over instead of loading them.
+	 *
+	 * Peak memory stays bounded by the index, the new entries and one copy chunk, regardless of the file size. Stored payloads are copied byte for byte unless the file default
+	 * compression or spatial encoding changed, in which case they are re-encoded one at a time. Legacy files are upgraded to the indexed format.
+	 *
+	 * \param SaveFilePath The file to rewrite. A missing file is created with only the new entries.
+	 * \param NewEntries The entries to add after the existing ones.
+	 * \param ShouldDropExisting Returns true for existing keys that must not be carried over, because they are replaced or deleted.
+	 * \param Compression The compression settings of the file, recorded in its header.
+	 * \param StorageEngine How the rewritten file is stored. Files switch engines by being rewritten.
+	 * \return True if the file was rewritten successfully. The previous file is left untouched otherwise.
+	 */
+	static bool RewriteFile(const FString& SaveFilePath, TArrayView<FSerializedData> NewEntries, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+		const FSaveCompressionSettings& Compression, ESaveStorageEngine StorageEngine);
+
+	/**
+	 * \brief Appends records and tombstones to the record log of an indexed save file in a single write, without rewriting the file.
+	 *
+	 * Paged files only get the pages holding the end of the file written, and committed once.
+	 *
+	 * \param SaveFilePath The file to append to. It must already use the current indexed format.
+	 * \param Entries The entries to append.
+	 * \param DeletedKeys The keys to append tombstones for. They are written after the entries.
+	 * \param InOutIndex The live index of the file, read from it, updated with the appended records. Fails if the record log ends with a torn record.
+	 * \param Compression The compression settings used for entries that use the file default.
+	 * \return True if the records were appended successfully.
+	 */
+	static bool AppendRecords(const FString& SaveFilePath, TArrayView<FSerializedData> Entries, TConstArrayView<FString> DeletedKeys, FSaveFileIndex& InOutIndex,
+		const FSaveCompressionSettings& Compression);
+
+	/**
+	 * \brief Deletes keys by marking their live records as tombstones in place, with a one-byte positioned write per key and nothing else rewritten.
+	 *
+	 * Entries listed in the stored key index get the tombstone flag in their index entry, entries of the record log in their record header, which is replayed on read. The
+	 * records stay in the file as garbage until it is compacted. Paged files get the pages holding the flags copied, and committed once.
+	 *
+	 * Requires CanUpdateInPlace, callers fall back to appending tombstones with AppendRecords on other platforms.
+	 *
+	 * \param SaveFilePath The file to update. It must use the indexed format at FSaveFileHeader::IndexTombstoneVersion or later.
+	 * \param DeletedKeys The keys to delete. Keys that are not live are skipped.
+	 * \param InOutIndex The live index of the file, read from it, updated with the deletions.
+	 * \return True if every flag was written successfully.
+	 */
+	static bool TombstoneRecords(const FString& SaveFilePath, TConstArrayView<FString> DeletedKeys, FSaveFileIndex& InOutIndex);
+
+	/**
+	 * \brief Returns whether existing files can be updated with positioned writes on this platform.
+	 *
+	 * IPlatformFile has no read-write open mode, the only way to open a file without truncating it is OpenWrite with bAppend set. That is only usable for positioned writes
+	 * where the platform file seeks to the end once on open and honors later seeks, as the Windows, Mac and Linux platform files do. Platforms that open append handles with
+	 * O_APPEND would silently move every write to the end of the file, so they never update in place and go through appended records or rewrites instead.
+	 */
+	static constexpr bool CanUpdateInPlace() { return PLATFORM_WINDOWS || PLATFORM_MAC || PLATFORM_LINUX; }
+
+	/**
+	 * \brief Opens an existing file for positioned writes, without truncating it.
+	 * \param FilePath The file to open.
+	 * \param bAllowRead Whether the handle can also read the file.
+	 * \return The file handle, or nullptr if the file could not be opened or CanUpdateInPlace is false on this platform.
+	 */
+	static IFileHandle* OpenForUpdate(const FString& FilePath, bool bAllowRead);
+
+	/**
+	 * \brief Inserts entries into and removes keys from the B+tree of a save file, writing only the nodes on the paths to their leaves, and commits them at once.
+	 *
+	 * Entries are inserted in key order, so entries going to the same leaf are written together.
+	 *
+	 * \param SaveFilePath The file to update. It must already be stored with ESaveStorageEngine::BTree.
+	 * \param Entries The entries to insert, replacing the entries of the same keys.
+	 * \param DeletedKeys The keys to remove. They are removed after the entries are inserted. Keys that are not present are skipped.
+	 * \param Compression The compression settings used for entries that use the file default.
+	 * \param OutGarbageRatio Receives the fraction of the pages of the tree a rebuild would reclaim after the update, see FSaveBTree::GetGarbageRatio.
+	 * \return True if the update was committed.
+	 */
+	static bool UpdateTree(const FString& SaveFilePath, TArrayView<FSerializedData> Entries, TConstArrayView<FString> DeletedKeys, const FSaveCompressionSettings& Compression,
+		float& OutGarbageRatio);
+
+	/**
+	 * \brief Builds an index of a legacy headerless file by reading only the record headers and seeking past every payload.
+	 *
+	 * Nothing but the keys is allocated, so the memory needed does not depend on the payload sizes. The entries point at the payloads inside the legacy file, so ReadPayload works
+	 * on them. When a key appears more than once, the first entry wins, like the legacy lookups always did.
+	 *
+	 * \param Ar The archive to read from, positioned at the start of the file.
+	 * \param OutIndex Receives the index. Legacy files have no header, so its header is left untouched.
+	 * \return True if the file was scanned successfully.
+	 */
+	static bool ReadLegacyIndex(FArchive& Ar, FSaveFileIndex& OutIndex);
+
+	/**
+	 * \brief Reads every entry of a legacy headerless file.
+	 * \param Ar The archive to read from, positioned at the start of the file.
+	 * \param OutEntries Receives the entries in file order.
+	 * \return True if the file was read successfully.
+	 */
+	static bool ReadLegacyEntries(FArchive& Ar, TArray<FSerializedData>& OutEntries);
+
+private:
+
+	/**
+	 * \brief Writes a single entry record, encoding and compressing its payload as configured, and fills the index entry describing it. BaseOffset is the file offset the archive position 0
+	 * maps to.
+	 */
+	static void WriteRecord(FArchive& Ar, FSerializedData& Entry, ESaveRecordFlags RecordFlags, const FSaveCompressionSettings& Compression, int64 BaseOffset,
+		FSaveIndexEntry& OutIndexEntry);
+
+	/**
+	 * \brief Reads the data type, key and payload size of the legacy entry at the current position, leaving the archive at its first payload byte.
+	 * \return False if the entry is truncated or corrupted.
+	 */
+	static bool ReadLegacyRecordHeader(FArchive& Ar, FSaveIndexEntry& OutEntry);
+
+	/** \brief Writes the fixed part of a record, up to its payload, and fills the index entry describing it. */
+	static void WriteRecordHeader(FArchive& Ar, const FString& Key, EDataType DataType, ESaveRecordFlags RecordFlags, int32 DataSize, int64 BaseOffset,
+		FSaveIndexEntry& OutIndexEntry);
+
+	/**
+	 * \brief Streams a save file to a temporary file and moves it over the save file: the records of the source file that are not dropped, then the new entries, then the index.
+	 * SourceIndex is the live index of the source, null for legacy sources, SourceReader is null when there is no source. Page stores are rewritten in place and committed instead.
+	 */
+	static bool WriteFile(const FString& SaveFilePath, FArchive* SourceReader, const FSaveFileIndex* SourceIndex, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+		TArrayView<FSerializedData> NewEntries, const FSaveCompressionSettings& Compression, ESaveStorageEngine StorageEngine);
+
+	/**
+	 * \brief Builds the B+tree of a save file from the live entries of the source that are not dropped and the new entries, merged in key order, and commits it. SourceIndex is
+	 * null when there is no source. Page stores are rebuilt in place, anything else is replaced by a page store built next to it.
+	 */
+	static bool WriteTreeFile(const FString& SaveFilePath, FArchive* SourceReader, const FSaveFileIndex* SourceIndex, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+		TArrayView<FSerializedData> NewEntries, const FSaveCompressionSettings& Compression);
+
+	/** \brief Copies the live records of an indexed source file that are not dropped to Writer, in file order, and adds them to the index. */
+	static bool CopyLiveRecords(FArchive& SourceReader, const FSaveFileIndex& SourceIndex, FArchive& Writer, TFunctionRef<bool(const FString& Key)> ShouldDropExisting,
+		const FSaveCompressionSettings& Compression, TArray<FSaveIndexEntry>& InOutIndex);
+
+	/**
+	 * \brief Returns true if the stored payload of an entry can be copied byte for byte into a file with other compression settings: the file defaults it used did not change, or
+	 * it does not use them.
+	 */
+	static bool CanCopyStoredPayload(const FSaveIndexEntry& Entry, const FSaveCompressionSettings& SourceCompression, const FSaveCompressionSettings& Compression);
+
+	/** \brief Reads every entry of the B+tree image read by Ar into an index. */
+	static bool ReadTreeIndex(FArchive& Ar, FSaveFileIndex& OutIndex);
+
+	/**
+	 * \brief Reads the key filter stored in front of the key index.
+	 * \param OutIndexEndOffset Receives the offset of the end of the key index, where the record log starts.
+	 * \return False if the file version stores no key filter, or it could not be read.
+	 */
+	static bool ReadKeyFilter(FArchive& Ar, const FSaveFileHeader& Header, FSaveKeyFilter& OutKeyFilter, int64& OutIndexEndOffset);
+
+	/**
+	 * \brief Reads the rest of the key index once ReadKeyFilter was called on the same archive, see ReadIndex.
+	 * \param bStoredKeyFilter The result of ReadKeyFilter. If set, OutIndex.KeyFilter must hold the filter it read, and the archive must still be positioned right behind it.
+	 */
+	static bool ReadIndexAfterKeyFilter(FArchive& Ar, const FSaveFileHeader& Header, bool bStoredKeyFilter, FSaveFileIndex& OutIndex);
+
+	/** \brief Serializes the key index in the layout of the given file version. */
+	static void SerializeIndex(FArchive& Ar, TArray<FSaveIndexEntry>& Index, uint16 Version);
+
+	/** \brief Returns the compression to keep for an entry stored raw when it is written again. */
+	static ESaveCompression GetRawEntryCompression(const FSaveIndexEntry& Entry);
+
+	/** \brief Returns the spatial encoding to keep for an entry stored with StoredEncoding when it is written again. */
+	static ESaveSpatialEncoding GetKeptSpatialEncoding(const FSaveIndexEntry& Entry, ESaveSpatialEncoding StoredEncoding);
+
+	/** \brief Compresses a payload with the given codec into the stored layout. Returns false if the codec is unavailable or does not make the payload smaller. */
+	static bool CompressPayload(ESaveCompression Compression, TConstArrayView<uint8> Data, TArray<uint8>& OutStoredData);
+};
@@ -0,0 +1,196 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include <type_traits>
+
+
+/**
+ * \struct FSaveKey
+ * \brief A save file key together with its precomputed 64-bit hash.
+ *
+ * Keys compare case-insensitively, like FString keys always did. The hash is computed once when the key is built and compared before the strings, so lookups only compare
+ * strings on a hash match. Hot code can build its keys once and reuse them:
+ * \code
+ * static const FSaveKey HealthKey(TEXT("Player.Health"));
+ * USaveLoadManager::LoadValue(HealthKey, Health, SaveFilePath);
+ * \endcode
+ *
+ * The hash is part of the file format: it is 64-bit FNV-1a over the 16-bit code units of the key, with ASCII letters lowercased first. That matches the ASCII-only case folding
+ * of FString comparisons, so keys that compare equal always hash equal.
+ */
+struct FSaveKey
+{
+	FSaveKey() = default;
+
+	explicit FSaveKey(const FString& InKey)
+		: Key(InKey)
+		, Hash(HashKey(InKey))
+	{
+	}
+
+	explicit FSaveKey(FString&& InKey)
+		: Key(MoveTemp(InKey))
+		, Hash(HashKey(Key))
+	{
+	}
+
+	explicit FSaveKey(const TCHAR* InKey)
+		: Key(InKey)
+		, Hash(HashKey(Key))
+	{
+	}
+
+	/** \brief Builds a key from a hash that is already known, such as one read from a save file index. The hash must be the HashKey of the key. */
+	FSaveKey(FString InKey, uint64 InHash)
+		: Key(MoveTemp(InKey))
+		, Hash(InHash)
+	{
+	}
+
+	/** \brief Returns the key string. */
+	const FString& GetKey() const { return Key; }
+
+	/** \brief Returns the precomputed hash of the key. */
+	uint64 GetHash() const { return Hash; }
+
+	/** \brief Returns the hash of a key string, as stored in save files. */
+	static constexpr uint64 HashKey(const TCHAR* InKey, int32 Length)
+	{
+		uint64 KeyHash = 0xcbf29ce484222325ull;
+		for (int32 Index = 0; Index < Length; ++Index)
+		{
+			uint32 Character = static_cast<uint32>(InKey[Index]) & 0xFFFF;
+			if (Character >= 'A' && Character <= 'Z')
+			{
+				Character += 'a' - 'A';
+			}
+
+			KeyHash = (KeyHash ^ (Character & 0xFF)) * 0x100000001b3ull;
+			KeyHash = (KeyHash ^ (Character >> 8)) * 0x100000001b3ull;
+		}
+
+		return KeyHash;
+	}
+
+	/** \brief Returns the hash of a key string, as stored in save files. */
+	static uint64 HashKey(const FString& InKey)
+	{
+		return HashKey(*InKey, InKey.Len());
+	}
+
+	/** \brief Returns true if this key matches a key string with a known hash. The hashes are compared first. */
+	bool Matches(const FString& OtherKey, uint64 OtherHash) const
+	{
+		return Hash == OtherHash && Key.Equals(OtherKey, ESearchCase::IgnoreCase);
+	}
+
+	bool operator==(const FSaveKey& Other) const
+	{
+		return Matches(Other.Key, Other.Hash);
+	}
+
+	bool operator!=(const FSaveKey& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	friend uint32 GetTypeHash(const FSaveKey& SaveKey)
+	{
+		return static_cast<uint32>(SaveKey.Hash) ^ static_cast<uint32>(SaveKey.Hash >> 32);
+	}
+
+private:
+
+	FString Key;
+	uint64 Hash = HashKey(TEXT(""), 0);
+};
+
+
+/**
+ * \struct FSaveKeyView
+ * \brief A non-owning view of a key and its hash, accepted by the key lookups wherever an FSaveKey is.
+ *
+ * Views are built from an FSaveKey, which must outlive them, or from a string literal by SAVE_KEY, which hashes the literal at compile time. Looking a key up through a view
+ * neither allocates an FString nor hashes at runtime.
+ */
+struct FSaveKeyView
+{
+	constexpr FSaveKeyView(const TCHAR* InKey, int32 InLength, uint64 InHash)
+		: Key(InKey)
+		, Length(InLength)
+		, Hash(InHash)
+	{
+	}
+
+	/** \brief Builds a view of a string literal whose hash is already known. Use SAVE_KEY rather than calling this directly. */
+	template <uint32 N>
+	constexpr FSaveKeyView(const TCHAR (&Literal)[N], uint64 InHash)
+		: Key(Literal)
+		, Length(N - 1)
+		, Hash(InHash)
+	{
+	}
+
+	FSaveKeyView(const FSaveKey& SaveKey)
+		: Key(*SaveKey.GetKey())
+		, Length(SaveKey.GetKey().Len())
+		, Hash(SaveKey.GetHash())
+	{
+	}
+
+	/** \brief Returns the hash of a string literal, as stored in save files. */
+	template <uint32 N>
+	static constexpr uint64 HashLiteral(const TCHAR (&Literal)[N])
+	{
+		return FSaveKey::HashKey(Literal, N - 1);
+	}
+
+	/** \brief Returns the characters of the key. They are not null-terminated. */
+	const TCHAR* GetData() const { return Key; }
+
+	/** \brief Returns the number of characters of the key. */
+	int32 Len() const { return Length; }
+
+	/** \brief Returns the precomputed hash of the key. */
+	uint64 GetHash() const { return Hash; }
+
+	/** \brief Copies the key into a string. */
+	FString ToString() const { return FString(Length, Key); }
+
+	/** \brief Copies the key into an owning FSaveKey, reusing the hash. */
+	FSaveKey ToSaveKey() const { return FSaveKey(ToString(), Hash); }
+
+	/** \brief Returns true if this key matches a key string with a known hash. The hashes are compared first. */
+	bool Matches(const FString& OtherKey, uint64 OtherHash) const
+	{
+		return Hash == OtherHash && Length == OtherKey.Len() && FCString::Strnicmp(Key, *OtherKey, Length) == 0;
+	}
+
+	friend bool operator==(const FSaveKey& SaveKey, const FSaveKeyView& View)
+	{
+		return View.Matches(SaveKey.GetKey(), SaveKey.GetHash());
+	}
+
+	/** \brief Matches GetTypeHash of FSaveKey, so views can look up maps keyed by FSaveKey with FindByHash. */
+	friend uint32 GetTypeHash(const FSaveKeyView& View)
+	{
+		return static_cast<uint32>(View.Hash) ^ static_cast<uint32>(View.Hash >> 32);
+	}
+
+private:
+
+	const TCHAR* Key;
+	int32 Length;
+	uint64 Hash;
+};
+
+
+/**
+ * \brief Builds an FSaveKeyView of a string literal, hashed at compile time.
+ *
+ * \code
+ * float Health = 0.0f;
+ * USaveLoadManager::LoadValue(SAVE_KEY("Player.Health"), Health, SaveFilePath);
+ * \endcode
+ */
+#define SAVE_KEY(Literal) FSaveKeyView(TEXT(Literal), std::integral_constant<uint64, FSaveKeyView::HashLiteral(TEXT(Literal))>::value)
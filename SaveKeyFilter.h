@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+ * \struct FSaveKeyFilter
+ * \brief A Bloom filter over the keys of a save file, answering "not present" without looking at the key index.
+ *
+ * The filter is sized for about 1% false positives, with 10 bits and 7 probes per key. The probes are derived from the 64-bit key hash by double hashing, so testing a key
+ * costs no string work at all. A filter that was never sized holds no information and reports every key as possibly present.
+ */
+struct FSaveKeyFilter
+{
+	/** \brief Bits of the filter per key. */
+	static constexpr int32 BitsPerKey = 10;
+
+	/** \brief Number of bits tested per key. */
+	static constexpr uint8 DefaultProbeCount = 7;
+
+	/** \brief Upper bound on the size of the filter, 128 MB. Files with more keys than fit get more false positives, never false negatives. */
+	static constexpr int32 MaxWordCount = 1 << 24;
+
+	/** \brief Sizes the filter for a number of keys and clears it. */
+	void Reset(int32 KeyCount)
+	{
+		// Computed in 64 bits, the bit count of large files does not fit in an int32
+		const int64 BitCount = static_cast<int64>(FMath::Max(KeyCount, 0)) * BitsPerKey;
+		const int32 WordCount = static_cast<int32>(FMath::Clamp<int64>(FMath::DivideAndRoundUp<int64>(BitCount, 64), 1, MaxWordCount));
+		Words.Reset(WordCount);
+		Words.SetNumZeroed(WordCount);
+		ProbeCount = DefaultProbeCount;
+	}
+
+	/** \brief Adds a key by its FSaveKey hash. Does nothing if the filter was never sized. */
+	void Add(uint64 KeyHash)
+	{
+		const uint64 BitCount = static_cast<uint64>(Words.Num()) * 64;
+		for (uint8 Probe = 0; Probe < ProbeCount; ++Probe)
+		{
+			const uint64 Bit = GetProbe(KeyHash, Probe) % BitCount;
+			Words[static_cast<int32>(Bit / 64)] |= 1ull << (Bit % 64);
+		}
+	}
+
+	/** \brief Returns false if the key is certainly not in the filter, true if it may be. */
+	bool MayContain(uint64 KeyHash) const
+	{
+		const uint64 BitCount = static_cast<uint64>(Words.Num()) * 64;
+		for (uint8 Probe = 0; Probe < ProbeCount; ++Probe)
+		{
+			const uint64 Bit = GetProbe(KeyHash, Probe) % BitCount;
+			if ((Words[static_cast<int32>(Bit / 64)] & (1ull << (Bit % 64))) == 0)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	/** \brief Returns the memory allocated by the filter in bytes. */
+	SIZE_T GetAllocatedSize() const { return Words.GetAllocatedSize(); }
+
+	friend FArchive& operator<<(FArchive& Ar, FSaveKeyFilter& Filter)
+	{
+		Ar << Filter.ProbeCount;
+		Ar << Filter.Words;
+
+		// A filter without bits cannot be probed, treat it as one that was never sized
+		if (Ar.IsLoading() && Filter.Words.Num() == 0)
+		{
+			Filter.ProbeCount = 0;
+		}
+
+		return Ar;
+	}
+
+private:
+
+	/** \brief Returns the position of a probe before wrapping, h1 + i * h2 over the two halves of the key hash. */
+	static uint64 GetProbe(uint64 KeyHash, uint8 Probe)
+	{
+		const uint64 FirstHash = KeyHash & 0xFFFFFFFF;
+		const uint64 SecondHash = (KeyHash >> 32) | 1;
+		return FirstHash + Probe * SecondHash;
+	}
+
+	uint8 ProbeCount = 0;
+	TArray<uint64> Words;
+};
@@ -0,0 +1,84 @@
+﻿#include "SaveLoadAsyncActions.h"
+#include "Async/Async.h"
+
+
+USaveDataAsyncAction* USaveDataAsyncAction::SaveDataAsync(UObject* WorldContextObject, const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath)
+{
+	USaveDataAsyncAction* Action = NewObject<USaveDataAsyncAction>();
+	Action->Key = Key;
+	Action->Data = Data;
+	Action->DataType = DataType;
+	Action->SaveFilePath = SaveFilePath;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void USaveDataAsyncAction::Activate()
+{
+	TWeakObjectPtr<USaveDataAsyncAction> WeakThis(this);
+	USaveLoadManager::SaveDataAsync(Key, Data, DataType, SaveFilePath).Then([WeakThis](TFuture<bool> Result)
+	{
+		// Hop back to the game thread before touching the action or broadcasting
+		const bool bSuccess = Result.Get();
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, bSuccess]()
+		{
+			if (USaveDataAsyncAction* Action = WeakThis.Get())
+			{
+				Action->Finish(bSuccess);
+			}
+		});
+	});
+}
+
+void USaveDataAsyncAction::Finish(bool bSuccess)
+{
+	if (bSuccess)
+	{
+		OnSuccess.Broadcast();
+	}
+	else
+	{
+		OnFailure.Broadcast();
+	}
+
+	SetReadyToDestroy();
+}
+
+ULoadDataAsyncAction* ULoadDataAsyncAction::LoadDataAsync(UObject* WorldContextObject, const FString& Key, const FString& SaveFilePath)
+{
+	ULoadDataAsyncAction* Action = NewObject<ULoadDataAsyncAction>();
+	Action->Key = Key;
+	Action->SaveFilePath = SaveFilePath;
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void ULoadDataAsyncAction::Activate()
+{
+	TWeakObjectPtr<ULoadDataAsyncAction> WeakThis(this);
+	USaveLoadManager::LoadDataAsync(Key, SaveFilePath).Then([WeakThis](TFuture<TOptional<FSerializedData>> Result)
+	{
+		// Hop back to the game thread before touching the action or broadcasting
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, LoadedData = Result.Get()]()
+		{
+			if (ULoadDataAsyncAction* Action = WeakThis.Get())
+			{
+				Action->Finish(LoadedData);
+			}
+		});
+	});
+}
+
+void ULoadDataAsyncAction::Finish(const TOptional<FSerializedData>& Result)
+{
+	if (Result.IsSet())
+	{
+		OnSuccess.Broadcast(Result->Data, Result->DataType);
+	}
+	else
+	{
+		OnFailure.Broadcast(TArray<uint8>(), EDataType::FloatType);
+	}
+
+	SetReadyToDestroy();
+}
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "SaveLoadManager.h"
+#include "SaveLoadAsyncActions.generated.h"
+
+
+/**
+ * \brief Delegate broadcast when an asynchronous save finishes.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FSaveDataAsyncDelegate);
+
+/**
+ * \brief Delegate broadcast when an asynchronous load finishes, with the loaded data on success.
+ */
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FLoadDataAsyncDelegate, const TArray<uint8>&, Data, EDataType, DataType);
+
+
+/**
+ * \class USaveDataAsyncAction
+ * \brief A Blueprint latent node that saves data on a worker thread and calls back on the game thread.
+ */
+UCLASS()
+class CSS_API USaveDataAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+
+	/** \brief Called on the game thread once the data was saved successfully. */
+	UPROPERTY(BlueprintAssignable, Category = "SaveLoad")
+	FSaveDataAsyncDelegate OnSuccess;
+
+	/** \brief Called on the game thread if the data could not be saved. */
+	UPROPERTY(BlueprintAssignable, Category = "SaveLoad")
+	FSaveDataAsyncDelegate OnFailure;
+
+	/**
+	 * \brief Saves a piece of data with a key to a specific file without blocking the game thread.
+	 *
+	 * \param WorldContextObject The object used to find the game instance that keeps the action alive.
+	 * \param Key The key associated with the data.
+	 * \param Data The data to be saved.
+	 * \param DataType The type of data being saved.
+	 * \param SaveFilePath The path to the file where the data will be saved.
+	 *
+	 * \return The action, whose pins fire once the save finishes.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", DisplayName = "Save Data Async", ToolTip = "Saves a piece of data with a key to a specific file on a worker thread."))
+	static USaveDataAsyncAction* SaveDataAsync(UObject* WorldContextObject, const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath);
+
+	virtual void Activate() override;
+
+private:
+
+	/** \brief Broadcasts the result and releases the action. Must run on the game thread. */
+	void Finish(bool bSuccess);
+
+	FString Key;
+	TArray<uint8> Data;
+	EDataType DataType = EDataType::FloatType;
+	FString SaveFilePath;
+};
+
+
+/**
+ * \class ULoadDataAsyncAction
+ * \brief A Blueprint latent node that loads data on a worker thread and calls back on the game thread.
+ */
+UCLASS()
+class CSS_API ULoadDataAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+
+	/** \brief Called on the game thread with the loaded data once it was loaded successfully. */
+	UPROPERTY(BlueprintAssignable, Category = "SaveLoad")
+	FLoadDataAsyncDelegate OnSuccess;
+
+	/** \brief Called on the game thread if the data could not be loaded. */
+	UPROPERTY(BlueprintAssignable, Category = "SaveLoad")
+	FLoadDataAsyncDelegate OnFailure;
+
+	/**
+	 * \brief Loads data by given key from a specific file without blocking the game thread.
+	 *
+	 * \param WorldContextObject The object used to find the game instance that keeps the action alive.
+	 * \param Key The key used to identify the data in the save file.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return The action, whose pins fire once the load finishes.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", DisplayName = "Load Data Async", ToolTip = "Loads data by given key from a specific file on a worker thread."))
+	static ULoadDataAsyncAction* LoadDataAsync(UObject* WorldContextObject, const FString& Key, const FString& SaveFilePath);
+
+	virtual void Activate() override;
+
+private:
+
+	/** \brief Broadcasts the result and releases the action. Must run on the game thread. */
+	void Finish(const TOptional<FSerializedData>& Result);
+
+	FString Key;
+	FString SaveFilePath;
+};
@@ -0,0 +1,758 @@
+﻿#include "SaveFileFormat.h"
+#include "SaveFileCache.h"
+#include "SavePageStore.h"
+#include "SaveCodec.h"
+#include "SaveValueCodec.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Misc/Compression.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+
+/*
+ * Benchmarks of the save file formats and codecs, run from the console with SaveLoad.Benchmark* commands. The plugin has no test target, so they are console commands that
+ * log their results instead. They write their files to the project saved directory, and are therefore left out of shipping builds.
+ */
+#if !UE_BUILD_SHIPPING
+
+namespace
+{
+	/**
+	 * \brief Builds entries that look like world state: runs of transforms of nearby actors and repeated descriptive strings.
+	 */
+	TArray<FSerializedData> MakeBenchmarkEntries(int32 EntryCount, int32 EntrySize)
+	{
+		FRandomStream Random(1337);
+
+		TArray<FSerializedData> Entries;
+		Entries.Reserve(EntryCount);
+
+		for (int32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+		{
+			FSerializedData& Entry = Entries.AddDefaulted_GetRef();
+			Entry.Key = FString::Printf(TEXT("Benchmark.Actor_%d"), EntryIndex);
+			Entry.DataType = EntryIndex % 2 == 0 ? EDataType::TransformType : EDataType::FStringType;
+
+			FMemoryWriter MemoryWriter(Entry.Data, true);
+			while (Entry.Data.Num() < EntrySize)
+			{
+				if (Entry.DataType == EDataType::TransformType)
+				{
+					FTransform Transform(FRotator(0.0, Random.FRandRange(0.0, 360.0), 0.0), FVector(Random.FRandRange(-100.0, 100.0), Random.FRandRange(-100.0, 100.0), 0.0));
+					MemoryWriter << Transform;
+				}
+				else
+				{
+					FString Description = FString::Printf(TEXT("Actor %d state: Health=100 Ammo=%d Faction=Neutral"), EntryIndex, Random.RandRange(0, 30));
+					MemoryWriter << Description;
+				}
+			}
+		}
+
+		return Entries;
+	}
+
+	/**
+	 * \brief Writes and reads the same entries with every codec and logs save time, load time and file size.
+	 *
+	 * Usage: SaveLoad.BenchmarkCompression [EntryCount=1000] [EntrySize=4096] [Iterations=3]
+	 */
+	void BenchmarkCompression(const TArray<FString>& Args)
+	{
+		const int32 EntryCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000;
+		const int32 EntrySize = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 4096;
+		const int32 Iterations = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 3;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("CompressionBenchmark.bin");
+		const TArray<FSerializedData> SourceEntries = MakeBenchmarkEntries(EntryCount, EntrySize);
+
+		int64 RawSize = 0;
+		for (const FSerializedData& Entry : SourceEntries)
+		{
+			RawSize += Entry.Data.Num();
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Save file compression benchmark: %d entries, %lld payload bytes, %d iterations"), EntryCount, RawSize, Iterations);
+		UE_LOG(LogTemp, Display, TEXT("%-8s %12s %12s %14s %8s"), TEXT("Codec"), TEXT("Save (ms)"), TEXT("Load (ms)"), TEXT("File (bytes)"), TEXT("Ratio"));
+
+		for (const ESaveCompression Compression : { ESaveCompression::None, ESaveCompression::Zlib, ESaveCompression::LZ4, ESaveCompression::Oodle })
+		{
+			const FName FormatName = FSaveFileFormat::GetCompressionFormat(Compression);
+			if (!FormatName.IsNone() && !FCompression::IsFormatValid(FormatName))
+			{
+				UE_LOG(LogTemp, Display, TEXT("%-8s unavailable"), *FormatName.ToString());
+				continue;
+			}
+
+			FSaveCompressionSettings Settings;
+			Settings.Compression = Compression;
+			Settings.MinSizeToCompress = 0;
+
+			double SaveSeconds = 0.0;
+			double LoadSeconds = 0.0;
+			bool bSuccess = true;
+
+			for (int32 Iteration = 0; Iteration < Iterations && bSuccess; ++Iteration)
+			{
+				TArray<FSerializedData> Entries = SourceEntries;
+
+				const double SaveStart = FPlatformTime::Seconds();
+				bSuccess &= FSaveFileFormat::WriteAllEntries(SaveFilePath, Entries, Settings);
+				SaveSeconds += FPlatformTime::Seconds() - SaveStart;
+
+				TArray<FSerializedData> LoadedEntries;
+				const double LoadStart = FPlatformTime::Seconds();
+				bSuccess &= FSaveFileFormat::ReadAllEntries(SaveFilePath, LoadedEntries);
+				LoadSeconds += FPlatformTime::Seconds() - LoadStart;
+			}
+
+			const int64 FileSize = IFileManager::Get().FileSize(*SaveFilePath);
+			const FString CodecName = FormatName.IsNone() ? TEXT("None") : FormatName.ToString();
+
+			if (!bSuccess)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-8s failed"), *CodecName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-8s %12.2f %12.2f %14lld %8.3f"), *CodecName, SaveSeconds * 1000.0 / Iterations, LoadSeconds * 1000.0 / Iterations, FileSize,
+				RawSize > 0 ? static_cast<double>(FileSize) / RawSize : 0.0);
+		}
+
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkCompressionCommand(
+		TEXT("SaveLoad.BenchmarkCompression"),
+		TEXT("Measures save time, load time and file size of every save file compression codec. Usage: SaveLoad.BenchmarkCompression [EntryCount] [EntrySize] [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkCompression));
+
+	/**
+	 * \brief Times one codec path over many calls and returns the average cost of a call in nanoseconds.
+	 */
+	template <typename CallType>
+	double TimePerCall(int32 Iterations, CallType&& Call)
+	{
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			Call(Iteration);
+		}
+
+		return (FPlatformTime::Seconds() - Start) * 1.0e9 / Iterations;
+	}
+
+	/**
+	 * \brief Compares the archive based encoding of one primitive type with the fixed-width codec, and logs the cost of a call for each path.
+	 */
+	template <typename ValueType>
+	void BenchmarkCodec(const TCHAR* TypeName, int32 Iterations)
+	{
+		// Consumed by every call so the compiler cannot drop the work
+		volatile uint32 Sink = 0;
+
+		const ValueType SampleValue = static_cast<ValueType>(1);
+		const TArray<uint8> Encoded = FSaveFixedWidthCodec::EncodeToArray(SampleValue);
+
+		const double ArchiveEncode = TimePerCall(Iterations, [&](int32 Iteration)
+		{
+			ValueType Value = static_cast<ValueType>(Iteration & 1);
+			TArray<uint8> ByteArray;
+			FMemoryWriter MemoryWriter(ByteArray, true);
+			MemoryWriter << Value;
+			Sink = Sink + ByteArray[0];
+		});
+
+		const double ArrayEncode = TimePerCall(Iterations, [&](int32 Iteration)
+		{
+			const TArray<uint8> ByteArray = FSaveFixedWidthCodec::EncodeToArray(static_cast<ValueType>(Iteration & 1));
+			Sink = Sink + ByteArray[0];
+		});
+
+		const double BufferEncode = TimePerCall(Iterations, [&](int32 Iteration)
+		{
+			uint8 Buffer[FSaveFixedWidthCodec::MaxSize];
+			FSaveFixedWidthCodec::Encode(static_cast<ValueType>(Iteration & 1), MakeArrayView(Buffer));
+			Sink = Sink + Buffer[0];
+		});
+
+		const double ArchiveDecode = TimePerCall(Iterations, [&](int32)
+		{
+			ValueType Value = static_cast<ValueType>(0);
+			FMemoryReader MemoryReader(Encoded, true);
+			MemoryReader << Value;
+			Sink = Sink + static_cast<uint32>(Value);
+		});
+
+		const double FixedDecode = TimePerCall(Iterations, [&](int32)
+		{
+			Sink = Sink + static_cast<uint32>(FSaveFixedWidthCodec::DecodeOr(MakeArrayView(Encoded), static_cast<ValueType>(0)));
+		});
+
+		UE_LOG(LogTemp, Display, TEXT("%-8s %14.1f %14.1f %14.1f %14.1f %14.1f"), TypeName, ArchiveEncode, ArrayEncode, BufferEncode, ArchiveDecode, FixedDecode);
+	}
+
+	/**
+	 * \brief Logs the per-call cost of encoding and decoding primitive values through an archive versus the fixed-width codec.
+	 *
+	 * Usage: SaveLoad.BenchmarkCodecs [Iterations=1000000]
+	 */
+	void BenchmarkCodecs(const TArray<FString>& Args)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1000000;
+
+		UE_LOG(LogTemp, Display, TEXT("Save value codec benchmark: %d calls per path, nanoseconds per call"), Iterations);
+		UE_LOG(LogTemp, Display, TEXT("%-8s %14s %14s %14s %14s %14s"), TEXT("Type"), TEXT("Archive enc"), TEXT("Array enc"), TEXT("Buffer enc"), TEXT("Archive dec"), TEXT("Fixed dec"));
+
+		BenchmarkCodec<float>(TEXT("Float"), Iterations);
+		BenchmarkCodec<double>(TEXT("Double"), Iterations);
+		BenchmarkCodec<int32>(TEXT("Int"), Iterations);
+		BenchmarkCodec<bool>(TEXT("Bool"), Iterations);
+		BenchmarkCodec<uint8>(TEXT("Enum"), Iterations);
+	}
+
+	FAutoConsoleCommand BenchmarkCodecsCommand(
+		TEXT("SaveLoad.BenchmarkCodecs"),
+		TEXT("Measures the per-call cost of archive based and fixed-width encoding of primitive values. Usage: SaveLoad.BenchmarkCodecs [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkCodecs));
+
+	/**
+	 * \brief Writes and reads the same transforms with every spatial encoding and logs save time, load time, file size and the largest translation error.
+	 *
+	 * Decode time is the time LoadValue takes to turn every cached payload into a transform, which compact payloads skip the archive layout for.
+	 *
+	 * Usage: SaveLoad.BenchmarkSpatialEncoding [TransformCount=10000] [Iterations=3]
+	 */
+	void BenchmarkSpatialEncoding(const TArray<FString>& Args)
+	{
+		const int32 TransformCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 3;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("SpatialEncodingBenchmark.bin");
+
+		FRandomStream Random(1337);
+		TArray<FTransform> Transforms;
+		TArray<FSerializedData> SourceEntries;
+		Transforms.Reserve(TransformCount);
+		SourceEntries.Reserve(TransformCount);
+
+		for (int32 TransformIndex = 0; TransformIndex < TransformCount; ++TransformIndex)
+		{
+			FTransform& Transform = Transforms.Emplace_GetRef(FRotator(Random.FRandRange(-90.0, 90.0), Random.FRandRange(0.0, 360.0), Random.FRandRange(-180.0, 180.0)),
+				FVector(Random.FRandRange(-100000.0, 100000.0), Random.FRandRange(-100000.0, 100000.0), Random.FRandRange(0.0, 10000.0)), FVector(Random.FRandRange(0.5, 2.0)));
+
+			FSerializedData& Entry = SourceEntries.AddDefaulted_GetRef();
+			Entry.Key = FString::Printf(TEXT("Benchmark.Actor_%d_Transform"), TransformIndex);
+			Entry.DataType = EDataType::TransformType;
+			FMemoryWriter MemoryWriter(Entry.Data, true);
+			MemoryWriter << Transform;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Save file spatial encoding benchmark: %d transforms, %d iterations"), TransformCount, Iterations);
+		UE_LOG(LogTemp, Display, TEXT("%-10s %12s %12s %12s %14s %14s"), TEXT("Encoding"), TEXT("Save (ms)"), TEXT("Load (ms)"), TEXT("Decode (ms)"), TEXT("File (bytes)"),
+			TEXT("Max error"));
+
+		TArray<FSaveKey> Keys;
+		Keys.Reserve(TransformCount);
+		for (const FSerializedData& Entry : SourceEntries)
+		{
+			Keys.Emplace(Entry.Key);
+		}
+
+		for (const ESaveSpatialEncoding Encoding : { ESaveSpatialEncoding::Archive, ESaveSpatialEncoding::Float, ESaveSpatialEncoding::Half, ESaveSpatialEncoding::Quantized })
+		{
+			FSaveCompressionSettings Settings;
+			Settings.Compression = ESaveCompression::None;
+			Settings.SpatialEncoding = Encoding;
+
+			double SaveSeconds = 0.0;
+			double LoadSeconds = 0.0;
+			double DecodeSeconds = 0.0;
+			double MaxError = 0.0;
+			bool bSuccess = true;
+
+			for (int32 Iteration = 0; Iteration < Iterations && bSuccess; ++Iteration)
+			{
+				TArray<FSerializedData> Entries = SourceEntries;
+
+				const double SaveStart = FPlatformTime::Seconds();
+				bSuccess &= FSaveFileFormat::WriteAllEntries(SaveFilePath, Entries, Settings);
+				SaveSeconds += FPlatformTime::Seconds() - SaveStart;
+
+				TArray<FSerializedData> LoadedEntries;
+				const double LoadStart = FPlatformTime::Seconds();
+				bSuccess &= FSaveFileFormat::ReadAllEntries(SaveFilePath, LoadedEntries);
+				LoadSeconds += FPlatformTime::Seconds() - LoadStart;
+
+				// A first pass fills the cache, the second one only decodes
+				TArray<FTransform> LoadedTransforms;
+				LoadedTransforms.SetNum(TransformCount);
+				for (int32 TransformIndex = 0; bSuccess && TransformIndex < TransformCount; ++TransformIndex)
+				{
+					bSuccess &= USaveLoadManager::LoadValue(Keys[TransformIndex], LoadedTransforms[TransformIndex], SaveFilePath);
+				}
+
+				const double DecodeStart = FPlatformTime::Seconds();
+				for (int32 TransformIndex = 0; bSuccess && TransformIndex < TransformCount; ++TransformIndex)
+				{
+					bSuccess &= USaveLoadManager::LoadValue(Keys[TransformIndex], LoadedTransforms[TransformIndex], SaveFilePath);
+				}
+				DecodeSeconds += FPlatformTime::Seconds() - DecodeStart;
+
+				for (int32 TransformIndex = 0; bSuccess && TransformIndex < TransformCount; ++TransformIndex)
+				{
+					MaxError = FMath::Max(MaxError, FVector::Dist(LoadedTransforms[TransformIndex].GetTranslation(), Transforms[TransformIndex].GetTranslation()));
+				}
+			}
+
+			const FString EncodingName = StaticEnum<ESaveSpatialEncoding>()->GetNameStringByValue(static_cast<int64>(Encoding));
+
+			if (!bSuccess)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-10s failed"), *EncodingName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-10s %12.2f %12.2f %12.2f %14lld %14.4f"), *EncodingName, SaveSeconds * 1000.0 / Iterations, LoadSeconds * 1000.0 / Iterations,
+				DecodeSeconds * 1000.0 / Iterations, IFileManager::Get().FileSize(*SaveFilePath), MaxError);
+		}
+
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkSpatialEncodingCommand(
+		TEXT("SaveLoad.BenchmarkSpatialEncoding"),
+		TEXT("Measures save time, load time, file size and precision of every spatial encoding. Usage: SaveLoad.BenchmarkSpatialEncoding [TransformCount] [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkSpatialEncoding));
+
+	/**
+	 * \brief Saves and loads the same transforms once as one key per transform and once as a single packed array, and logs save time, load time and file size of both.
+	 *
+	 * Usage: SaveLoad.BenchmarkPackedArrays [TransformCount=100000] [Iterations=3]
+	 */
+	void BenchmarkPackedArrays(const TArray<FString>& Args)
+	{
+		const int32 TransformCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 3;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("PackedArrayBenchmark.bin");
+
+		FRandomStream Random(1337);
+		TArray<FTransform> Transforms;
+		Transforms.Reserve(TransformCount);
+		for (int32 TransformIndex = 0; TransformIndex < TransformCount; ++TransformIndex)
+		{
+			Transforms.Emplace(FRotator(0.0, Random.FRandRange(0.0, 360.0), 0.0), FVector(Random.FRandRange(-100000.0, 100000.0), Random.FRandRange(-100000.0, 100000.0), 0.0));
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Save file packed array benchmark: %d transforms, %d iterations"), TransformCount, Iterations);
+		UE_LOG(LogTemp, Display, TEXT("%-10s %12s %12s %14s"), TEXT("Layout"), TEXT("Save (ms)"), TEXT("Load (ms)"), TEXT("File (bytes)"));
+
+		for (const bool bPacked : { false, true })
+		{
+			double SaveSeconds = 0.0;
+			double LoadSeconds = 0.0;
+			bool bSuccess = true;
+
+			for (int32 Iteration = 0; Iteration < Iterations && bSuccess; ++Iteration)
+			{
+				// Both layouts are timed from the values to the file and back, including their encoding
+				const double SaveStart = FPlatformTime::Seconds();
+				TArray<FSerializedData> Entries;
+				if (bPacked)
+				{
+					FSerializedData& Entry = Entries.AddDefaulted_GetRef();
+					Entry.Key = TEXT("Benchmark.Transforms");
+					Entry.DataType = EDataType::TransformArrayType;
+					Entry.Data = USaveLoadManager::TransformArrayToByteArray(Transforms);
+				}
+				else
+				{
+					Entries.Reserve(TransformCount);
+					for (int32 TransformIndex = 0; TransformIndex < TransformCount; ++TransformIndex)
+					{
+						FSerializedData& Entry = Entries.AddDefaulted_GetRef();
+						Entry.Key = FString::Printf(TEXT("Benchmark.Actor_%d_Transform"), TransformIndex);
+						Entry.DataType = EDataType::TransformType;
+						Entry.Data = USaveLoadManager::TransformToByteArray(Transforms[TransformIndex]);
+					}
+				}
+				bSuccess &= FSaveFileFormat::WriteAllEntries(SaveFilePath, Entries, FSaveCompressionSettings());
+				SaveSeconds += FPlatformTime::Seconds() - SaveStart;
+
+				const double LoadStart = FPlatformTime::Seconds();
+				TArray<FSerializedData> LoadedEntries;
+				bSuccess &= FSaveFileFormat::ReadAllEntries(SaveFilePath, LoadedEntries);
+				TArray<FTransform> LoadedTransforms;
+				if (bPacked)
+				{
+					LoadedTransforms = LoadedEntries.Num() > 0 ? USaveLoadManager::ByteArrayToTransformArray(LoadedEntries[0].Data) : TArray<FTransform>();
+				}
+				else
+				{
+					LoadedTransforms.Reserve(LoadedEntries.Num());
+					for (const FSerializedData& Entry : LoadedEntries)
+					{
+						LoadedTransforms.Add(USaveLoadManager::ByteArrayToTransform(Entry.Data));
+					}
+				}
+				LoadSeconds += FPlatformTime::Seconds() - LoadStart;
+
+				bSuccess &= LoadedTransforms.Num() == TransformCount;
+			}
+
+			const TCHAR* LayoutName = bPacked ? TEXT("Packed") : TEXT("PerKey");
+			if (!bSuccess)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-10s failed"), LayoutName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-10s %12.2f %12.2f %14lld"), LayoutName, SaveSeconds * 1000.0 / Iterations, LoadSeconds * 1000.0 / Iterations,
+				IFileManager::Get().FileSize(*SaveFilePath));
+		}
+
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkPackedArraysCommand(
+		TEXT("SaveLoad.BenchmarkPackedArrays"),
+		TEXT("Compares saving transforms as one key each with saving them as one packed array. Usage: SaveLoad.BenchmarkPackedArrays [TransformCount] [Iterations]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPackedArrays));
+
+	/**
+	 * \brief Looks up a cached float by key as an FString, as an FSaveKey built once and as a SAVE_KEY literal, and logs the time per lookup of each.
+	 *
+	 * Usage: SaveLoad.BenchmarkKeyLookup [EntryCount=10000] [Lookups=1000000]
+	 */
+	void BenchmarkKeyLookup(const TArray<FString>& Args)
+	{
+		const int32 EntryCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const int32 Lookups = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1000000;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("KeyLookupBenchmark.bin");
+
+		TArray<FSerializedData> Entries;
+		Entries.Reserve(EntryCount + 1);
+		for (int32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+		{
+			FSerializedData& Entry = Entries.AddDefaulted_GetRef();
+			Entry.Key = FString::Printf(TEXT("Benchmark.Actor_%d_Health"), EntryIndex);
+			Entry.DataType = EDataType::FloatType;
+			Entry.Data = USaveLoadManager::FloatToByteArray(100.0f);
+		}
+
+		FSerializedData& HealthEntry = Entries.AddDefaulted_GetRef();
+		HealthEntry.Key = TEXT("Player.Health");
+		HealthEntry.DataType = EDataType::FloatType;
+		HealthEntry.Data = USaveLoadManager::FloatToByteArray(75.0f);
+
+		if (!FSaveFileFormat::WriteAllEntries(SaveFilePath, Entries, FSaveCompressionSettings()))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Key lookup benchmark failed to write %s"), *SaveFilePath);
+			return;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Save file key lookup benchmark: %d entries, %d lookups"), EntryCount + 1, Lookups);
+		UE_LOG(LogTemp, Display, TEXT("%-10s %12s"), TEXT("Key"), TEXT("ns/lookup"));
+
+		const FString StringKey = TEXT("Player.Health");
+		const FSaveKey SaveKey(StringKey);
+
+		// The first lookup loads the index and the payload into the cache, every timed lookup is served from memory
+		float Health = 0.0f;
+		USaveLoadManager::LoadValue(SaveKey, Health, SaveFilePath);
+
+		for (int32 KeyKind = 0; KeyKind < 3; ++KeyKind)
+		{
+			bool bSuccess = true;
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Lookup = 0; Lookup < Lookups; ++Lookup)
+			{
+				switch (KeyKind)
+				{
+				case 0:
+					bSuccess &= USaveLoadManager::LoadValue(StringKey, Health, SaveFilePath);
+					break;
+				case 1:
+					bSuccess &= USaveLoadManager::LoadValue(SaveKey, Health, SaveFilePath);
+					break;
+				default:
+					bSuccess &= USaveLoadManager::LoadValue(SAVE_KEY("Player.Health"), Health, SaveFilePath);
+					break;
+				}
+			}
+			const double Seconds = FPlatformTime::Seconds() - Start;
+
+			const TCHAR* KeyName = KeyKind == 0 ? TEXT("FString") : KeyKind == 1 ? TEXT("FSaveKey") : TEXT("SAVE_KEY");
+			if (!bSuccess || Health != 75.0f)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-10s failed"), KeyName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-10s %12.1f"), KeyName, Seconds * 1.0e9 / Lookups);
+		}
+
+		FSaveFileCache::Get().Invalidate(SaveFilePath);
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkKeyLookupCommand(
+		TEXT("SaveLoad.BenchmarkKeyLookup"),
+		TEXT("Compares cached lookups by FString key, by FSaveKey and by SAVE_KEY literal. Usage: SaveLoad.BenchmarkKeyLookup [EntryCount] [Lookups]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkKeyLookup));
+
+	/**
+	 * \brief Looks up keys that are not in a save file, once with the save file cache and once without, and logs the time per lookup of each.
+	 *
+	 * Without the cache every lookup opens the file. Misses are then answered by the key filter in front of the index, without reading the index itself.
+	 *
+	 * Usage: SaveLoad.BenchmarkNegativeLookup [EntryCount=10000] [Lookups=1000]
+	 */
+	void BenchmarkNegativeLookup(const TArray<FString>& Args)
+	{
+		const int32 EntryCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const int32 Lookups = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1000;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("NegativeLookupBenchmark.bin");
+
+		TArray<FSerializedData> Entries;
+		Entries.Reserve(EntryCount);
+		for (int32 EntryIndex = 0; EntryIndex < EntryCount; ++EntryIndex)
+		{
+			FSerializedData& Entry = Entries.AddDefaulted_GetRef();
+			Entry.Key = FString::Printf(TEXT("Settings.Option_%d"), EntryIndex);
+			Entry.DataType = EDataType::FloatType;
+			Entry.Data = USaveLoadManager::FloatToByteArray(1.0f);
+		}
+
+		if (!FSaveFileFormat::WriteAllEntries(SaveFilePath, Entries, FSaveCompressionSettings()))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Negative lookup benchmark failed to write %s"), *SaveFilePath);
+			return;
+		}
+
+		TArray<FSaveKey> MissingKeys;
+		MissingKeys.Reserve(Lookups);
+		for (int32 Lookup = 0; Lookup < Lookups; ++Lookup)
+		{
+			MissingKeys.Emplace(FString::Printf(TEXT("Settings.Missing_%d"), Lookup));
+		}
+
+		FSaveFileIndex Index;
+		int32 FalsePositives = 0;
+		if (FSaveFileFormat::ReadIndex(SaveFilePath, Index))
+		{
+			for (const FSaveKey& Key : MissingKeys)
+			{
+				FalsePositives += Index.KeyFilter.MayContain(Key.GetHash()) ? 1 : 0;
+			}
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Save file negative lookup benchmark: %d entries, %d lookups, %d key filter false positives"), EntryCount, Lookups, FalsePositives);
+		UE_LOG(LogTemp, Display, TEXT("%-10s %12s"), TEXT("Cache"), TEXT("us/lookup"));
+
+		FSaveFileCache& Cache = FSaveFileCache::Get();
+		const int64 MemoryBudget = Cache.GetMemoryBudget();
+
+		for (const bool bCached : { false, true })
+		{
+			Cache.SetMemoryBudget(bCached ? FMath::Max<int64>(MemoryBudget, 64 * 1024 * 1024) : 0);
+			Cache.Invalidate(SaveFilePath);
+
+			bool bSuccess = true;
+			const double Start = FPlatformTime::Seconds();
+			for (const FSaveKey& Key : MissingKeys)
+			{
+				TArray<uint8> Data;
+				EDataType DataType;
+				bSuccess &= !USaveLoadManager::LoadData(Key, Data, DataType, SaveFilePath);
+			}
+			const double Seconds = FPlatformTime::Seconds() - Start;
+
+			const TCHAR* CacheName = bCached ? TEXT("On") : TEXT("Off");
+			if (!bSuccess)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-10s failed"), CacheName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-10s %12.2f"), CacheName, Seconds * 1.0e6 / Lookups);
+		}
+
+		Cache.SetMemoryBudget(MemoryBudget);
+		Cache.Invalidate(SaveFilePath);
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkNegativeLookupCommand(
+		TEXT("SaveLoad.BenchmarkNegativeLookup"),
+		TEXT("Measures lookups of keys missing from a save file, with and without the save file cache. Usage: SaveLoad.BenchmarkNegativeLookup [EntryCount] [Lookups]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkNegativeLookup));
+
+	/**
+	 * \brief Saves a few changed entries into a large save file over and over, once stored as a plain file and once in pages, and logs the time and the bytes written per save.
+	 *
+	 * A plain file is rewritten as a whole by every save. A paged file only gets the pages around the new records written, then its page table and a superblock. Compactions
+	 * triggered by the garbage ratio are part of the measurement.
+	 *
+	 * Usage: SaveLoad.BenchmarkPagedStore [EntryCount=10000] [EntrySize=1024] [ChangedEntries=50] [Saves=20]
+	 */
+	void BenchmarkPagedStore(const TArray<FString>& Args)
+	{
+		const int32 EntryCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 10000;
+		const int32 EntrySize = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1024;
+		const int32 ChangedEntries = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 50;
+		const int32 Saves = Args.Num() > 3 ? FMath::Max(FCString::Atoi(*Args[3]), 1) : 20;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("PagedStoreBenchmark.bin");
+		const TArray<FSerializedData> SourceEntries = MakeBenchmarkEntries(EntryCount, EntrySize);
+
+		UE_LOG(LogTemp, Display, TEXT("Save file paged store benchmark: %d entries of %d bytes, %d changed entries per save, %d saves"), EntryCount, EntrySize, ChangedEntries, Saves);
+		UE_LOG(LogTemp, Display, TEXT("%-8s %12s %18s %14s"), TEXT("Engine"), TEXT("Save (ms)"), TEXT("Written per save"), TEXT("File (bytes)"));
+
+		// Rewrite mode is where plain files pay for their whole size on every save
+		const ESaveWriteMode WriteMode = USaveLoadManager::GetWriteMode();
+		USaveLoadManager::SetWriteMode(ESaveWriteMode::Rewrite);
+
+		for (const ESaveStorageEngine StorageEngine : { ESaveStorageEngine::File, ESaveStorageEngine::Paged })
+		{
+			IFileManager::Get().Delete(*SaveFilePath);
+			USaveLoadManager::SetFileStorageEngine(SaveFilePath, StorageEngine);
+			bool bSuccess = USaveLoadManager::SaveDataBatch(SourceEntries, SaveFilePath);
+
+			FRandomStream Random(42);
+			double Seconds = 0.0;
+			int64 BytesWritten = 0;
+			for (int32 Save = 0; bSuccess && Save < Saves; ++Save)
+			{
+				TArray<FSerializedData> Entries;
+				Entries.Reserve(ChangedEntries);
+				for (int32 EntryIndex = 0; EntryIndex < ChangedEntries; ++EntryIndex)
+				{
+					FSerializedData& Entry = Entries.Add_GetRef(SourceEntries[Random.RandRange(0, EntryCount - 1)]);
+					Entry.Data[Random.RandRange(0, Entry.Data.Num() - 1)] ^= 0xFF;
+				}
+
+				const int64 PagesWritten = FSavePageStore::GetTotalPagesWritten();
+				const double Start = FPlatformTime::Seconds();
+				bSuccess = USaveLoadManager::SaveDataBatch(Entries, SaveFilePath);
+				Seconds += FPlatformTime::Seconds() - Start;
+
+				BytesWritten += StorageEngine == ESaveStorageEngine::Paged
+					? (FSavePageStore::GetTotalPagesWritten() - PagesWritten) * FSavePageStore::PageSize
+					: IFileManager::Get().FileSize(*SaveFilePath);
+			}
+
+			const TCHAR* EngineName = StorageEngine == ESaveStorageEngine::Paged ? TEXT("Paged") : TEXT("File");
+			if (!bSuccess)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-8s failed"), EngineName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-8s %12.2f %18lld %14lld"), EngineName, Seconds * 1000.0 / Saves, BytesWritten / Saves, IFileManager::Get().FileSize(*SaveFilePath));
+		}
+
+		USaveLoadManager::SetWriteMode(WriteMode);
+		USaveLoadManager::SetFileStorageEngine(SaveFilePath, ESaveStorageEngine::File);
+		FSaveFileCache::Get().Invalidate(SaveFilePath);
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkPagedStoreCommand(
+		TEXT("SaveLoad.BenchmarkPagedStore"),
+		TEXT("Compares the time and the bytes written per save of plain and paged save files. Usage: SaveLoad.BenchmarkPagedStore [EntryCount] [EntrySize] [ChangedEntries] [Saves]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPagedStore));
+
+	/**
+	 * \brief Saves and loads single keys of a save file with many keys, once stored as a plain file and once as a B+tree, and logs the time per save, the bytes written per save
+	 * and the time per uncached load.
+	 *
+	 * A plain file is rewritten as a whole by every save, and every uncached load reads its whole index. A B+tree only gets the nodes on the path to the key written or read.
+	 *
+	 * Usage: SaveLoad.BenchmarkBTree [EntryCount=100000] [Saves=100]
+	 */
+	void BenchmarkBTree(const TArray<FString>& Args)
+	{
+		const int32 EntryCount = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+		const int32 Saves = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 100;
+
+		const FString SaveFilePath = FPaths::ProjectSavedDir() / TEXT("SavedGames") / TEXT("BTreeBenchmark.bin");
+		const TArray<FSerializedData> SourceEntries = MakeBenchmarkEntries(EntryCount, 64);
+
+		UE_LOG(LogTemp, Display, TEXT("Save file B+tree benchmark: %d entries, %d single key saves and loads"), EntryCount, Saves);
+		UE_LOG(LogTemp, Display, TEXT("%-8s %12s %18s %12s %14s"), TEXT("Engine"), TEXT("Save (ms)"), TEXT("Written per save"), TEXT("Load (us)"), TEXT("File (bytes)"));
+
+		// Rewrite mode and no cache, so both engines pay for what they read and write on every call
+		const ESaveWriteMode WriteMode = USaveLoadManager::GetWriteMode();
+		USaveLoadManager::SetWriteMode(ESaveWriteMode::Rewrite);
+		FSaveFileCache& Cache = FSaveFileCache::Get();
+		const int64 MemoryBudget = Cache.GetMemoryBudget();
+		Cache.SetMemoryBudget(0);
+
+		for (const ESaveStorageEngine StorageEngine : { ESaveStorageEngine::File, ESaveStorageEngine::BTree })
+		{
+			IFileManager::Get().Delete(*SaveFilePath);
+			USaveLoadManager::SetFileStorageEngine(SaveFilePath, StorageEngine);
+			bool bSuccess = USaveLoadManager::SaveDataBatch(SourceEntries, SaveFilePath);
+
+			FRandomStream Random(42);
+			double SaveSeconds = 0.0;
+			int64 BytesWritten = 0;
+			for (int32 Save = 0; bSuccess && Save < Saves; ++Save)
+			{
+				TArray<FSerializedData> Entries;
+				FSerializedData& Entry = Entries.Add_GetRef(SourceEntries[Random.RandRange(0, EntryCount - 1)]);
+				Entry.Data[Random.RandRange(0, Entry.Data.Num() - 1)] ^= 0xFF;
+
+				const int64 PagesWritten = FSavePageStore::GetTotalPagesWritten();
+				const double Start = FPlatformTime::Seconds();
+				bSuccess = USaveLoadManager::SaveDataBatch(Entries, SaveFilePath);
+				SaveSeconds += FPlatformTime::Seconds() - Start;
+
+				BytesWritten += StorageEngine == ESaveStorageEngine::BTree
+					? (FSavePageStore::GetTotalPagesWritten() - PagesWritten) * FSavePageStore::PageSize
+					: IFileManager::Get().FileSize(*SaveFilePath);
+			}
+
+			double LoadSeconds = 0.0;
+			for (int32 Load = 0; bSuccess && Load < Saves; ++Load)
+			{
+				TArray<uint8> Data;
+				EDataType DataType;
+				const double Start = FPlatformTime::Seconds();
+				bSuccess = USaveLoadManager::LoadData(SourceEntries[Random.RandRange(0, EntryCount - 1)].Key, Data, DataType, SaveFilePath);
+				LoadSeconds += FPlatformTime::Seconds() - Start;
+			}
+
+			const TCHAR* EngineName = StorageEngine == ESaveStorageEngine::BTree ? TEXT("BTree") : TEXT("File");
+			if (!bSuccess)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("%-8s failed"), EngineName);
+				continue;
+			}
+
+			UE_LOG(LogTemp, Display, TEXT("%-8s %12.2f %18lld %12.2f %14lld"), EngineName, SaveSeconds * 1000.0 / Saves, BytesWritten / Saves, LoadSeconds * 1.0e6 / Saves,
+				IFileManager::Get().FileSize(*SaveFilePath));
+		}
+
+		USaveLoadManager::SetWriteMode(WriteMode);
+		USaveLoadManager::SetFileStorageEngine(SaveFilePath, ESaveStorageEngine::File);
+		Cache.SetMemoryBudget(MemoryBudget);
+		Cache.Invalidate(SaveFilePath);
+		IFileManager::Get().Delete(*SaveFilePath);
+	}
+
+	FAutoConsoleCommand BenchmarkBTreeCommand(
+		TEXT("SaveLoad.BenchmarkBTree"),
+		TEXT("Compares single key saves and uncached loads of plain and B+tree save files with many keys. Usage: SaveLoad.BenchmarkBTree [EntryCount] [Saves]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkBTree));
+}
+
+#endif // !UE_BUILD_SHIPPING
@@ -1,8 +1,768 @@
 ﻿#include "SaveLoadManager.h"
+#include "SaveFileFormat.h"
+#include "MappedSaveFile.h"
+#include "SaveFileCache.h"
 #include "Misc/FileHelper.h"
 #include "HAL/PlatformFilemanager.h"
 #include "Serialization/Archive.h"
 #include "Serialization/BufferArchive.h"
+#include "Misc/Optional.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
+#include "Async/Async.h"
+#include "Containers/Ticker.h"
+#include "Misc/CoreDelegates.h"
+#include <atomic>
+
+
+namespace
+{
+	/**
+	 * \brief Returns the lock serializing the operations on one save file, so the API can be used from worker threads by the async variants.
+	 *
+	 * Loads share the lock of their file and writes hold it exclusively, so loads never wait for each other, and operations on different files never wait at all. A thread holds
+	 * at most one file lock at a time.
+	 *
+	 * Locks are always taken in this order: the flush lock, a file lock, the pending state lock, then the settings lock. The pending state and settings locks are never held while
+	 * waiting for another lock, so buffered saves never wait for file I/O. The lock of the async save queues is never held together with any other.
+	 */
+	FRWLock& GetFileLock(const FString& SaveFilePath)
+	{
+		static FCriticalSection FileLocksLock;
+		static TMap<FString, TUniquePtr<FRWLock>> FileLocks;
+
+		// Locks are never removed, so the returned reference stays valid
+		FScopeLock Lock(&FileLocksLock);
+		TUniquePtr<FRWLock>& FileLock = FileLocks.FindOrAdd(SaveFilePath);
+		if (!FileLock)
+		{
+			FileLock = MakeUnique<FRWLock>();
+		}
+
+		return *FileLock;
+	}
+
+	/**
+	 * \brief Guards the settings set per save file and the default compression. Only held while they are read or written, never during file I/O.
+	 */
+	FCriticalSection& GetSettingsLock()
+	{
+		static FCriticalSection SettingsLock;
+		return SettingsLock;
+	}
+
+	/**
+	 * \brief Guards the changes held in memory and not written yet: the open transaction and the write-behind buffers.
+	 */
+	FCriticalSection& GetPendingStateLock()
+	{
+		static FCriticalSection PendingStateLock;
+		return PendingStateLock;
+	}
+
+	/**
+	 * \brief Serializes write-behind flushes, so the changes being flushed always belong to a single flush.
+	 */
+	FCriticalSection& GetFlushLock()
+	{
+		static FCriticalSection FlushLock;
+		return FlushLock;
+	}
+
+	/**
+	 * \brief Releases everything held in memory for a save file that is about to be written: its mapping and its cached index and payloads.
+	 */
+	void ReleaseFileForWrite(const FString& SaveFilePath)
+	{
+		// A mapped file cannot be written, and its parsed index would be stale anyway
+		FMappedSaveFile::Release(SaveFilePath);
+		FSaveFileCache::Get().Invalidate(SaveFilePath);
+	}
+
+	/**
+	 * \brief A set of changes to the entries of a single save file, applied together with one write.
+	 */
+	struct FSaveFileChanges
+	{
+		/** \brief True if every entry of the file is deleted before the upserts are applied. */
+		bool bDeleteAll = false;
+
+		/** \brief Entries to insert or replace, by key. */
+		TMap<FSaveKey, FSerializedData> Upserts;
+
+		/** \brief Keys to delete. Always disjoint from the upserted keys. */
+		TSet<FSaveKey> Deletes;
+
+		void Save(FSerializedData&& Entry)
+		{
+			const FSaveKey Key(Entry.Key);
+			Deletes.Remove(Key);
+			Upserts.Add(Key, MoveTemp(Entry));
+		}
+
+		void Delete(const FSaveKey& Key)
+		{
+			Upserts.Remove(Key);
+			if (!bDeleteAll)
+			{
+				Deletes.Add(Key);
+			}
+		}
+
+		void DeleteAll()
+		{
+			bDeleteAll = true;
+			Upserts.Reset();
+			Deletes.Reset();
+		}
+
+		/** \brief Applies newer changes on top of these ones. */
+		void Append(FSaveFileChanges&& NewerChanges)
+		{
+			if (NewerChanges.bDeleteAll)
+			{
+				DeleteAll();
+			}
+
+			for (const FSaveKey& Key : NewerChanges.Deletes)
+			{
+				Delete(Key);
+			}
+
+			for (TPair<FSaveKey, FSerializedData>& Pair : NewerChanges.Upserts)
+			{
+				Save(MoveTemp(Pair.Value));
+			}
+		}
+
+		bool IsEmpty() const { return !bDeleteAll && Upserts.Num() == 0 && Deletes.Num() == 0; }
+
+		/** \brief Returns the pending entry saved for a key, or nullptr if the key was not saved. */
+		const FSerializedData* FindSaved(FSaveKeyView Key) const { return Upserts.FindByHash(GetTypeHash(Key), Key); }
+
+		/** \brief Returns true if the key is deleted by these changes. */
+		bool IsDeleted(FSaveKeyView Key) const { return bDeleteAll ? !FindSaved(Key) : Deletes.FindByHash(GetTypeHash(Key), Key) != nullptr; }
+	};
+
+	/**
+	 * \brief The transaction opened by USaveLoadManager::BeginTransaction, if any.
+	 */
+	struct FSaveTransaction
+	{
+		/** \brief The save file the transaction applies to. */
+		FString SaveFilePath;
+
+		/** \brief The changes buffered until the transaction is committed. */
+		FSaveFileChanges Changes;
+	};
+
+	TOptional<FSaveTransaction> CurrentTransaction;
+
+	/** \brief True while saves and deletes are buffered in PendingWrites instead of being written. */
+	bool bWriteBehindEnabled = false;
+
+	/** \brief Seconds between two background flushes of the write-behind buffers. */
+	float WriteBehindFlushInterval = 5.0f;
+
+	/** \brief Write-behind changes not written yet, by save file path. Repeated saves of a key collapse into one entry. */
+	TMap<FString, FSaveFileChanges> PendingWrites;
+
+	/** \brief Write-behind changes currently being written by a flush, still visible to loads until the flush is done. */
+	TMap<FString, FSaveFileChanges> FlushingWrites;
+
+	/** \brief The core ticker handle of the periodic background flush. */
+	FTSTicker::FDelegateHandle WriteBehindTickerHandle;
+
+	/** \brief True while a background flush is queued or running. */
+	std::atomic<bool> bBackgroundFlushQueued { false };
+
+	/**
+	 * \brief Returns the changes of the open transaction if it applies to the given save file, nullptr otherwise. The pending state lock must be held.
+	 */
+	FSaveFileChanges* FindTransactionChanges(const FString& SaveFilePath)
+	{
+		return CurrentTransaction.IsSet() && CurrentTransaction->SaveFilePath == SaveFilePath ? &CurrentTransaction->Changes : nullptr;
+	}
+
+	/**
+	 * \brief Looks a key up in the changes that are not in the file yet, newest first: the open transaction, the write-behind buffer, then the flush in progress.
+	 *
+	 * The pending state lock must be held.
+	 *
+	 * \return True if the pending changes decide the result. OutEntry is then set to the saved entry, or reset if the key is deleted.
+	 */
+	bool FindPendingEntry(const FString& SaveFilePath, FSaveKeyView Key, TOptional<FSerializedData>& OutEntry)
+	{
+		const FSaveFileChanges* PendingLayers[] = { FindTransactionChanges(SaveFilePath), PendingWrites.Find(SaveFilePath), FlushingWrites.Find(SaveFilePath) };
+		for (const FSaveFileChanges* Changes : PendingLayers)
+		{
+			if (!Changes)
+			{
+				continue;
+			}
+
+			if (const FSerializedData* PendingData = Changes->FindSaved(Key))
+			{
+				OutEntry = *PendingData;
+				return true;
+			}
+
+			if (Changes->IsDeleted(Key))
+			{
+				OutEntry.Reset();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * \brief Collects the keys saved and deleted by the changes that are not in the file yet, merged oldest first: the flush in progress, the write-behind buffer, then the
+	 * open transaction.
+	 *
+	 * The pending state lock must be held.
+	 *
+	 * \param bOutDeleteAll Set to true if every key of the file is deleted before OutSavedKeys are added.
+	 * \param OutSavedKeys Receives the keys that are saved.
+	 * \param OutDeletedKeys Receives the keys of the file that are deleted. Always disjoint from OutSavedKeys.
+	 */
+	void CollectPendingKeys(const FString& SaveFilePath, bool& bOutDeleteAll, TSet<FSaveKey>& OutSavedKeys, TSet<FSaveKey>& OutDeletedKeys)
+	{
+		const FSaveFileChanges* PendingLayers[] = { FlushingWrites.Find(SaveFilePath), PendingWrites.Find(SaveFilePath), FindTransactionChanges(SaveFilePath) };
+		for (const FSaveFileChanges* Changes : PendingLayers)
+		{
+			if (!Changes)
+			{
+				continue;
+			}
+
+			if (Changes->bDeleteAll)
+			{
+				bOutDeleteAll = true;
+				OutSavedKeys.Reset();
+				OutDeletedKeys.Reset();
+			}
+
+			for (const FSaveKey& Key : Changes->Deletes)
+			{
+				OutSavedKeys.Remove(Key);
+				OutDeletedKeys.Add(Key);
+			}
+
+			for (const TPair<FSaveKey, FSerializedData>& Pair : Changes->Upserts)
+			{
+				OutDeletedKeys.Remove(Pair.Key);
+				OutSavedKeys.Add(Pair.Key);
+			}
+		}
+	}
+
+	/**
+	 * \brief Returns true if writes to the save file are currently buffered in memory rather than written.
+	 */
+	bool IsBufferingWrites(const FString& SaveFilePath)
+	{
+		FScopeLock StateLock(&GetPendingStateLock());
+		return bWriteBehindEnabled || FindTransactionChanges(SaveFilePath) != nullptr || PendingWrites.Contains(SaveFilePath);
+	}
+
+	/**
+	 * \brief Returns true if the save file exists, or will exist once the saves buffered for it are written.
+	 */
+	bool SaveFileExists(const FString& SaveFilePath)
+	{
+		if (FPaths::FileExists(SaveFilePath))
+		{
+			return true;
+		}
+
+		FScopeLock StateLock(&GetPendingStateLock());
+		bool bDeleteAll = false;
+		TSet<FSaveKey> SavedKeys;
+		TSet<FSaveKey> DeletedKeys;
+		CollectPendingKeys(SaveFilePath, bDeleteAll, SavedKeys, DeletedKeys);
+		return SavedKeys.Num() > 0;
+	}
+
+	/** \brief Compression settings set through SetFileCompression, by save file path. Guarded by the settings lock. */
+	TMap<FString, FSaveCompressionSettings> FileCompressionSettings;
+
+	/**
+	 * \brief Returns the compression settings for the next write to a save file: the settings set for it, the settings recorded in it, or the default settings, in that order.
+	 *
+	 * The lock of the file must be held. Header is the already read header of the file, if any, which saves opening it again.
+	 */
+	FSaveCompressionSettings ResolveCompressionSettings(const FString& SaveFilePath, const FSaveFileHeader* Header = nullptr)
+	{
+		{
+			FScopeLock SettingsLock(&GetSettingsLock());
+			if (const FSaveCompressionSettings* Settings = FileCompressionSettings.Find(SaveFilePath))
+			{
+				return *Settings;
+			}
+		}
+
+		if (Header)
+		{
+			if (Header->Version >= FSaveFileHeader::CompressionVersion)
+			{
+				return Header->GetCompressionSettings();
+			}
+		}
+		else
+		{
+			FSaveCompressionSettings RecordedSettings;
+			if (FSaveFileFormat::ReadCompressionSettings(SaveFilePath, RecordedSettings))
+			{
+				return RecordedSettings;
+			}
+		}
+
+		return USaveLoadManager::GetDefaultCompression();
+	}
+
+	/** \brief Storage engines set through SetFileStorageEngine, by save file path. Guarded by the settings lock. */
+	TMap<FString, ESaveStorageEngine> FileStorageEngines;
+
+	/**
+	 * \brief Returns the storage engine for the next write to a save file: the engine set for it, otherwise the engine it is stored with. The lock of the file must be held.
+	 *
+	 * StoredEngine is the already known engine the file is stored with, if any, which saves opening it again.
+	 */
+	ESaveStorageEngine ResolveStorageEngine(const FString& SaveFilePath, const ESaveStorageEngine* StoredEngine = nullptr)
+	{
+		{
+			FScopeLock SettingsLock(&GetSettingsLock());
+			if (const ESaveStorageEngine* StorageEngine = FileStorageEngines.Find(SaveFilePath))
+			{
+				return *StorageEngine;
+			}
+		}
+
+		return StoredEngine ? *StoredEngine : FSaveFileFormat::GetStorageEngine(SaveFilePath);
+	}
+
+	/**
+	 * \brief Rewrites a save file with only its live entries. The lock of the file must be held exclusively.
+	 */
+	bool CompactLiveEntries(const FString& SaveFilePath)
+	{
+		ReleaseFileForWrite(SaveFilePath);
+
+		// Only live records are carried over, everything else is dropped
+		return FSaveFileFormat::RewriteFile(SaveFilePath, TArrayView<FSerializedData>(), [](const FString&) { return false; }, ResolveCompressionSettings(SaveFilePath),
+			ResolveStorageEngine(SaveFilePath));
+	}
+
+	/**
+	 * \brief Appends records and tombstones to the record log of a save file, then compacts the file if its garbage ratio got too high. Nothing is appended if both are empty.
+	 */
+	bool AppendToRecordLog(TArrayView<FSerializedData> Entries, TConstArrayView<FString> DeletedKeys, FSaveFileIndex& Index, const FString& SaveFilePath)
+	{
+		if ((Entries.Num() > 0 || DeletedKeys.Num() > 0) && !FSaveFileFormat::AppendRecords(SaveFilePath, Entries, DeletedKeys, Index, ResolveCompressionSettings(SaveFilePath, &Index.Header)))
+		{
+			return false;
+		}
+
+		// Reclaim superseded records and tombstones once they take up too much of the file
+		if (Index.GetGarbageRatio() > USaveLoadManager::GetCompactionGarbageRatio())
+		{
+			return CompactLiveEntries(SaveFilePath);
+		}
+
+		return true;
+	}
+
+	/**
+	 * \brief Reads the live index of a save file that can be appended to. New, legacy and older version files need a full rewrite first, and so do files whose record log ends
+	 * with a torn record, which would hide everything appended after it.
+	 */
+	bool ReadAppendableIndex(const FString& SaveFilePath, FSaveFileIndex& OutIndex)
+	{
+		return FPaths::FileExists(SaveFilePath)
+			&& FSaveFileFormat::ReadIndex(SaveFilePath, OutIndex)
+			&& OutIndex.Header.Version == FSaveFileHeader::CurrentVersion
+			&& !OutIndex.bTornTail;
+	}
+
+	/**
+	 * \brief Applies a set of changes to a save file with a single write. The lock of the file must be held exclusively.
+	 */
+	bool ApplyChanges(const FSaveFileChanges& Changes, const FString& SaveFilePath)
+	{
+		ReleaseFileForWrite(SaveFilePath);
+
+		TArray<FSerializedData> NewEntries;
+		Changes.Upserts.GenerateValueArray(NewEntries);
+
+		// In append-log and in-place mode only the new records and the tombstones of present keys are written. Paged files are always updated this way, so a write only copies
+		// the pages it touches. Files stored with another engine than the one set for them are rewritten below, which converts them
+		const ESaveWriteMode WriteMode = USaveLoadManager::GetWriteMode();
+		const ESaveStorageEngine StoredEngine = FSaveFileFormat::GetStorageEngine(SaveFilePath);
+		const ESaveStorageEngine StorageEngine = ResolveStorageEngine(SaveFilePath, &StoredEngine);
+		const bool bPaged = StorageEngine == ESaveStorageEngine::Paged;
+
+		// B+tree files get their entries inserted and their deleted keys removed whatever the write mode, which writes the nodes on the paths to their leaves and nothing else.
+		// Page stores are only updated in place where FSaveFileFormat::CanUpdateInPlace holds, other platforms rewrite them below
+		const bool bUpdatePages = FSaveFileFormat::CanUpdateInPlace();
+		if (!Changes.bDeleteAll && StorageEngine == ESaveStorageEngine::BTree && StoredEngine == ESaveStorageEngine::BTree && bUpdatePages)
+		{
+			TArray<FString> DeletedKeys;
+			DeletedKeys.Reserve(Changes.Deletes.Num());
+			for (const FSaveKey& Key : Changes.Deletes)
+			{
+				DeletedKeys.Add(Key.GetKey());
+			}
+
+			float GarbageRatio = 0.0f;
+			if (!FSaveFileFormat::UpdateTree(SaveFilePath, NewEntries, DeletedKeys, ResolveCompressionSettings(SaveFilePath), GarbageRatio))
+			{
+				return false;
+			}
+
+			// Rebuilding the tree drops its free pages and packs its leaves
+			return GarbageRatio > USaveLoadManager::GetCompactionGarbageRatio() ? CompactLiveEntries(SaveFilePath) : true;
+		}
+
+		FSaveFileIndex Index;
+		if (!Changes.bDeleteAll && StorageEngine != ESaveStorageEngine::BTree && StoredEngine == StorageEngine && (WriteMode != ESaveWriteMode::Rewrite || bPaged)
+			&& (!bPaged || bUpdatePages) && ReadAppendableIndex(SaveFilePath, Index) && Index.StorageEngine == StorageEngine)
+		{
+			TArray<FString> DeletedKeys;
+			for (const FSaveKey& Key : Changes.Deletes)
+			{
+				if (Index.Find(Key))
+				{
+					DeletedKeys.Add(Key.GetKey());
+				}
+			}
+
+			if (NewEntries.Num() == 0 && DeletedKeys.Num() == 0)
+			{
+				return true;
+			}
+
+			// In-place mode flips the flags of the deleted records instead of appending tombstones, and so do paged files outside append-log mode. Platforms that cannot
+			// update files in place append the tombstones instead
+			if (WriteMode != ESaveWriteMode::AppendLog && DeletedKeys.Num() > 0 && Index.Header.Version >= FSaveFileHeader::IndexTombstoneVersion
+				&& bUpdatePages)
+			{
+				if (!FSaveFileFormat::TombstoneRecords(SaveFilePath, DeletedKeys, Index))
+				{
+					return false;
+				}
+
+				DeletedKeys.Reset();
+			}
+
+			return AppendToRecordLog(NewEntries, DeletedKeys, Index, SaveFilePath);
+		}
+
+		const FSaveCompressionSettings Compression = ResolveCompressionSettings(SaveFilePath);
+
+		// A cleared file only keeps the entries saved after clearing it
+		if (Changes.bDeleteAll)
+		{
+			return FSaveFileFormat::WriteAllEntries(SaveFilePath, NewEntries, Compression, StorageEngine);
+		}
+
+		// Stream the existing records that are neither replaced nor deleted into the new file, legacy files are upgraded to the indexed format here
+		return FSaveFileFormat::RewriteFile(SaveFilePath, NewEntries, [&Changes](const FString& Key)
+		{
+			const FSaveKey SaveKey(Key);
+			return Changes.Upserts.Contains(SaveKey) || Changes.Deletes.Contains(SaveKey);
+		}, Compression, StorageEngine);
+	}
+
+	/**
+	 * \brief Writes the write-behind changes of one save file, or of all files if SaveFilePath is null. Changes that fail to write stay pending.
+	 */
+	bool FlushPendingWrites(const FString* SaveFilePath)
+	{
+		FScopeLock FlushLock(&GetFlushLock());
+
+		// Move the changes aside, loads keep seeing them there until they are written
+		{
+			FScopeLock StateLock(&GetPendingStateLock());
+
+			if (SaveFilePath)
+			{
+				FSaveFileChanges Changes;
+				if (PendingWrites.RemoveAndCopyValue(*SaveFilePath, Changes))
+				{
+					FlushingWrites.Add(*SaveFilePath, MoveTemp(Changes));
+				}
+			}
+			else
+			{
+				FlushingWrites = MoveTemp(PendingWrites);
+				PendingWrites.Reset();
+			}
+
+			if (FlushingWrites.Num() == 0)
+			{
+				return true;
+			}
+		}
+
+		// Each file is locked only while its own changes are written, loads of the other files go on meanwhile
+		TArray<FString> FailedPaths;
+		{
+			for (const TPair<FString, FSaveFileChanges>& Pair : FlushingWrites)
+			{
+				// Changes are only emptied under the file lock, by DeleteFile while this flush waited for it
+				FWriteScopeLock Lock(GetFileLock(Pair.Key));
+				if (!Pair.Value.IsEmpty() && !ApplyChanges(Pair.Value, Pair.Key))
+				{
+					UE_LOG(LogTemp, Error, TEXT("Failed to flush pending writes to file: %s"), *Pair.Key);
+					FailedPaths.Add(Pair.Key);
+				}
+			}
+		}
+
+		{
+			FScopeLock StateLock(&GetPendingStateLock());
+
+			// Keep the changes that could not be written pending, beneath anything saved since
+			for (const FString& FailedPath : FailedPaths)
+			{
+				FSaveFileChanges RetryChanges = MoveTemp(FlushingWrites[FailedPath]);
+				if (FSaveFileChanges* NewerChanges = PendingWrites.Find(FailedPath))
+				{
+					RetryChanges.Append(MoveTemp(*NewerChanges));
+				}
+
+				PendingWrites.Add(FailedPath, MoveTemp(RetryChanges));
+			}
+
+			FlushingWrites.Reset();
+		}
+
+		return FailedPaths.Num() == 0;
+	}
+
+	/**
+	 * \brief Buffers changes in the open transaction if it applies to the save file, or in the write-behind buffer if it is enabled. The pending state lock must be held.
+	 * \param bOutFlushNow Set if the changes were queued behind buffered writes of the file while write-behind is disabled, and must be flushed right away.
+	 * \return False if nothing buffers the changes of the file, which must then be applied to the file.
+	 */
+	bool BufferChanges(FSaveFileChanges& Changes, const FString& SaveFilePath, bool& bOutFlushNow)
+	{
+		bOutFlushNow = false;
+
+		if (FSaveFileChanges* TransactionChanges = FindTransactionChanges(SaveFilePath))
+		{
+			TransactionChanges->Append(MoveTemp(Changes));
+			return true;
+		}
+
+		// Changes of a file that still has buffered writes queue up behind them, even once write-behind is disabled
+		const bool bHasBufferedWrites = PendingWrites.Contains(SaveFilePath) || FlushingWrites.Contains(SaveFilePath);
+		if (bWriteBehindEnabled || bHasBufferedWrites)
+		{
+			PendingWrites.FindOrAdd(SaveFilePath).Append(MoveTemp(Changes));
+			bOutFlushNow = !bWriteBehindEnabled;
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * \brief Buffers changes in the open transaction if it applies to the save file, or in the write-behind buffer if it is enabled. Otherwise applies them to the file right away.
+	 */
+	bool SubmitChanges(FSaveFileChanges& Changes, const FString& SaveFilePath)
+	{
+		bool bBuffered = false;
+		bool bFlushNow = false;
+		{
+			FScopeLock StateLock(&GetPendingStateLock());
+			bBuffered = BufferChanges(Changes, SaveFilePath, bFlushNow);
+		}
+
+		if (bBuffered)
+		{
+			return bFlushNow ? FlushPendingWrites(&SaveFilePath) : true;
+		}
+
+		FWriteScopeLock Lock(GetFileLock(SaveFilePath));
+		return ApplyChanges(Changes, SaveFilePath);
+	}
+
+	/**
+	 * \brief Core ticker callback that queues a background flush of the write-behind buffers.
+	 */
+	bool TickWriteBehind(float DeltaTime)
+	{
+		bool bHasPendingWrites = false;
+		{
+			FScopeLock StateLock(&GetPendingStateLock());
+			bHasPendingWrites = PendingWrites.Num() > 0;
+		}
+
+		// Never queue more than one background flush at a time
+		if (bHasPendingWrites && !bBackgroundFlushQueued.exchange(true))
+		{
+			Async(EAsyncExecution::ThreadPool, []()
+			{
+				FlushPendingWrites(nullptr);
+				bBackgroundFlushQueued = false;
+			});
+		}
+
+		return true;
+	}
+
+	/**
+	 * \brief Restarts the periodic background flush with the current interval, or stops it if write-behind is disabled.
+	 */
+	void UpdateWriteBehindTicker()
+	{
+		if (WriteBehindTickerHandle.IsValid())
+		{
+			FTSTicker::GetCoreTicker().RemoveTicker(WriteBehindTickerHandle);
+			WriteBehindTickerHandle.Reset();
+		}
+
+		if (bWriteBehindEnabled)
+		{
+			WriteBehindTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&TickWriteBehind), WriteBehindFlushInterval);
+		}
+	}
+
+	/**
+	 * \brief Guards the queues of async saves. Only held while a queue is changed, never while a save runs.
+	 */
+	FCriticalSection& GetAsyncSaveLock()
+	{
+		static FCriticalSection AsyncSaveLock;
+		return AsyncSaveLock;
+	}
+
+	/**
+	 * \brief Async saves not finished yet, by save file path, in the order they were issued. The first save of a queue is the one running, its queue is removed once empty.
+	 */
+	TMap<FString, TArray<TUniqueFunction<void()>>> AsyncSaveQueues;
+
+	/**
+	 * \brief Runs the async saves of a save file one after the other on the calling worker, until its queue is empty.
+	 */
+	void RunAsyncSaves(const FString& SaveFilePath)
+	{
+		for (;;)
+		{
+			// The save is moved out, so the queue can grow while it runs. Its slot stays first, which tells new saves a worker is already running the queue
+			TUniqueFunction<void()> Save;
+			{
+				FScopeLock Lock(&GetAsyncSaveLock());
+				Save = MoveTemp(AsyncSaveQueues[SaveFilePath][0]);
+			}
+
+			Save();
+
+			FScopeLock Lock(&GetAsyncSaveLock());
+			TArray<TUniqueFunction<void()>>& Queue = AsyncSaveQueues[SaveFilePath];
+			Queue.RemoveAt(0);
+			if (Queue.Num() == 0)
+			{
+				AsyncSaveQueues.Remove(SaveFilePath);
+				return;
+			}
+		}
+	}
+
+	/**
+	 * \brief Writes everything still buffered before the engine shuts down.
+	 */
+	void FlushOnExit()
+	{
+		FlushPendingWrites(nullptr);
+	}
+
+	/**
+	 * \brief Same as ListKeysWithPrefix, for callers that already hold the lock of the file, shared or exclusive.
+	 */
+	bool ListKeysWithPrefixLocked(const FString& Prefix, TArray<FString>& OutKeys, const FString& SaveFilePath)
+	{
+		OutKeys.Reset();
+
+		// Changes buffered by the open transaction or by write-behind are applied on top of the file. The lock of the file keeps them from being flushed while it is read.
+		bool bDeleteAll = false;
+		TSet<FSaveKey> SavedKeys;
+		TSet<FSaveKey> DeletedKeys;
+		bool bSuccess = false;
+		{
+			FScopeLock StateLock(&GetPendingStateLock());
+
+			CollectPendingKeys(SaveFilePath, bDeleteAll, SavedKeys, DeletedKeys);
+			for (TSet<FSaveKey>::TIterator It(SavedKeys); It; ++It)
+			{
+				if (!It->GetKey().StartsWith(Prefix, ESearchCase::IgnoreCase))
+				{
+					It.RemoveCurrent();
+				}
+			}
+			bSuccess = IsBufferingWrites(SaveFilePath) || bDeleteAll || SavedKeys.Num() > 0;
+		}
+
+		// Only index entries are read, every payload is skipped
+		TArray<FSaveIndexEntry> Entries;
+		if (!bDeleteAll)
+		{
+			if (const TSharedPtr<FMappedSaveFile> MappedFile = FMappedSaveFile::Find(SaveFilePath))
+			{
+				TArray<const FSaveIndexEntry*> MappedEntries;
+				MappedFile->FindByPrefix(Prefix, MappedEntries);
+				for (const FSaveIndexEntry* Entry : MappedEntries)
+				{
+					Entries.Add(*Entry);
+				}
+				bSuccess = true;
+			}
+			else if (FPaths::FileExists(SaveFilePath))
+			{
+				bSuccess |= FSaveFileCache::Get().GetIndexEntries(SaveFilePath, Prefix, Entries);
+			}
+		}
+
+		TSet<FSaveKey> Keys = MoveTemp(SavedKeys);
+		Keys.Reserve(Keys.Num() + Entries.Num());
+		for (const FSaveIndexEntry& Entry : Entries)
+		{
+			const FSaveKey EntryKey = Entry.GetSaveKey();
+			if (!DeletedKeys.Contains(EntryKey))
+			{
+				Keys.Add(EntryKey);
+			}
+		}
+
+		if (!bSuccess)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
+			return false;
+		}
+
+		OutKeys.Reserve(Keys.Num());
+		for (const FSaveKey& Key : Keys)
+		{
+			OutKeys.Add(Key.GetKey());
+		}
+		OutKeys.Sort();
+
+		return true;
+	}
+
+	/**
+	 * \brief Lists the keys of a save file that start with a prefix, ignoring case, without loading any data. Changes buffered by the open transaction or by write-behind
+	 * are included.
+	 */
+	bool ListKeysWithPrefix(const FString& Prefix, TArray<FString>& OutKeys, const FString& SaveFilePath)
+	{
+		FReadScopeLock Lock(GetFileLock(SaveFilePath));
+		return ListKeysWithPrefixLocked(Prefix, OutKeys, SaveFilePath);
+	}
+}
 
 
 FString USaveLoadManager::PrepareFilePath(const FString& FileName, ESaveFileFormat SaveFileFormat)
@@ -10,249 +770,712 @@ FString USaveLoadManager::PrepareFilePath(const FString& FileName, ESaveFileForm
 	// Base directory for saved game files
 	static const FString BaseDirectory = FPaths::ProjectSavedDir() + "/SavedGames";
 
-	// Ensure the base directory exists
-	if (!FPaths::DirectoryExists(BaseDirectory))
+	// Ensure the base directory exists
+	if (!FPaths::DirectoryExists(BaseDirectory))
+	{
+		IFileManager::Get().MakeDirectory(*BaseDirectory, true);
+	}
+
+	// Determine file extension based on the save file format
+	FString FileExtension;
+	switch (SaveFileFormat)
+	{
+	case ESaveFileFormat::BIN:
+		FileExtension = TEXT(".bin"); 
+		break;
+	case ESaveFileFormat::SAV:
+		FileExtension = TEXT(".sav");
+		break;
+	case ESaveFileFormat::DAT:
+		FileExtension = TEXT(".dat");
+		break;
+	default:
+		// Default to ".bin" if format is unknown
+			FileExtension = TEXT(".bin");
+		break;
+	}
+
+	// Construct and return the full file path
+	return BaseDirectory + TEXT("/") + FileName + FileExtension;
+}
+
+bool USaveLoadManager::DoesFileExist(const FString& FilePath)
+{
+	return FPaths::FileExists(FilePath);
+}
+
+void USaveLoadManager::DeleteFile(const FString& FileName)
+{
+	FWriteScopeLock Lock(GetFileLock(FileName));
+
+	// Buffered writes must not bring the file back later. A flush that already moved the changes of the file aside waits for the file lock, so they are emptied in place for it
+	// to skip, and so is the open transaction of the file, which stays open
+	{
+		FScopeLock StateLock(&GetPendingStateLock());
+		PendingWrites.Remove(FileName);
+
+		if (FSaveFileChanges* Changes = FlushingWrites.Find(FileName))
+		{
+			*Changes = FSaveFileChanges();
+		}
+
+		if (FSaveFileChanges* Changes = FindTransactionChanges(FileName))
+		{
+			*Changes = FSaveFileChanges();
+		}
+	}
+
+	ReleaseFileForWrite(FileName);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	if (PlatformFile.FileExists(*FileName))
+	{
+		const bool bSuccess = PlatformFile.DeleteFile(*FileName);
+		if (!bSuccess)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to delete file: %s"), *FileName);
+		}
+	}
+	else
+	{
+		UE_LOG(LogTemp, Log, TEXT("File does not exist: %s"), *FileName);
+	}
+}
+
+bool USaveLoadManager::SaveData(const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath, ESaveCompression Compression,
+	ESaveSpatialEncoding SpatialEncoding)
+{
+    // Add new data entry
+    FSerializedData NewData;
+    NewData.Key = Key;
+    NewData.DataType = DataType;
+    NewData.Data = Data;
+    NewData.Compression = Compression;
+    NewData.SpatialEncoding = SpatialEncoding;
+
+    return SaveSerializedData(MoveTemp(NewData), SaveFilePath);
+}
+
+bool USaveLoadManager::SaveSerializedData(FSerializedData&& Entry, const FString& SaveFilePath)
+{
+    FSaveFileChanges Changes;
+    Changes.Save(MoveTemp(Entry));
+    return SubmitChanges(Changes, SaveFilePath);
+}
+
+bool USaveLoadManager::SaveDataBatch(const TArray<FSerializedData>& Entries, const FString& SaveFilePath)
+{
+    if (Entries.Num() == 0)
+    {
+        return true;
+    }
+
+    // Later entries replace earlier ones with the same key
+    FSaveFileChanges Changes;
+    for (const FSerializedData& Entry : Entries)
+    {
+        Changes.Save(CopyTemp(Entry));
+    }
+
+    return SubmitChanges(Changes, SaveFilePath);
+}
+
+bool USaveLoadManager::SaveDataBatch(const TMap<FString, FSerializedData>& Entries, const FString& SaveFilePath)
+{
+    if (Entries.Num() == 0)
+    {
+        return true;
+    }
+
+    // Map keys take precedence over the keys stored in the entries
+    FSaveFileChanges Changes;
+    for (const TPair<FString, FSerializedData>& Pair : Entries)
+    {
+        FSerializedData NewData = Pair.Value;
+        NewData.Key = Pair.Key;
+        Changes.Save(MoveTemp(NewData));
+    }
+
+    return SubmitChanges(Changes, SaveFilePath);
+}
+
+bool USaveLoadManager::LoadData(const FString& Key, TArray<uint8>& OutData, EDataType& OutDataType, const FString& SaveFilePath)
+{
+    return LoadData(FSaveKey(Key), OutData, OutDataType, SaveFilePath);
+}
+
+bool USaveLoadManager::LoadData(FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType, const FString& SaveFilePath)
+{
+    // Changes buffered by the open transaction or by write-behind take precedence over the file
+    {
+        FScopeLock StateLock(&GetPendingStateLock());
+
+        TOptional<FSerializedData> PendingData;
+        if (FindPendingEntry(SaveFilePath, Key, PendingData))
+        {
+            if (!PendingData.IsSet())
+            {
+                return false; // Data deleted
+            }
+
+            OutData = MoveTemp(PendingData->Data);
+            OutDataType = PendingData->DataType;
+            return true;
+        }
+    }
+
+    FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+    // Mapped files are read straight from memory
+    if (const TSharedPtr<FMappedSaveFile> MappedFile = FMappedSaveFile::Find(SaveFilePath))
+    {
+        return MappedFile->FindEntry(Key, OutData, OutDataType);
+    }
+
+    if (FPaths::FileExists(SaveFilePath))
+    {
+        // Indexed files only read the header, the index and the requested payload, and keep them cached
+        return FSaveFileCache::Get().FindEntry(SaveFilePath, Key, OutData, OutDataType);
+    }
+    else
+    {
+        UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
+    }
+
+    return false; // Data not found
+}
+
+bool USaveLoadManager::LoadDataBatch(const TArray<FString>& Keys, TMap<FString, FSerializedData>& OutEntries, TArray<FString>& OutMissingKeys, const FString& SaveFilePath)
+{
+    OutEntries.Reset();
+    OutMissingKeys.Reset();
+
+    // Changes buffered by the open transaction or by write-behind take precedence over the file, only the other keys are read from it
+    TArray<FString> FileKeys;
+    {
+        FScopeLock StateLock(&GetPendingStateLock());
+
+        for (const FString& Key : Keys)
+        {
+            TOptional<FSerializedData> PendingData;
+            if (!FindPendingEntry(SaveFilePath, FSaveKey(Key), PendingData))
+            {
+                FileKeys.Add(Key);
+            }
+            else if (PendingData.IsSet())
+            {
+                OutEntries.Add(Key, MoveTemp(PendingData.GetValue()));
+            }
+            else
+            {
+                OutMissingKeys.Add(Key);
+            }
+        }
+    }
+
+    if (FileKeys.Num() == 0)
+    {
+        return OutMissingKeys.Num() == 0;
+    }
+
+    FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+    // Mapped files are read straight from memory
+    if (const TSharedPtr<FMappedSaveFile> MappedFile = FMappedSaveFile::Find(SaveFilePath))
+    {
+        for (const FString& Key : FileKeys)
+        {
+            FSerializedData SerializedData;
+            if (MappedFile->FindEntry(FSaveKey(Key), SerializedData.Data, SerializedData.DataType))
+            {
+                SerializedData.Key = Key;
+                OutEntries.Add(Key, MoveTemp(SerializedData));
+            }
+            else
+            {
+                OutMissingKeys.Add(Key);
+            }
+        }
+
+        return OutMissingKeys.Num() == 0;
+    }
+
+    if (FPaths::FileExists(SaveFilePath))
+    {
+        return FSaveFileCache::Get().FindEntries(SaveFilePath, FileKeys, OutEntries, OutMissingKeys) && OutMissingKeys.Num() == 0;
+    }
+    else
+    {
+        UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
+        OutMissingKeys.Append(FileKeys);
+    }
+
+    return false; // Data not found
+}
+
+bool USaveLoadManager::ListKeys(TArray<FString>& OutKeys, const FString& SaveFilePath)
+{
+	return ListKeysWithPrefix(FString(), OutKeys, SaveFilePath);
+}
+
+bool USaveLoadManager::LoadByPrefix(const FString& Prefix, TMap<FString, FSerializedData>& OutEntries, const FString& SaveFilePath)
+{
+	OutEntries.Reset();
+
+	// The matching keys are one range of the sorted key index, their payloads are then read with a single pass over the file
+	TArray<FString> Keys;
+	if (!ListKeysWithPrefix(Prefix, Keys, SaveFilePath) || Keys.Num() == 0)
+	{
+		return false;
+	}
+
+	// Keys deleted in the meantime are simply left out
+	TArray<FString> MissingKeys;
+	LoadDataBatch(Keys, OutEntries, MissingKeys, SaveFilePath);
+	return OutEntries.Num() > 0;
+}
+
+bool USaveLoadManager::GetEntryInfo(const FString& Key, FSaveEntryInfo& OutInfo, const FString& SaveFilePath)
+{
+	const FSaveKey SaveKey(Key);
+
+	// Changes buffered by the open transaction or by write-behind take precedence over the file
+	{
+		FScopeLock StateLock(&GetPendingStateLock());
+
+		TOptional<FSerializedData> PendingData;
+		if (FindPendingEntry(SaveFilePath, SaveKey, PendingData))
+		{
+			if (!PendingData.IsSet())
+			{
+				return false; // Data deleted
+			}
+
+			OutInfo.Key = Key;
+			OutInfo.DataType = PendingData->DataType;
+			OutInfo.DataSize = PendingData->Data.Num();
+			OutInfo.PayloadSize = -1;
+			OutInfo.PayloadOffset = -1;
+			return true;
+		}
+	}
+
+	FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+	FSaveIndexEntry Entry;
+	if (const TSharedPtr<FMappedSaveFile> MappedFile = FMappedSaveFile::Find(SaveFilePath))
+	{
+		const FSaveIndexEntry* MappedEntry = MappedFile->GetIndex().Find(SaveKey);
+		if (!MappedEntry)
+		{
+			return false;
+		}
+
+		Entry = *MappedEntry;
+	}
+	else if (!FPaths::FileExists(SaveFilePath))
 	{
-		IFileManager::Get().MakeDirectory(*BaseDirectory, true);
+		UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
+		return false;
+	}
+	else if (!FSaveFileCache::Get().FindIndexEntry(SaveFilePath, SaveKey, Entry))
+	{
+		return false; // Data not found
 	}
 
-	// Determine file extension based on the save file format
-	FString FileExtension;
-	switch (SaveFileFormat)
+	if (!FSaveFileFormat::GetLoadedDataSize(SaveFilePath, Entry, OutInfo.DataSize))
 	{
-	case ESaveFileFormat::BIN:
-		FileExtension = TEXT(".bin"); 
-		break;
-	case ESaveFileFormat::SAV:
-		FileExtension = TEXT(".sav");
-		break;
-	case ESaveFileFormat::DAT:
-		FileExtension = TEXT(".dat");
-		break;
-	default:
-		// Default to ".bin" if format is unknown
-			FileExtension = TEXT(".bin");
-		break;
+		return false;
 	}
 
-	// Construct and return the full file path
-	return BaseDirectory + TEXT("/") + FileName + FileExtension;
+	OutInfo.Key = Entry.Key;
+	OutInfo.DataType = Entry.DataType;
+	OutInfo.PayloadSize = Entry.DataSize;
+	OutInfo.PayloadOffset = Entry.DataOffset;
+	return true;
 }
 
-bool USaveLoadManager::DoesFileExist(const FString& FilePath)
+bool USaveLoadManager::DeleteData(const FString& Key, const FString& SaveFilePath)
 {
-	return FPaths::FileExists(FilePath);
+	FSaveFileChanges Changes;
+	Changes.Delete(FSaveKey(Key));
+
+	// Buffered deletions are only applied once the transaction is committed or the buffer flushed, but a file that does not exist is never created by them
+	if (!SaveFileExists(SaveFilePath))
+	{
+		return false;
+	}
+
+	// In append-log mode only a tombstone is written, and only if the key is present
+	return SubmitChanges(Changes, SaveFilePath);
 }
 
-void USaveLoadManager::DeleteFile(const FString& FileName)
+bool USaveLoadManager::DeleteByPrefix(const FString& Prefix, const FString& SaveFilePath)
 {
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-
-	if (PlatformFile.FileExists(*FileName))
+	bool bSuccess = false;
+	bool bFlushNow = false;
 	{
-		const bool bSuccess = PlatformFile.DeleteFile(*FileName);
-		if (!bSuccess)
+		// The keys are resolved and their deletions submitted under the same lock, so no write to the file lands in between and escapes the deletion
+		FWriteScopeLock Lock(GetFileLock(SaveFilePath));
+
+		// The matching keys are one range of the sorted key index
+		TArray<FString> Keys;
+		if (!ListKeysWithPrefixLocked(Prefix, Keys, SaveFilePath) || Keys.Num() == 0)
 		{
-			UE_LOG(LogTemp, Error, TEXT("Failed to delete file: %s"), *FileName);
+			return false;
+		}
+
+		FSaveFileChanges Changes;
+		for (const FString& Key : Keys)
+		{
+			Changes.Delete(FSaveKey(Key));
+		}
+
+		bool bBuffered = false;
+		{
+			FScopeLock StateLock(&GetPendingStateLock());
+			bBuffered = BufferChanges(Changes, SaveFilePath, bFlushNow);
 		}
+
+		// All the deletions are applied with a single write, in append-log mode as one batch of tombstones
+		bSuccess = bBuffered || ApplyChanges(Changes, SaveFilePath);
 	}
-	else
+
+	// Flushing locks the file again, which cannot be done while holding its lock
+	return bFlushNow ? FlushPendingWrites(&SaveFilePath) : bSuccess;
+}
+
+bool USaveLoadManager::DeleteAllData(const FString& SaveFilePath)
+{
+	FSaveFileChanges Changes;
+	Changes.DeleteAll();
+
+	// Return false if file does not exist, whether the deletion is buffered or not
+	if (!SaveFileExists(SaveFilePath))
 	{
-		UE_LOG(LogTemp, Log, TEXT("File does not exist: %s"), *FileName);
+		return false;
 	}
+
+	// Write a file with an empty index, effectively clearing it
+	return SubmitChanges(Changes, SaveFilePath);
 }
 
-bool USaveLoadManager::SaveData(const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath)
+bool USaveLoadManager::BeginTransaction(const FString& SaveFilePath)
 {
-    TArray<uint8> ByteArray;
+	FScopeLock StateLock(&GetPendingStateLock());
 
-    // Load existing data if the file exists
-    if (FPaths::FileExists(SaveFilePath))
-    {
-        if (FFileHelper::LoadFileToArray(ByteArray, *SaveFilePath))
-        {
-            FMemoryReader MemoryReader(ByteArray, true);
-            TArray<FSerializedData> ExistingData;
+	if (CurrentTransaction.IsSet())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("A transaction is already open for file: %s"), *CurrentTransaction->SaveFilePath);
+		return false;
+	}
 
-            // Read existing serialized data
-            while (!MemoryReader.AtEnd())
-            {
-                FSerializedData SerializedData;
-                MemoryReader << SerializedData;
-                ExistingData.Add(SerializedData);
-            }
+	CurrentTransaction.Emplace();
+	CurrentTransaction->SaveFilePath = SaveFilePath;
+	return true;
+}
 
-            // Remove existing entry with the same key
-            ExistingData.RemoveAll([&Key](const FSerializedData& Entry) { return Entry.Key == Key; });
+bool USaveLoadManager::CommitTransaction()
+{
+	FSaveTransaction Transaction;
+	bool bBuffered = false;
+	bool bFlushNow = false;
+	{
+		FScopeLock StateLock(&GetPendingStateLock());
 
-            // Add new data entry
-            FSerializedData NewData;
-            NewData.Key = Key;
-            NewData.DataType = DataType;
-            NewData.Data = Data;
-            ExistingData.Add(NewData);
+		if (!CurrentTransaction.IsSet())
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No transaction to commit."));
+			return false;
+		}
 
-            // Serialize all entries back to the file
-            ByteArray.Empty();
-            FMemoryWriter MemoryWriter(ByteArray, true);
-            for (FSerializedData& DataEntry : ExistingData)
-            {
-                MemoryWriter << DataEntry;
-            }
+		// Close the transaction before writing, so the writes below do not join it again
+		Transaction = MoveTemp(CurrentTransaction.GetValue());
+		CurrentTransaction.Reset();
 
-            if (FFileHelper::SaveArrayToFile(ByteArray, *SaveFilePath))
-            {
-                return true;
-            }
-            else
-            {
-                return false;
-            }
-        }
-        else
-        {
-            return false;
-        }
-    }
-    else
-    {
-        // File does not exist, create new one
-        FSerializedData NewData;
-        NewData.Key = Key;
-        NewData.DataType = DataType;
-        NewData.Data = Data;
+		if (Transaction.Changes.IsEmpty())
+		{
+			return true;
+		}
 
-        ByteArray.Empty();
-        FMemoryWriter MemoryWriter(ByteArray, true);
-        MemoryWriter << NewData;
+		// With write-behind the whole transaction joins the buffer and is flushed as one write. It also queues up behind changes of the file that are still buffered or being
+		// flushed, which would otherwise be written over it
+		bBuffered = BufferChanges(Transaction.Changes, Transaction.SaveFilePath, bFlushNow);
+	}
 
-        if (FFileHelper::SaveArrayToFile(ByteArray, *SaveFilePath))
-        {
-            return true;
-        }
-        else
-        {
-            return false;
-        }
-    }
+	if (bBuffered)
+	{
+		return bFlushNow ? FlushPendingWrites(&Transaction.SaveFilePath) : true;
+	}
+
+	FWriteScopeLock Lock(GetFileLock(Transaction.SaveFilePath));
+	return ApplyChanges(Transaction.Changes, Transaction.SaveFilePath);
 }
 
-bool USaveLoadManager::LoadData(const FString& Key, TArray<uint8>& OutData, EDataType& OutDataType, const FString& SaveFilePath)
+void USaveLoadManager::RollbackTransaction()
 {
-    if (FPaths::FileExists(SaveFilePath))
-    {
-        TArray<uint8> ByteArray;
-        if (FFileHelper::LoadFileToArray(ByteArray, *SaveFilePath))
-        {
-            FMemoryReader MemoryReader(ByteArray, true);
+	FScopeLock StateLock(&GetPendingStateLock());
 
-            while (!MemoryReader.AtEnd())
-            {
-                FSerializedData SerializedData;
-                MemoryReader << SerializedData;
-
-                if (SerializedData.Key == Key)
-                {
-                    OutData = SerializedData.Data;
-                    OutDataType = SerializedData.DataType;
-                    return true; // Data found
-                }
-            }
-        }
-        else
-        {
-            UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *SaveFilePath);
-        }
-    }
-    else
-    {
-        UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
-    }
+	CurrentTransaction.Reset();
+}
 
-    return false; // Data not found
+bool USaveLoadManager::IsInTransaction()
+{
+	FScopeLock StateLock(&GetPendingStateLock());
+
+	return CurrentTransaction.IsSet();
 }
 
-bool USaveLoadManager::DeleteData(const FString& Key, const FString& SaveFilePath)
+void USaveLoadManager::SetWriteBehindEnabled(bool bEnabled)
 {
-	if (FPaths::FileExists(SaveFilePath))
 	{
-		TArray<uint8> ByteArray;
-		if (FFileHelper::LoadFileToArray(ByteArray, *SaveFilePath))
+		FScopeLock StateLock(&GetPendingStateLock());
+
+		if (bWriteBehindEnabled == bEnabled)
 		{
-			TArray<FSerializedData> ExistingData;
-			FMemoryReader MemoryReader(ByteArray, true);
+			return;
+		}
 
-			// Read existing serialized data
-			while (!MemoryReader.AtEnd())
-			{
-				FSerializedData SerializedData;
-				MemoryReader << SerializedData;
-				ExistingData.Add(SerializedData);
-			}
+		bWriteBehindEnabled = bEnabled;
+	}
 
-			// Remove data entry with the specified key
-			ExistingData.RemoveAll([&Key](const FSerializedData& Entry) { return Entry.Key == Key; });
+	// Make sure nothing buffered is lost when the engine shuts down
+	static bool bRegisteredExitFlush = false;
+	if (bEnabled && !bRegisteredExitFlush)
+	{
+		FCoreDelegates::OnPreExit.AddStatic(&FlushOnExit);
+		bRegisteredExitFlush = true;
+	}
 
-			// Serialize the remaining entries back to the file
-			ByteArray.Empty();
-			FMemoryWriter MemoryWriter(ByteArray, true);
-            
-			for (FSerializedData& DataEntry : ExistingData)
-			{
-				MemoryWriter << DataEntry;
-			}
+	UpdateWriteBehindTicker();
 
-			if (FFileHelper::SaveArrayToFile(ByteArray, *SaveFilePath))
-			{
-				return true;
-			}
-			else
-			{
-				return false;
-			}
-		}
-		else
-		{
-			return false;
-		}
+	if (!bEnabled)
+	{
+		FlushPendingWrites(nullptr);
 	}
-	else
+}
+
+bool USaveLoadManager::IsWriteBehindEnabled()
+{
+	FScopeLock StateLock(&GetPendingStateLock());
+
+	return bWriteBehindEnabled;
+}
+
+void USaveLoadManager::SetWriteBehindFlushInterval(float Seconds)
+{
+	WriteBehindFlushInterval = FMath::Max(Seconds, 0.0f);
+	UpdateWriteBehindTicker();
+}
+
+float USaveLoadManager::GetWriteBehindFlushInterval()
+{
+	return WriteBehindFlushInterval;
+}
+
+bool USaveLoadManager::Flush()
+{
+	return FlushPendingWrites(nullptr);
+}
+
+void USaveLoadManager::SetDefaultCompression(const FSaveCompressionSettings& Settings)
+{
+	FScopeLock SettingsLock(&GetSettingsLock());
+
+	DefaultCompression = Settings;
+}
+
+FSaveCompressionSettings USaveLoadManager::GetDefaultCompression()
+{
+	FScopeLock SettingsLock(&GetSettingsLock());
+
+	return DefaultCompression;
+}
+
+void USaveLoadManager::SetFileCompression(const FString& SaveFilePath, const FSaveCompressionSettings& Settings)
+{
+	FScopeLock SettingsLock(&GetSettingsLock());
+
+	FileCompressionSettings.Add(SaveFilePath, Settings);
+}
+
+FSaveCompressionSettings USaveLoadManager::GetFileCompression(const FString& SaveFilePath)
+{
+	FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+	return ResolveCompressionSettings(SaveFilePath);
+}
+
+void USaveLoadManager::SetFileStorageEngine(const FString& SaveFilePath, ESaveStorageEngine StorageEngine)
+{
+	FScopeLock SettingsLock(&GetSettingsLock());
+
+	FileStorageEngines.Add(SaveFilePath, StorageEngine);
+}
+
+ESaveStorageEngine USaveLoadManager::GetFileStorageEngine(const FString& SaveFilePath)
+{
+	FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+	return ResolveStorageEngine(SaveFilePath);
+}
+
+bool USaveLoadManager::CompactFile(const FString& SaveFilePath)
+{
+	// Compact what is actually meant to be in the file
+	FlushPendingWrites(&SaveFilePath);
+
+	FWriteScopeLock Lock(GetFileLock(SaveFilePath));
+
+	if (!FPaths::FileExists(SaveFilePath))
 	{
+		UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
 		return false;
 	}
+
+	return CompactLiveEntries(SaveFilePath);
 }
 
-bool USaveLoadManager::DeleteAllData(const FString& SaveFilePath)
+bool USaveLoadManager::MapSaveFile(const FString& SaveFilePath)
+{
+	// The mapping must reflect the buffered writes, which would otherwise release it again once flushed
+	FlushPendingWrites(&SaveFilePath);
+
+	FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+	return FMappedSaveFile::Map(SaveFilePath).IsValid();
+}
+
+void USaveLoadManager::UnmapSaveFile(const FString& SaveFilePath)
 {
-	// Check if the file exists
+	FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+	FMappedSaveFile::Release(SaveFilePath);
+}
+
+bool USaveLoadManager::LoadDataView(const FString& Key, FSaveDataView& OutView, const FString& SaveFilePath)
+{
+	// The file is mapped on first use, without flushing it: the pinned lookup sees the buffered changes, and the view keeps its own reference to the mapping, so a write
+	// releasing it meanwhile cannot pull the data from under the caller
 	if (FPaths::FileExists(SaveFilePath))
 	{
-		// Create an empty FSerializedData array
-		TArray<FSerializedData> EmptyDataArray;
+		FReadScopeLock Lock(GetFileLock(SaveFilePath));
+		FMappedSaveFile::Map(SaveFilePath);
+	}
 
-		// Serialize the empty FSerializedData array to a byte array
-		TArray<uint8> EmptyByteArray;
-		FMemoryWriter MemoryWriter(EmptyByteArray, true);
-		for (FSerializedData& DataEntry : EmptyDataArray)
-		{
-			MemoryWriter << DataEntry;
-		}
+	return LoadDataPinned(FSaveKey(Key), OutView, SaveFilePath);
+}
+
+bool USaveLoadManager::LoadDataPinned(const FString& Key, FSaveDataView& OutView, const FString& SaveFilePath)
+{
+	return LoadDataPinned(FSaveKey(Key), OutView, SaveFilePath);
+}
+
+bool USaveLoadManager::LoadDataPinned(FSaveKeyView Key, FSaveDataView& OutView, const FString& SaveFilePath)
+{
+	return LoadDataPinned(Key, OutView, SaveFilePath, false);
+}
+
+bool USaveLoadManager::LoadDataPinned(FSaveKeyView Key, FSaveDataView& OutView, const FString& SaveFilePath, bool bKeepCompactEncoding)
+{
+	OutView = FSaveDataView();
 
-		// Write the empty byte array to the file, effectively clearing it
-		if (FFileHelper::SaveArrayToFile(EmptyByteArray, *SaveFilePath))
+	// Changes buffered by the open transaction or by write-behind take precedence over the file
+	{
+		FScopeLock StateLock(&GetPendingStateLock());
+
+		TOptional<FSerializedData> PendingData;
+		if (FindPendingEntry(SaveFilePath, Key, PendingData))
 		{
-			// Return true if successful
+			if (!PendingData.IsSet())
+			{
+				return false; // Data deleted
+			}
+
+			OutView.SetBuffer(MakeShared<TArray<uint8>>(MoveTemp(PendingData->Data)), PendingData->DataType);
 			return true;
 		}
-		else
-		{
-			// Return false if saving array to file failed
-			return false;
-		}
 	}
-	else
+
+	FReadScopeLock Lock(GetFileLock(SaveFilePath));
+
+	// Mapped files are viewed in place
+	if (const TSharedPtr<FMappedSaveFile> MappedFile = FMappedSaveFile::Find(SaveFilePath))
 	{
-		// Return false if file does not exist
+		return MappedFile->FindPinnedEntry(Key, OutView, bKeepCompactEncoding);
+	}
+
+	if (!FPaths::FileExists(SaveFilePath))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("File not found: %s"), *SaveFilePath);
 		return false;
 	}
+
+	// Otherwise the view shares the payload buffer of the cache
+	return FSaveFileCache::Get().FindPinnedEntry(SaveFilePath, Key, OutView, bKeepCompactEncoding);
+}
+
+void USaveLoadManager::SetCacheMemoryBudget(int64 MemoryBudget)
+{
+	FSaveFileCache::Get().SetMemoryBudget(MemoryBudget);
+}
+
+FSaveLoadCacheStats USaveLoadManager::GetCacheStats()
+{
+	return FSaveFileCache::Get().GetStats();
+}
+
+void USaveLoadManager::ResetCacheStats()
+{
+	FSaveFileCache::Get().ResetStats();
+}
+
+void USaveLoadManager::ClearCache()
+{
+	FSaveFileCache::Get().Empty();
+}
+
+TFuture<bool> USaveLoadManager::SaveDataAsync(const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath)
+{
+	TSharedRef<TPromise<bool>> Promise = MakeShared<TPromise<bool>>();
+	TFuture<bool> Future = Promise->GetFuture();
+
+	// Saves of the same file run one after the other in the order they were issued, so the last save of a key always wins. Only the first one starts a worker
+	bool bStartWorker = false;
+	{
+		FScopeLock Lock(&GetAsyncSaveLock());
+		TArray<TUniqueFunction<void()>>& Queue = AsyncSaveQueues.FindOrAdd(SaveFilePath);
+		bStartWorker = Queue.Num() == 0;
+		Queue.Add([Key, Data, DataType, SaveFilePath, Promise]()
+		{
+			Promise->SetValue(SaveData(Key, Data, DataType, SaveFilePath));
+		});
+	}
+
+	if (bStartWorker)
+	{
+		Async(EAsyncExecution::ThreadPool, [SaveFilePath]()
+		{
+			RunAsyncSaves(SaveFilePath);
+		});
+	}
+
+	return Future;
+}
+
+TFuture<TOptional<FSerializedData>> USaveLoadManager::LoadDataAsync(const FString& Key, const FString& SaveFilePath)
+{
+	return Async(EAsyncExecution::ThreadPool, [Key, SaveFilePath]()
+	{
+		FSerializedData SerializedData;
+		SerializedData.Key = Key;
+
+		if (LoadData(Key, SerializedData.Data, SerializedData.DataType, SaveFilePath))
+		{
+			return TOptional<FSerializedData>(MoveTemp(SerializedData));
+		}
+
+		return TOptional<FSerializedData>();
+	});
 }
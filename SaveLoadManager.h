@@ -2,8 +2,20 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "Async/Future.h"
+#include "Misc/Optional.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "SaveCodec.h"
+#include "SaveKey.h"
+#include <atomic>
 #include "SaveLoadManager.generated.h"
 
+class FMappedSaveFile;
+
+template <typename ValueType, typename Enable = void>
+struct TSaveCodec;
+
 
 /**
  * \enum ESaveFileFormat
@@ -27,6 +39,94 @@ enum class ESaveFileFormat :uint8
 	DAT UMETA(DisplayName="Data", Tooltip="The Data (DAT) format is a generic data file with a .dat file extension. It can be in ASCII, binary or other data formats. Can be used in many applications or video games, each situating their own structure or usage.")
 };
 
+/**
+ * \enum ESaveWriteMode
+ * \brief An enumeration that represents how SaveData and DeleteData update an existing save file.
+ *
+ * Enum Values:
+ * - Rewrite: Every save or delete rewrites the whole file with only the live entries. Files stay compact, but the cost of a write grows with the file size.
+ * - AppendLog: Saves append a new record and deletes append a tombstone, so the cost of a write only depends on the size of the entry. The newest record of a key wins on read, and
+ * the file is compacted once its garbage passes the compaction ratio.
+ * - InPlace: Saves append a new record like AppendLog, deletes mark the live record of the key as a tombstone in place with a one-byte write. Deleting costs the same
+ * whatever the size of the entry, and the space is reclaimed by compaction. On platforms where FSaveFileFormat::CanUpdateInPlace is false, deletes append a tombstone as in
+ * AppendLog.
+ */
+UENUM(BlueprintType)
+enum class ESaveWriteMode : uint8
+{
+	Rewrite   UMETA(DisplayName = "Rewrite", Tooltip="Every save or delete rewrites the whole file. Files stay compact, but the cost of a write grows with the file size."),
+	AppendLog UMETA(DisplayName = "Append Log", Tooltip="Saves append a new record and deletes append a tombstone. The newest record of a key wins, and the file is compacted once its garbage passes the compaction ratio."),
+	InPlace   UMETA(DisplayName = "In Place", Tooltip="Saves append a new record and deletes mark the record of the key as a tombstone in place. The file is compacted once its garbage passes the compaction ratio.")
+};
+
+/**
+ * \enum ESaveStorageEngine
+ * \brief An enumeration that represents how the bytes of a save file are stored on disk.
+ *
+ * Enum Values:
+ * - File: The save file is written as one plain file. Rewrites go to a temporary file that replaces it.
+ * - Paged: The save file is kept in fixed-size pages placed through a page table. Writes copy the pages they change and publish them with a new page table, so unchanged pages
+ * are never written again and a failed write leaves the previous content in place. Saves to paged files append records whatever the write mode, and deletes mark tombstones in
+ * place unless the write mode is ESaveWriteMode::AppendLog, so a write only touches the pages around its records.
+ * - BTree: The save file is a B+tree of its entries, kept in pages like Paged files. A lookup reads one node per level of the tree, and a save or delete writes the nodes on the
+ * path to its leaf whatever the write mode, so neither depends on the number of keys. Keys are limited to 255 characters. Nodes emptied by deletes are not merged, the tree
+ * is rebuilt once its free pages and the leaves it would no longer need once packed pass the compaction ratio of its pages, or by CompactFile.
+ *
+ * Paged and BTree files are updated with positioned writes, which need FSaveFileFormat::CanUpdateInPlace. On other platforms every write rewrites them to a temporary file.
+ */
+UENUM(BlueprintType)
+enum class ESaveStorageEngine : uint8
+{
+	File  UMETA(DisplayName = "File", Tooltip="The save file is written as one plain file."),
+	Paged UMETA(DisplayName = "Paged", Tooltip="The save file is kept in fixed-size pages. Writes only copy the pages they change and publish them with a new page table."),
+	BTree UMETA(DisplayName = "B+Tree", Tooltip="The save file is a B+tree kept in fixed-size pages. Lookups and writes only touch the nodes on the path to their key, for files with millions of keys.")
+};
+
+/**
+ * \enum ESaveCompression
+ * \brief An enumeration that represents the codec used to compress the payloads of a save file.
+ *
+ * Enum Values:
+ * - FileDefault: Only meaningful per entry. The entry uses the compression settings of its save file.
+ * - None: Payloads are stored raw.
+ * - Zlib: Zlib compression, slow but available on every platform.
+ * - LZ4: LZ4 compression, very fast with a lower compression ratio.
+ * - Oodle: Oodle compression, the best trade between speed and ratio where it is available.
+ */
+UENUM(BlueprintType)
+enum class ESaveCompression : uint8
+{
+	FileDefault UMETA(DisplayName = "File Default", Tooltip="Uses the compression settings of the save file. Only meaningful per entry."),
+	None        UMETA(DisplayName = "None", Tooltip="Payloads are stored raw."),
+	Zlib        UMETA(DisplayName = "Zlib", Tooltip="Zlib compression, slow but available on every platform."),
+	LZ4         UMETA(DisplayName = "LZ4", Tooltip="LZ4 compression, very fast with a lower compression ratio."),
+	Oodle       UMETA(DisplayName = "Oodle", Tooltip="Oodle compression, the best trade between speed and ratio where it is available.")
+};
+
+/**
+ * \enum ESaveSpatialEncoding
+ * \brief An enumeration that represents how vector, rotator and transform entries are stored in a save file.
+ *
+ * Compact encodings are lossy. They only change the bytes stored in the file, loading an entry always returns the archive layout read by ByteArrayToVector, ByteArrayToRotator
+ * and ByteArrayToTransform. LoadValue skips that layout and decodes compact payloads straight into the value.
+ *
+ * Enum Values:
+ * - FileDefault: Only meaningful per entry. The entry uses the spatial encoding of its save file.
+ * - Archive: Stored as written by the archive, in full precision (doubles with large world coordinates).
+ * - Float: Every component is stored as a 32-bit float.
+ * - Half: Rotations and scales are stored as 16-bit floats. Translations stay 32-bit floats, half precision cannot hold world positions.
+ * - Quantized: Rotations are stored as 32-bit smallest-three quaternions and scales as 16-bit floats. Vectors and translations stay 32-bit floats.
+ */
+UENUM(BlueprintType)
+enum class ESaveSpatialEncoding : uint8
+{
+	FileDefault UMETA(DisplayName = "File Default", Tooltip="Uses the spatial encoding of the save file. Only meaningful per entry."),
+	Archive     UMETA(DisplayName = "Archive", Tooltip="Stored as written by the archive, in full precision."),
+	Float       UMETA(DisplayName = "Float", Tooltip="Every component is stored as a 32-bit float."),
+	Half        UMETA(DisplayName = "Half", Tooltip="Rotations and scales are stored as 16-bit floats, translations as 32-bit floats."),
+	Quantized   UMETA(DisplayName = "Quantized", Tooltip="Rotations are stored as 32-bit smallest-three quaternions, scales as 16-bit floats and translations as 32-bit floats.")
+};
+
 /**
  * \brief An enumeration representing different variable data types in Unreal Engine.
  *
@@ -43,7 +143,11 @@ enum class EDataType : uint8
 	EnumType      UMETA(DisplayName = "Enum", Tooltip="Represents an enumeration, used to define a type of element that consists of named constants."),
 	VectorType    UMETA(DisplayName = "Vector", Tooltip="Represents a Vector, which is a structure used to hold a three-dimensional point such as position or direction."),
 	RotatorType   UMETA(DisplayName = "Rotator", Tooltip="Represents a Rotator, which is a structure used to hold rotation in 3-dimensional space."),
-	TransformType UMETA(DisplayName = "Transform", Tooltip="Represents a Transform, which is used to store a combination of translation (position), rotation, and scale.")
+	TransformType UMETA(DisplayName = "Transform", Tooltip="Represents a Transform, which is used to store a combination of translation (position), rotation, and scale."),
+	CustomType    UMETA(DisplayName = "Custom", Tooltip="Represents a user type, encoded by its own TSaveCodec specialization."),
+	FloatArrayType     UMETA(DisplayName = "Float Array", Tooltip="Represents an array of floats, stored as one packed block."),
+	VectorArrayType    UMETA(DisplayName = "Vector Array", Tooltip="Represents an array of Vectors, stored as one packed block."),
+	TransformArrayType UMETA(DisplayName = "Transform Array", Tooltip="Represents an array of Transforms, stored as one packed block.")
 };
 
 /**
@@ -51,7 +155,7 @@ enum class EDataType : uint8
  *
  * This struct is used to store serialized data, including the data type, key, and the actual serializable data.
  */
-USTRUCT(Meta = (ToolTip = "A struct that represents serialized data in your project, containing data type, key, and serialized data."))
+USTRUCT(BlueprintType, Meta = (ToolTip = "A struct that represents serialized data in your project, containing data type, key, and serialized data."))
 struct FSerializedData
 {
 	GENERATED_BODY()
@@ -63,15 +167,15 @@ struct FSerializedData
 	 * This property is of type EDataType and is used for specifying the type of data being serialized. It is a UPROPERTY, which means it can be exposed to the editor with meta information
 	 *. The Meta attribute is used to provide additional information about the property, such as a tooltip that provides a brief description of its purpose.
 	 */
-	UPROPERTY(Meta = (ToolTip = "Specifies the type of the data being serialized."))
-	EDataType DataType;
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "Specifies the type of the data being serialized."))
+	EDataType DataType = EDataType::FloatType;
 
 	/**
 	 * \brief The key associated with this piece of serialized data.
 	 *
 	 * This variable represents the key associated with a piece of serialized data. It is used to identify and access the serialized data in the save file.
 	 */
-	UPROPERTY(Meta = (ToolTip = "The key associated with this piece of serialized data."))
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "The key associated with this piece of serialized data."))
 	FString Key;
 
 	/**
@@ -80,9 +184,26 @@ struct FSerializedData
 	 *
 	 * \see TArray<uint8>
 	 */
-	UPROPERTY(Meta = (ToolTip = "The actual serializable data stored as an array of bytes."))
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "The actual serializable data stored as an array of bytes."))
 	TArray<uint8> Data;
 
+	/**
+	 * \brief The compression used to store this entry in an indexed save file.
+	 *
+	 * ESaveCompression::FileDefault uses the compression settings of the save file, including its size threshold. Any other value is used for this entry regardless of its size. It
+	 * is not part of the legacy serialization below.
+	 */
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "The compression used to store this entry. File Default uses the settings of the save file."))
+	ESaveCompression Compression = ESaveCompression::FileDefault;
+
+	/**
+	 * \brief The encoding used to store this entry in an indexed save file if it is a vector, rotator or transform.
+	 *
+	 * ESaveSpatialEncoding::FileDefault uses the spatial encoding of the save file. It is ignored for every other data type, and is not part of the legacy serialization below.
+	 */
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "The encoding used to store this entry if it is a vector, rotator or transform. File Default uses the setting of the save file."))
+	ESaveSpatialEncoding SpatialEncoding = ESaveSpatialEncoding::FileDefault;
+
 	/**
 	 
 	 * \fn friend FArchive& operator<<(FArchive& Ar, FSerializedData& SerializedData)
@@ -102,6 +223,130 @@ struct FSerializedData
 	}
 };
 
+/**
+ * \brief A struct that describes how the payloads of a save file are compressed and encoded. It is recorded in the header of every indexed save file.
+ */
+USTRUCT(BlueprintType, Meta = (ToolTip = "A struct that describes how the payloads of a save file are compressed and encoded."))
+struct FSaveCompressionSettings
+{
+	GENERATED_BODY()
+
+	/** \brief The codec used for entries that use the file default. */
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "The codec used for entries that use the file default."))
+	ESaveCompression Compression = ESaveCompression::None;
+
+	/** \brief Payloads smaller than this many bytes are stored raw, compressing them costs more than it saves. */
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "Payloads smaller than this many bytes are stored raw.", ClampMin = "0"))
+	int32 MinSizeToCompress = 1024;
+
+	/** \brief The encoding of vector, rotator and transform entries that use the file default. It is applied before compression. */
+	UPROPERTY(BlueprintReadWrite, Category = "SaveLoad", Meta = (ToolTip = "The encoding of vector, rotator and transform entries that use the file default."))
+	ESaveSpatialEncoding SpatialEncoding = ESaveSpatialEncoding::Archive;
+};
+
+/**
+ * \brief A struct that reports the state of the process-wide save file cache.
+ *
+ * A hit is a load served entirely from memory, a miss is a load that had to read from the save file.
+ */
+USTRUCT(BlueprintType, Meta = (ToolTip = "A struct that reports the hit and miss counters and the memory usage of the save file cache."))
+struct FSaveLoadCacheStats
+{
+	GENERATED_BODY()
+
+	/** \brief Number of loads served entirely from memory. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Number of loads served entirely from memory."))
+	int64 Hits = 0;
+
+	/** \brief Number of loads that had to read from the save file. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Number of loads that had to read from the save file."))
+	int64 Misses = 0;
+
+	/** \brief Number of files evicted to stay within the memory budget. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Number of files evicted to stay within the memory budget."))
+	int64 Evictions = 0;
+
+	/** \brief Number of files currently cached. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Number of files currently cached."))
+	int32 CachedFiles = 0;
+
+	/** \brief Approximate memory used by the cache in bytes. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Approximate memory used by the cache in bytes."))
+	int64 MemoryUsage = 0;
+
+	/** \brief Memory budget of the cache in bytes. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Memory budget of the cache in bytes."))
+	int64 MemoryBudget = 0;
+};
+
+/**
+ * \brief A struct that describes an entry of a save file without its data.
+ */
+USTRUCT(BlueprintType, Meta = (ToolTip = "A struct that describes an entry of a save file without its data."))
+struct FSaveEntryInfo
+{
+	GENERATED_BODY()
+
+	/** \brief The key of the entry. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "The key of the entry."))
+	FString Key;
+
+	/** \brief The data type stored for the key. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "The data type stored for the key."))
+	EDataType DataType = EDataType::FloatType;
+
+	/** \brief Size of the data in bytes as LoadData returns it, before compression and compact encoding. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Size of the data in bytes as it is loaded, before compression and compact encoding."))
+	int64 DataSize = 0;
+
+	/** \brief Size of the payload as stored in the file in bytes, after compression and compact encoding, or -1 if the entry is only buffered in memory and not written yet. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Size of the payload as stored in the file in bytes, or -1 if the entry is not written yet."))
+	int64 PayloadSize = -1;
+
+	/** \brief Offset of the payload in the file, or -1 if the entry is only buffered in memory and not written yet. */
+	UPROPERTY(BlueprintReadOnly, Category = "SaveLoad", Meta = (ToolTip = "Offset of the payload in the file, or -1 if the entry is not written yet."))
+	int64 PayloadOffset = -1;
+};
+
+
+/**
+ * \brief A read-only view of loaded data that keeps the buffer it points into alive.
+ *
+ * The view points either into a mapped save file or into a payload buffer shared with the save file cache, and holds a reference to it. The data therefore stays valid for as
+ * long as the view exists, even if the file is unmapped, evicted from the cache or written in the meantime, and loading it costs no copy.
+ *
+ * A view into a mapped file keeps the file itself mapped until the view is destroyed, even after the file is unmapped. That is only done where a mapped file can still be
+ * written, see FMappedSaveFile::CanPinMapping. Elsewhere, such as on Windows, the payload is copied out of the mapping into a buffer of the view's own.
+ */
+struct FSaveDataView
+{
+	/** \brief The loaded bytes. */
+	TConstArrayView<uint8> Data;
+
+	/** \brief The data type of the loaded bytes. */
+	EDataType DataType = EDataType::FloatType;
+
+	/** \brief True if Data holds a compact spatial payload rather than the archive layout, see FSaveSpatialCodec. Only LoadValue asks for compact payloads. */
+	bool bCompactEncoded = false;
+
+	/** \brief Keeps the mapping alive when Data points into a mapped save file. */
+	TSharedPtr<const FMappedSaveFile> MappedFile;
+
+	/** \brief Keeps the buffer alive when Data points into a payload buffer. */
+	TSharedPtr<const TArray<uint8>> Buffer;
+
+	/** \brief Returns true if the view holds loaded data. */
+	bool IsValid() const { return MappedFile.IsValid() || Buffer.IsValid(); }
+
+	/** \brief Points the view at a whole payload buffer and pins it. */
+	void SetBuffer(const TSharedRef<const TArray<uint8>>& InBuffer, EDataType InDataType)
+	{
+		Data = *InBuffer;
+		DataType = InDataType;
+		Buffer = InBuffer;
+	}
+};
+
 
 /**
  * \class USaveLoadManager
@@ -125,6 +370,27 @@ private:
 	 */ 
 	inline static FString DefaultSaveFileName = "GameSave"; 
 
+	/**
+	 * \brief The mode used by SaveData and DeleteData to update existing save files. Defaults to ESaveWriteMode::Rewrite. Atomic, since writes on worker threads read it.
+	 */
+	inline static std::atomic<ESaveWriteMode> WriteMode { ESaveWriteMode::Rewrite };
+
+	/**
+	 * \brief The fraction of garbage bytes (superseded records and tombstones) above which an append-log file is compacted automatically. Atomic like WriteMode.
+	 */
+	inline static std::atomic<float> CompactionGarbageRatio { 0.5f };
+
+	/**
+	 * \brief The compression settings of save files that have no settings of their own yet. Defaults to no compression. Only accessed under the settings lock.
+	 */
+	inline static FSaveCompressionSettings DefaultCompression;
+
+	/**
+	 * \brief Same as the public LoadDataPinned, but with bKeepCompactEncoding set, compactly encoded entries are viewed compact instead of being expanded to the archive layout,
+	 * so LoadValue can decode them without the round trip.
+	 */
+	static bool LoadDataPinned(FSaveKeyView Key, FSaveDataView& OutView, const FString& SaveFilePath, bool bKeepCompactEncoding);
+
 public:
 
 	/**
@@ -147,6 +413,9 @@ public:
 	/**
 	 * \brief Deletes a file with the specified file name.
 	 *
+	 * Changes of the file buffered by write-behind are dropped, including those a flush in progress has not written yet. A transaction open for the file stays open, but the
+	 * changes it buffered so far are dropped as well, so committing it only writes the changes made after the deletion.
+	 *
 	 * \param FileName The name of the file to be deleted.
 	 *
 	 * \return None.
@@ -173,21 +442,84 @@ public:
 	 * \brief Saves data to a file at the specified path.
 	 *
 	 * This method saves the given data to a file at the specified path. If the file already exists, the data will be appended to the existing data. If the file does not exist, a new file
-	 * will be created.
+	 * will be created. The file is always written in the indexed format, so legacy files are upgraded by their first save. Inside a transaction opened for the same file, the data is
+	 * buffered until the transaction is committed.
 	 *
 	 * \param Key The key associated with the data. This is used to identify and retrieve the data when loading.
 	 * \param Data The data to be saved. This should be an array of uint8 values.
 	 * \param DataType The type of data being saved.
 	 * \param SaveFilePath The path to the file where the data will be saved. This should be a valid file path including the file name and extension.
+	 * \param Compression The compression used to store the data. By default the compression settings of the file apply.
+	 * \param SpatialEncoding The encoding used to store vectors, rotators and transforms. By default the spatial encoding of the file applies.
 	 *
 	 * \return true if the data was successfully saved, false otherwise.
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Saves a piece of data with a key to a specific file."))
-	static bool SaveData(const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath);
+	static bool SaveData(const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath, ESaveCompression Compression = ESaveCompression::FileDefault,
+		ESaveSpatialEncoding SpatialEncoding = ESaveSpatialEncoding::FileDefault);
+
+	/**
+	 * \brief Saves a serialized entry, taking over its data instead of copying it.
+	 * \param Entry The entry to save, with its key, data type, data, compression and spatial encoding.
+	 * \param SaveFilePath The path to the file where the data will be saved.
+	 * \return true if the data was successfully saved, false otherwise.
+	 */
+	static bool SaveSerializedData(FSerializedData&& Entry, const FString& SaveFilePath);
+
+	/**
+	 * \brief Saves a typed value with a key, encoded by its TSaveCodec.
+	 *
+	 * The encoder and the data type are picked at compile time and the value is encoded straight into the buffer of the saved entry, which is then handed over without a copy.
+	 * Types without a TSaveCodec specialization do not compile. Include SaveValueCodec.h, which provides the codecs of every EDataType.
+	 *
+	 * \param Key The key associated with the value.
+	 * \param Value The value to save.
+	 * \param SaveFilePath The path to the file where the value will be saved.
+	 *
+	 * \return true if the value was successfully saved, false otherwise.
+	 */
+	template <typename ValueType>
+	static bool SaveValue(const FString& Key, const ValueType& Value, const FString& SaveFilePath)
+	{
+		using FCodec = TSaveCodec<ValueType>;
+
+		FSerializedData NewData;
+		NewData.Key = Key;
+		NewData.DataType = FCodec::DataType;
+		FCodec::Encode(Value, NewData.Data);
+		return SaveSerializedData(MoveTemp(NewData), SaveFilePath);
+	}
+
+	/**
+	 * \brief Saves many pieces of data to a file at the specified path in a single write.
+	 *
+	 * All entries are inserted or replaced in one read-modify-write pass (or one append in ESaveWriteMode::AppendLog mode), instead of one full rewrite per key as with repeated
+	 * SaveData calls. If several entries share a key, the last one wins.
+	 *
+	 * \param Entries The entries to be saved, each with its key, data type and data.
+	 * \param SaveFilePath The path to the file where the data will be saved.
+	 *
+	 * \return true if all the data was successfully saved, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Saves many pieces of data with their keys to a specific file in a single write."))
+	static bool SaveDataBatch(const TArray<FSerializedData>& Entries, const FString& SaveFilePath);
+
+	/**
+	 * \brief Saves many pieces of data to a file at the specified path in a single write.
+	 *
+	 * \param Entries The entries to be saved by key. The map keys take precedence over the keys stored in the entries.
+	 * \param SaveFilePath The path to the file where the data will be saved.
+	 *
+	 * \return true if all the data was successfully saved, false otherwise.
+	 */
+	static bool SaveDataBatch(const TMap<FString, FSerializedData>& Entries, const FString& SaveFilePath);
 
 	/**
 	 * \brief Loads data from a save file.
 	 *
+	 * For files in the indexed format only the header, the key index and the requested payload are read. Legacy files without a header are scanned entry by entry. Parsed
+	 * indexes and loaded payloads are kept in a process-wide cache, so repeated loads from the same file are served from memory until the file changes.
+	 *
 	 * \param Key The key used to identify the data in the save file.
 	 * \param OutData The output array that will contain the loaded data.
 	 * \param OutDataType The output data type of the loaded data.
@@ -198,11 +530,106 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Loads data by given key from a specific file path into the provided output parameters."))
 	static bool LoadData(const FString& Key, TArray<uint8>& OutData, EDataType& OutDataType, const FString& SaveFilePath);
 
+	/**
+	 * \brief Same as the overload above, but takes a key whose hash was computed up front, either an FSaveKey or a literal wrapped in SAVE_KEY, so the key string is neither
+	 * copied nor hashed again.
+	 */
+	static bool LoadData(FSaveKeyView Key, TArray<uint8>& OutData, EDataType& OutDataType, const FString& SaveFilePath);
+
+	/**
+	 * \brief Loads many pieces of data from a save file at once.
+	 *
+	 * The file is opened and its index parsed once for all the keys, instead of once per key as with repeated LoadData calls.
+	 *
+	 * \param Keys The keys used to identify the data in the save file.
+	 * \param OutEntries The output map that will contain the loaded entries by key.
+	 * \param OutMissingKeys The output array that will contain the keys that were not found.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if every key was found, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Loads data for many keys from a specific file path at once, reporting the keys that were not found."))
+	static bool LoadDataBatch(const TArray<FString>& Keys, TMap<FString, FSerializedData>& OutEntries, TArray<FString>& OutMissingKeys, const FString& SaveFilePath);
+
+	/**
+	 * \brief Lists the keys of a save file without loading any data.
+	 *
+	 * Only the key index is read, or the record headers of legacy files, skipping every payload. Changes buffered by the open transaction or by write-behind are included.
+	 *
+	 * \param OutKeys The output array that will contain the keys, sorted.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if the keys could be listed, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Lists the keys stored in a specific file path without loading any data."))
+	static bool ListKeys(TArray<FString>& OutKeys, const FString& SaveFilePath);
+
+	/**
+	 * \brief Describes the entry stored for a key without loading its data.
+	 *
+	 * Only the key index is read, or the record headers of legacy files, skipping every payload. The size prefix of a compressed payload is the only part of it read, to report
+	 * its data size.
+	 *
+	 * \param Key The key used to identify the data in the save file.
+	 * \param OutInfo The output data type, data size, stored payload size and payload offset of the entry.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if the key was found, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Describes the entry stored for a key in a specific file path without loading its data."))
+	static bool GetEntryInfo(const FString& Key, FSaveEntryInfo& OutInfo, const FString& SaveFilePath);
+
+	/**
+	 * \brief Loads every entry whose key starts with a prefix, ignoring case, such as every key of the "Inventory." namespace.
+	 *
+	 * The matching keys are found by binary search over the sorted key index, then their payloads are read with a single pass over the file.
+	 *
+	 * \param Prefix The prefix the keys must start with. An empty prefix loads every entry.
+	 * \param OutEntries The output map that will contain the loaded entries by key.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if at least one entry was loaded, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Loads every entry whose key starts with a prefix from a specific file path."))
+	static bool LoadByPrefix(const FString& Prefix, TMap<FString, FSerializedData>& OutEntries, const FString& SaveFilePath);
+
+	/**
+	 * \brief Saves data to a file at the specified path on a worker thread.
+	 *
+	 * Same as SaveData, but the file work runs on the thread pool so the calling thread is not blocked. The returned future is fulfilled on the worker thread. From Blueprint, use
+	 * the Save Data Async node, which calls back on the game thread.
+	 *
+	 * The save only holds the lock of its own file while it writes, so loads of other files, on any thread, never wait for it. Async saves of the same file run one after the
+	 * other in the order they were issued, so when a key is saved twice, the value saved last is the one kept. Saves of different files run in parallel.
+	 *
+	 * \param Key The key associated with the data.
+	 * \param Data The data to be saved.
+	 * \param DataType The type of data being saved.
+	 * \param SaveFilePath The path to the file where the data will be saved.
+	 *
+	 * \return A future holding true if the data was successfully saved, false otherwise.
+	 */
+	static TFuture<bool> SaveDataAsync(const FString& Key, const TArray<uint8>& Data, EDataType DataType, const FString& SaveFilePath);
+
+	/**
+	 * \brief Loads data from a save file on a worker thread.
+	 *
+	 * Same as LoadData, but the file work runs on the thread pool so the calling thread is not blocked. The returned future is fulfilled on the worker thread. From Blueprint, use
+	 * the Load Data Async node, which calls back on the game thread.
+	 *
+	 * \param Key The key used to identify the data in the save file.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return A future holding the loaded entry, or an unset optional if the data could not be loaded.
+	 */
+	static TFuture<TOptional<FSerializedData>> LoadDataAsync(const FString& Key, const FString& SaveFilePath);
+
 	/**
 	 * \brief Deletes data entry with the specified key from the save file.
 	 *
 	 * This method deletes a data entry with the specified key from the save file located at the provided file path. The method loads the save file into memory, removes the data entry with
 	 * the specified key, and then serializes the remaining entries back to the file. If the delete operation is successful, the method returns true. Otherwise, it returns false.
+	 * Inside a transaction opened for the same file, the deletion is buffered until the transaction is committed.
 	 *
 	 * \param Key The key of the data entry to be deleted.
 	 * \param SaveFilePath The file path to the save file.
@@ -212,11 +639,27 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Deletes the data associated with a given key from a specific file."))
 	static bool DeleteData(const FString& Key, const FString& SaveFilePath);
 
+	/**
+	 * \brief Deletes every entry whose key starts with a prefix, ignoring case, such as every key of the "Quest." namespace.
+	 *
+	 * The matching keys are found by binary search over the sorted key index and deleted with a single write, instead of one write per key. They are resolved and deleted under
+	 * the lock of the file, so no write to the file can land in between.
+	 *
+	 * \param Prefix The prefix the keys must start with.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if at least one entry matched and the deletion succeeded, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Deletes every entry whose key starts with a prefix from a specific file path."))
+	static bool DeleteByPrefix(const FString& Prefix, const FString& SaveFilePath);
+
 	/**
 	 * \brief Deletes all data from the specified save file.
 	 *
+	 * Inside a transaction opened for the same file, the deletion is buffered until the transaction is committed.
+	 *
 	 * This method takes the file path of the save file and deletes all the data within it. If the file exists, it empties the file content effectively. If the file does not exist, it returns
-	 * false without performing any deletion.
+	 * false without performing any deletion, also inside a transaction or with write-behind buffering, unless saves buffered for the file would create it.
 	 *
 	 * \param SaveFilePath The path to the save file from which all data should be deleted.
 	 *
@@ -224,6 +667,317 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Deletes all the data from a specific file."))
 	static bool DeleteAllData(const FString& SaveFilePath);
+
+	/**
+	 * \brief Opens a transaction for a save file.
+	 *
+	 * Until the transaction is committed or rolled back, SaveData, SaveDataBatch, DeleteData and DeleteAllData calls for this file are buffered in memory instead of being written.
+	 * LoadData and LoadDataBatch see the buffered changes. CommitTransaction then writes all of them at once. Only one transaction can be open at a time.
+	 *
+	 * \param SaveFilePath The path to the save file the transaction applies to.
+	 *
+	 * \return True if the transaction was opened, false if another transaction is already open.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Opens a transaction that buffers saves and deletes for a specific file until it is committed."))
+	static bool BeginTransaction(const FString& SaveFilePath);
+
+	/**
+	 * \brief Writes all the changes buffered by the open transaction with a single write and closes the transaction.
+	 * \return True if the changes were written successfully, false otherwise or if no transaction is open.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Writes all the changes buffered by the open transaction at once and closes it."))
+	static bool CommitTransaction();
+
+	/**
+	 * \brief Discards all the changes buffered by the open transaction and closes the transaction.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Discards all the changes buffered by the open transaction and closes it."))
+	static void RollbackTransaction();
+
+	/**
+	 * \brief Checks if a transaction is currently open.
+	 * \return True if a transaction is open.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Checks if a transaction is currently open."))
+	static bool IsInTransaction();
+
+	/**
+	 * \brief Enables or disables write-behind buffering.
+	 *
+	 * While enabled, SaveData, SaveDataBatch, DeleteData, DeleteAllData and committed transactions only update an in-memory buffer per save file, and repeated saves of a key
+	 * collapse into one entry. LoadData and LoadDataBatch see the buffered changes. The buffers are written in the background every flush interval, by Flush, by functions that
+	 * need the file to be up to date (CompactFile, MapSaveFile) and before the engine exits. Disabling write-behind flushes everything still buffered.
+	 *
+	 * Buffered changes are lost if the process crashes before they are flushed.
+	 *
+	 * \param bEnabled True to buffer writes in memory, false to write them right away.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Enables or disables buffering saves and deletes in memory and writing them in the background."))
+	static void SetWriteBehindEnabled(bool bEnabled);
+
+	/**
+	 * \brief Checks if write-behind buffering is enabled.
+	 * \return True if saves and deletes are buffered in memory.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Checks if saves and deletes are buffered in memory and written in the background."))
+	static bool IsWriteBehindEnabled();
+
+	/**
+	 * \brief Sets how often the write-behind buffers are written in the background.
+	 * \param Seconds The interval between two background flushes. An interval of 0 flushes on every engine tick.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets the interval in seconds between two background flushes of buffered writes."))
+	static void SetWriteBehindFlushInterval(float Seconds);
+
+	/**
+	 * \brief Returns how often the write-behind buffers are written in the background.
+	 * \return The interval between two background flushes in seconds.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns the interval in seconds between two background flushes of buffered writes."))
+	static float GetWriteBehindFlushInterval();
+
+	/**
+	 * \brief Writes all the changes buffered by write-behind right away and waits for them to be written.
+	 * \return True if every buffered change was written successfully. Changes that could not be written stay buffered.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Writes all the buffered saves and deletes right away."))
+	static bool Flush();
+
+	/**
+	 * \brief Sets the mode used by SaveData and DeleteData to update existing save files.
+	 *
+	 * In ESaveWriteMode::AppendLog and ESaveWriteMode::InPlace modes, files that are new, legacy or written by an older version are rewritten once by their first save. Later saves
+	 * and deletes append to them, or mark deleted records in place.
+	 *
+	 * \param NewWriteMode The write mode to use.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets whether saves and deletes rewrite the whole file or append to its record log."))
+	static void SetWriteMode(ESaveWriteMode NewWriteMode) { WriteMode.store(NewWriteMode); }
+
+	/**
+	 * \brief Returns the mode used by SaveData and DeleteData to update existing save files.
+	 * \return The current write mode.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns whether saves and deletes rewrite the whole file or append to its record log."))
+	static ESaveWriteMode GetWriteMode() { return WriteMode.load(); }
+
+	/**
+	 * \brief Sets the garbage ratio above which append-log files are compacted automatically after a save or delete.
+	 * \param Ratio The fraction of garbage bytes, clamped between 0 and 1. A ratio of 1 disables automatic compaction.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets the garbage ratio above which append-log files are compacted automatically."))
+	static void SetCompactionGarbageRatio(float Ratio) { CompactionGarbageRatio.store(FMath::Clamp(Ratio, 0.0f, 1.0f)); }
+
+	/**
+	 * \brief Returns the garbage ratio above which append-log files are compacted automatically.
+	 * \return The compaction garbage ratio.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns the garbage ratio above which append-log files are compacted automatically."))
+	static float GetCompactionGarbageRatio() { return CompactionGarbageRatio.load(); }
+
+	/**
+	 * \brief Sets the compression settings used by save files that have no settings of their own yet.
+	 * \param Settings The codec, the size threshold and the spatial encoding to use.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets the compression settings used by new save files."))
+	static void SetDefaultCompression(const FSaveCompressionSettings& Settings);
+
+	/**
+	 * \brief Returns the compression settings used by save files that have no settings of their own yet.
+	 * \return The default compression settings.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns the compression settings used by new save files."))
+	static FSaveCompressionSettings GetDefaultCompression();
+
+	/**
+	 * \brief Sets the compression settings of a save file.
+	 *
+	 * Every save file records its compression settings in its header and keeps them across writes. These settings replace them for all later writes, and are recorded in the file
+	 * by its next rewrite. Use CompactFile to recompress the existing entries right away.
+	 *
+	 * \param SaveFilePath The path to the save file.
+	 * \param Settings The codec, the size threshold and the spatial encoding to use.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets the codec and the size threshold used to compress the entries of a specific file."))
+	static void SetFileCompression(const FString& SaveFilePath, const FSaveCompressionSettings& Settings);
+
+	/**
+	 * \brief Returns the compression settings used by the next write to a save file.
+	 * \param SaveFilePath The path to the save file.
+	 * \return The settings set for the file, the settings recorded in it, or the default settings, in that order.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns the codec and the size threshold used to compress the entries of a specific file."))
+	static FSaveCompressionSettings GetFileCompression(const FString& SaveFilePath);
+
+	/**
+	 * \brief Sets how a save file is stored on disk.
+	 *
+	 * A file stored with another engine is converted by its next save, which rewrites it once. Use CompactFile to convert it right away. Saves of keys longer than 255 characters
+	 * fail on files stored with ESaveStorageEngine::BTree.
+	 *
+	 * \param SaveFilePath The path to the save file.
+	 * \param StorageEngine The storage engine to use.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets whether a specific file is written as one plain file, kept in copy-on-write pages, or kept as a B+tree in those pages."))
+	static void SetFileStorageEngine(const FString& SaveFilePath, ESaveStorageEngine StorageEngine);
+
+	/**
+	 * \brief Returns how the next write to a save file stores it.
+	 * \param SaveFilePath The path to the save file.
+	 * \return The engine set for the file, otherwise the engine the file is stored with. Files that do not exist yet are plain files.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns whether a specific file is written as one plain file, kept in copy-on-write pages, or kept as a B+tree in those pages."))
+	static ESaveStorageEngine GetFileStorageEngine(const FString& SaveFilePath);
+
+	/**
+	 * \brief Compacts a save file by rewriting only its live entries.
+	 *
+	 * Superseded records and tombstones left by ESaveWriteMode::AppendLog and ESaveWriteMode::InPlace modes are dropped. Legacy files are upgraded to the indexed format.
+	 * Entries are recompressed with the current compression settings of the file, and the file is stored with its current storage engine.
+	 *
+	 * \param SaveFilePath The path to the save file to compact.
+	 *
+	 * \return True if the file was compacted successfully, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Compacts a save file by rewriting only its live entries."))
+	static bool CompactFile(const FString& SaveFilePath);
+
+	/**
+	 * \brief Maps a save file read-only into memory and keeps it mapped across calls.
+	 *
+	 * While a file is mapped, LoadData, LoadDataView and LoadDataPinned read from the mapping without any system calls. Writing the file through this class releases the mapping first, and views
+	 * returned by LoadDataPinned never stop it from being written, see FSaveDataView. Only files in the indexed format stored with ESaveStorageEngine::File can be mapped.
+	 *
+	 * \param SaveFilePath The path to the save file to map.
+	 *
+	 * \return True if the file is mapped, false otherwise.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Maps a save file read-only into memory and keeps it mapped for fast repeated loads."))
+	static bool MapSaveFile(const FString& SaveFilePath);
+
+	/**
+	 * \brief Releases the mapping of a save file created by MapSaveFile or LoadDataView.
+	 * \param SaveFilePath The path to the save file to unmap.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Releases the mapping of a save file."))
+	static void UnmapSaveFile(const FString& SaveFilePath);
+
+	/**
+	 * \brief Loads a pinned view of the data stored for a key, mapping the save file on first use.
+	 *
+	 * The file stays mapped, so repeated lookups cost no system calls. Apart from mapping the file, this is LoadDataPinned: the view holds a reference to what it points into and
+	 * stays valid however long it is kept, even if the file is unmapped or written meanwhile, and changes buffered by write-behind or the open transaction are seen without
+	 * flushing them.
+	 *
+	 * \param Key The key used to identify the data in the save file.
+	 * \param OutView Receives the pinned view of the data and its data type.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if the data was found, false otherwise.
+	 */
+	static bool LoadDataView(const FString& Key, FSaveDataView& OutView, const FString& SaveFilePath);
+
+	/**
+	 * \brief Loads the data stored for a key as a view that pins the buffer it points into, so it stays valid for as long as the view exists.
+	 *
+	 * Nothing is copied when the payload is already in memory: the view points into the mapping of a mapped file, or into the payload buffer of the save file cache. Combined with
+	 * the ByteArrayTo* overloads taking a view, values can be decoded without any heap allocation once the payload is cached. Compressed and compactly encoded entries,
+	 * entries that are only buffered in memory, and entries of mapped files where FMappedSaveFile::CanPinMapping is false get a buffer of their own.
+	 *
+	 * \param Key The key used to identify the data in the save file.
+	 * \param OutView Receives the pinned view of the data and its data type.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if the data was found, false otherwise.
+	 */
+	static bool LoadDataPinned(const FString& Key, FSaveDataView& OutView, const FString& SaveFilePath);
+
+	/**
+	 * \brief Same as the overload above, but takes a key whose hash was computed up front, either an FSaveKey or a literal wrapped in SAVE_KEY, so the key string is neither
+	 * copied nor hashed again.
+	 */
+	static bool LoadDataPinned(FSaveKeyView Key, FSaveDataView& OutView, const FString& SaveFilePath);
+
+	/**
+	 * \brief Loads a typed value by key, decoded by its TSaveCodec.
+	 *
+	 * The value is decoded straight from a pinned view of the payload, so nothing is copied when the payload is cached or mapped. Vectors, rotators and transforms stored with a
+	 * compact ESaveSpatialEncoding are decoded from the compact payload itself, without expanding it to the archive layout first. Types without a TSaveCodec specialization do not
+	 * compile. Include SaveValueCodec.h, which provides the codecs of every EDataType.
+	 *
+	 * \param Key The key used to identify the value in the save file.
+	 * \param OutValue Receives the loaded value.
+	 * \param SaveFilePath The file path of the save file.
+	 *
+	 * \return True if the value was found and stored with the data type of ValueType, false otherwise.
+	 */
+	template <typename ValueType>
+	static bool LoadValue(const FString& Key, ValueType& OutValue, const FString& SaveFilePath)
+	{
+		return LoadValue(FSaveKey(Key), OutValue, SaveFilePath);
+	}
+
+	/**
+	 * \brief Same as the overload above, but takes a key whose hash was computed up front, either an FSaveKey or a literal wrapped in SAVE_KEY, so the key string is neither
+	 * copied nor hashed again.
+	 */
+	template <typename ValueType>
+	static bool LoadValue(FSaveKeyView Key, ValueType& OutValue, const FString& SaveFilePath)
+	{
+		using FCodec = TSaveCodec<ValueType>;
+		constexpr bool bSpatialType = FCodec::DataType == EDataType::VectorType || FCodec::DataType == EDataType::RotatorType || FCodec::DataType == EDataType::TransformType;
+
+		FSaveDataView View;
+		if (!LoadDataPinned(Key, View, SaveFilePath, bSpatialType))
+		{
+			return false;
+		}
+
+		if (View.DataType != FCodec::DataType)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Stored data type of key %s does not match the requested type."), *Key.ToString());
+			return false;
+		}
+
+		if constexpr (bSpatialType)
+		{
+			if (View.bCompactEncoded)
+			{
+				return FCodec::DecodeCompact(View.Data, OutValue);
+			}
+		}
+
+		return FCodec::Decode(View.Data, OutValue);
+	}
+
+	/**
+	 * \brief Sets the memory budget of the process-wide save file cache.
+	 *
+	 * Least recently used files are evicted until the cache fits the budget. The default budget is 64 MB.
+	 *
+	 * \param MemoryBudget The budget in bytes. A budget of 0 disables caching.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Sets the memory budget of the save file cache in bytes. A budget of 0 disables caching."))
+	static void SetCacheMemoryBudget(int64 MemoryBudget);
+
+	/**
+	 * \brief Returns the hit and miss counters and the memory usage of the save file cache.
+	 * \return The current cache statistics.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Returns the hit and miss counters and the memory usage of the save file cache."))
+	static FSaveLoadCacheStats GetCacheStats();
+
+	/**
+	 * \brief Resets the hit, miss and eviction counters of the save file cache.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Resets the hit, miss and eviction counters of the save file cache."))
+	static void ResetCacheStats();
+
+	/**
+	 * \brief Drops every file from the save file cache.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Drops every file from the save file cache."))
+	static void ClearCache();
 	
 	/**
 	 * \fn TArray<uint8> FloatToByteArray(float Value)
@@ -234,10 +988,7 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a float value to a byte array."))
 	static TArray<uint8> FloatToByteArray(float Value)
 	{
-		TArray<uint8> ByteArray;
-		FMemoryWriter MemoryWriter(ByteArray, true);
-		MemoryWriter << Value;
-		return ByteArray;
+		return FSaveFixedWidthCodec::EncodeToArray(Value);
 	}
 
 	/**
@@ -249,10 +1000,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to a float value."))
 	static float ByteArrayToFloat(const TArray<uint8>& ByteArray)
 	{
-		float Value = 0.0f;
-		FMemoryReader MemoryReader(ByteArray, true);
-		MemoryReader << Value;
-		return Value;
+		return ByteArrayToFloat(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static float ByteArrayToFloat(TConstArrayView<uint8> ByteArray)
+	{
+		return FSaveFixedWidthCodec::DecodeOr<float>(ByteArray, 0.0f);
 	}
 
 	/**
@@ -262,12 +1018,9 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a boolean value to a byte array."))
 	static TArray<uint8> BoolToByteArray(bool Value)
-{
-    TArray<uint8> ByteArray;
-    FMemoryWriter MemoryWriter(ByteArray, true);
-    MemoryWriter << Value;
-    return ByteArray;
-}
+	{
+		return FSaveFixedWidthCodec::EncodeToArray(Value);
+	}
 
 	/**
 	 * \brief Converts a byte array to a boolean value.
@@ -277,10 +1030,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to a boolean value."))
 	static bool ByteArrayToBool(const TArray<uint8>& ByteArray)
 	{
-		bool Value = false;
-		FMemoryReader MemoryReader(ByteArray, true);
-		MemoryReader << Value;
-		return Value;
+		return ByteArrayToBool(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static bool ByteArrayToBool(TConstArrayView<uint8> ByteArray)
+	{
+		return FSaveFixedWidthCodec::DecodeOr<bool>(ByteArray, false);
 	}
 
 	/**
@@ -291,10 +1049,7 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts an integer value to a byte array."))
 	static TArray<uint8> IntToByteArray(int32 Value)
 	{
-		TArray<uint8> ByteArray;
-		FMemoryWriter MemoryWriter(ByteArray, true);
-		MemoryWriter << Value;
-		return ByteArray;
+		return FSaveFixedWidthCodec::EncodeToArray(Value);
 	}
 
 	/**
@@ -305,10 +1060,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to an integer value."))
 	static int32 ByteArrayToInt(const TArray<uint8>& ByteArray)
 	{
-		int32 Value = 0;
-		FMemoryReader MemoryReader(ByteArray, true);
-		MemoryReader << Value;
-		return Value;
+		return ByteArrayToInt(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static int32 ByteArrayToInt(TConstArrayView<uint8> ByteArray)
+	{
+		return FSaveFixedWidthCodec::DecodeOr<int32>(ByteArray, 0);
 	}
 
 	/**
@@ -332,12 +1092,20 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to a FString value."))
 	static FString ByteArrayToFString(const TArray<uint8>& ByteArray)
-{
-    FString Value;
-    FMemoryReader MemoryReader(ByteArray, true);
-    MemoryReader << Value;
-    return Value;
-}
+	{
+		return ByteArrayToFString(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it. Only the string itself is allocated.
+	 */
+	static FString ByteArrayToFString(TConstArrayView<uint8> ByteArray)
+	{
+		FString Value;
+		FMemoryReaderView MemoryReader(ByteArray, true);
+		MemoryReader << Value;
+		return Value;
+	}
 
 	/**
 	 * \brief Converts an enumeration value to a byte array.
@@ -352,10 +1120,7 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts an enumeration value to a byte array."))
 	static TArray<uint8> EnumToByteArray(uint8 EnumValue)
 	{
-		TArray<uint8> ByteArray;
-		FMemoryWriter MemoryWriter(ByteArray, true);
-		MemoryWriter << EnumValue;
-		return ByteArray;
+		return FSaveFixedWidthCodec::EncodeToArray(EnumValue);
 	}
 
 	/**
@@ -422,10 +1187,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to an enumeration value."))
 	static uint8 ByteArrayToEnum(const TArray<uint8>& ByteArray)
 	{
-		uint8 EnumValue = 0;
-		FMemoryReader MemoryReader(ByteArray, true);
-		MemoryReader << EnumValue;
-		return EnumValue;
+		return ByteArrayToEnum(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static uint8 ByteArrayToEnum(TConstArrayView<uint8> ByteArray)
+	{
+		return FSaveFixedWidthCodec::DecodeOr<uint8>(ByteArray, 0);
 	}
 
 	/**
@@ -448,9 +1218,17 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to a FTransform."))
 	static FTransform ByteArrayToTransform(const TArray<uint8>& ByteArray)
+	{
+		return ByteArrayToTransform(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static FTransform ByteArrayToTransform(TConstArrayView<uint8> ByteArray)
 	{
 		FTransform Value;
-		FMemoryReader MemoryReader(ByteArray, true);
+		FMemoryReaderView MemoryReader(ByteArray, true);
 		MemoryReader << Value;
 		return Value;
 	}
@@ -479,9 +1257,17 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to an FVector."))
 	static FVector ByteArrayToVector(const TArray<uint8>& ByteArray)
+	{
+		return ByteArrayToVector(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static FVector ByteArrayToVector(TConstArrayView<uint8> ByteArray)
 	{
 		FVector Value;
-		FMemoryReader MemoryReader(ByteArray, true);
+		FMemoryReaderView MemoryReader(ByteArray, true);
 		MemoryReader << Value;
 		return Value;
 	}
@@ -509,9 +1295,17 @@ public:
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to an FRotator."))
 	static FRotator ByteArrayToRotator(const TArray<uint8>& ByteArray)
+	{
+		return ByteArrayToRotator(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static FRotator ByteArrayToRotator(TConstArrayView<uint8> ByteArray)
 	{
 		FRotator Value;
-		FMemoryReader MemoryReader(ByteArray, true);
+		FMemoryReaderView MemoryReader(ByteArray, true);
 		MemoryReader << Value;
 		return Value;
 	}
@@ -523,10 +1317,7 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a double to a byte array."))
 	static TArray<uint8> DoubleToByteArray(double Value)
 	{
-		TArray<uint8> ByteArray;
-		FMemoryWriter MemoryWriter(ByteArray, true);
-		MemoryWriter << Value;
-		return ByteArray;
+		return FSaveFixedWidthCodec::EncodeToArray(Value);
 	}
 
 	/**
@@ -537,10 +1328,120 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a byte array to a double."))
 	static double ByteArrayToDouble(const TArray<uint8>& ByteArray)
 	{
-		double Value;
-		FMemoryReader MemoryReader(ByteArray, true);
-		MemoryReader << Value;
-		return Value;
+		return ByteArrayToDouble(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it or allocating.
+	 */
+	static double ByteArrayToDouble(TConstArrayView<uint8> ByteArray)
+	{
+		return FSaveFixedWidthCodec::DecodeOr<double>(ByteArray, 0.0);
+	}
+
+	/**
+	 * \brief Converts an array of floats to a packed byte array, to be saved as EDataType::FloatArrayType.
+	 *
+	 * The floats are copied as one contiguous block, see FSavePackedArrayCodec. Saving a whole array under one key avoids paying a key, a data type and a record per element.
+	 *
+	 * \param Values The floats to convert.
+	 * \return The packed byte array.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts an array of floats to a packed byte array."))
+	static TArray<uint8> FloatArrayToByteArray(const TArray<float>& Values)
+	{
+		TArray<uint8> ByteArray;
+		FSavePackedArrayCodec::Encode(MakeArrayView(Values), ByteArray);
+		return ByteArray;
+	}
+
+	/**
+	 * \brief Converts a packed byte array to an array of floats.
+	 * \param ByteArray The packed byte array.
+	 * \return The floats, or an empty array if the byte array does not hold packed floats.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a packed byte array to an array of floats."))
+	static TArray<float> ByteArrayToFloatArray(const TArray<uint8>& ByteArray)
+	{
+		return ByteArrayToFloatArray(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it.
+	 */
+	static TArray<float> ByteArrayToFloatArray(TConstArrayView<uint8> ByteArray)
+	{
+		TArray<float> Values;
+		FSavePackedArrayCodec::Decode(ByteArray, Values);
+		return Values;
+	}
+
+	/**
+	 * \brief Converts an array of FVectors to a packed byte array, to be saved as EDataType::VectorArrayType.
+	 * \param Values The vectors to convert.
+	 * \return The packed byte array.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts an array of FVectors to a packed byte array."))
+	static TArray<uint8> VectorArrayToByteArray(const TArray<FVector>& Values)
+	{
+		TArray<uint8> ByteArray;
+		FSavePackedArrayCodec::Encode(MakeArrayView(Values), ByteArray);
+		return ByteArray;
+	}
+
+	/**
+	 * \brief Converts a packed byte array to an array of FVectors.
+	 * \param ByteArray The packed byte array.
+	 * \return The vectors, or an empty array if the byte array does not hold packed vectors.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a packed byte array to an array of FVectors."))
+	static TArray<FVector> ByteArrayToVectorArray(const TArray<uint8>& ByteArray)
+	{
+		return ByteArrayToVectorArray(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it.
+	 */
+	static TArray<FVector> ByteArrayToVectorArray(TConstArrayView<uint8> ByteArray)
+	{
+		TArray<FVector> Values;
+		FSavePackedArrayCodec::Decode(ByteArray, Values);
+		return Values;
+	}
+
+	/**
+	 * \brief Converts an array of FTransforms to a packed byte array, to be saved as EDataType::TransformArrayType.
+	 * \param Values The transforms to convert.
+	 * \return The packed byte array.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts an array of FTransforms to a packed byte array."))
+	static TArray<uint8> TransformArrayToByteArray(const TArray<FTransform>& Values)
+	{
+		TArray<uint8> ByteArray;
+		FSavePackedArrayCodec::Encode(MakeArrayView(Values), ByteArray);
+		return ByteArray;
+	}
+
+	/**
+	 * \brief Converts a packed byte array to an array of FTransforms.
+	 * \param ByteArray The packed byte array.
+	 * \return The transforms, or an empty array if the byte array does not hold packed transforms.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SaveLoad", Meta = (ToolTip = "Converts a packed byte array to an array of FTransforms."))
+	static TArray<FTransform> ByteArrayToTransformArray(const TArray<uint8>& ByteArray)
+	{
+		return ByteArrayToTransformArray(MakeArrayView(ByteArray));
+	}
+
+	/**
+	 * \brief Same as the overload above, but reads from a view, such as one returned by LoadDataPinned, without copying it.
+	 */
+	static TArray<FTransform> ByteArrayToTransformArray(TConstArrayView<uint8> ByteArray)
+	{
+		TArray<FTransform> Values;
+		FSavePackedArrayCodec::Decode(ByteArray, Values);
+		return Values;
 	}
 	
 };
@@ -0,0 +1,1131 @@
+﻿#include "SavePageStore.h"
+#include "SaveFileFormat.h"
+#include "Hash/CityHash.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Algo/BinarySearch.h"
+#include <atomic>
+
+
+namespace
+{
+	/** \brief Pages written by every page store of the process. */
+	std::atomic<int64> TotalPagesWritten { 0 };
+
+	/** \brief The most bitmap pages a superblock can list, which bounds the file to about 128 GB. */
+	constexpr int32 MaxBitmapPages = (FSavePageStore::PageSize - 128) / sizeof(uint32);
+
+	/** \brief The deepest page table accepted when opening a store, far more than MAX_int32 logical pages need. */
+	constexpr int32 MaxTableDepth = 4;
+
+	/**
+	 * \brief The root of one generation of a page store, stored in physical page 0 or 1 depending on the parity of its generation.
+	 */
+	struct FSuperblock
+	{
+		uint32 Magic = FSavePageStore::MagicNumber;
+		uint16 Version = FSavePageStore::CurrentVersion;
+		uint16 Reserved = 0;
+		uint32 PageSize = FSavePageStore::PageSize;
+		uint64 Generation = 0;
+		int64 LogicalSize = 0;
+		uint32 TableRoot = 0;
+		uint64 TableHash = 0;
+		int32 TableDepth = 0;
+		int32 PhysicalPageCount = 0;
+		uint64 BitmapHash = 0;
+		TArray<uint32> BitmapPages;
+
+		/** \brief Serializes the fields, followed by a checksum of them. Returns false if a loaded checksum does not match. */
+		bool Serialize(FArchive& Ar, TArray<uint8>& Bytes)
+		{
+			Ar << Magic;
+			Ar << Version;
+			Ar << Reserved;
+			Ar << PageSize;
+			Ar << Generation;
+			Ar << LogicalSize;
+			Ar << TableRoot;
+			Ar << TableHash;
+			Ar << TableDepth;
+			Ar << PhysicalPageCount;
+			Ar << BitmapHash;
+
+			int32 BitmapPageCount = BitmapPages.Num();
+			Ar << BitmapPageCount;
+			if (BitmapPageCount < 0 || BitmapPageCount > MaxBitmapPages)
+			{
+				return false;
+			}
+
+			BitmapPages.SetNum(BitmapPageCount);
+			for (uint32& BitmapPage : BitmapPages)
+			{
+				Ar << BitmapPage;
+			}
+
+			const int64 ChecksumOffset = Ar.Tell();
+			uint64 Checksum = CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), static_cast<uint32>(ChecksumOffset));
+			const uint64 ExpectedChecksum = Checksum;
+			Ar << Checksum;
+
+			return !Ar.IsError() && Checksum == ExpectedChecksum;
+		}
+	};
+}
+
+FSavePageStore::~FSavePageStore() = default;
+
+bool FSavePageStore::IsPageStore(FArchive& Ar)
+{
+	if (Ar.TotalSize() < PageSize)
+	{
+		return false;
+	}
+
+	// Every superblock written to page 0 starts with the same magic number, so even a torn superblock keeps it
+	uint32 Magic = 0;
+	Ar.Seek(0);
+	Ar << Magic;
+	Ar.Seek(0);
+
+	return !Ar.IsError() && Magic == MagicNumber;
+}
+
+bool FSavePageStore::IsPageStore(const FString& FilePath)
+{
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*FilePath));
+	return Reader && IsPageStore(*Reader);
+}
+
+bool FSavePageStore::OpenRead(const FString& InFilePath)
+{
+	Reset();
+
+	// Writers are allowed alongside, they never touch the pages of the image this reader sees
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*InFilePath, true));
+	if (!FileHandle)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to load file: %s"), *InFilePath);
+		return false;
+	}
+
+	FilePath = InFilePath;
+	if (!ReadCurrentImage(false))
+	{
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FSavePageStore::OpenWrite(const FString& InFilePath)
+{
+	Reset();
+
+	// Opened without truncating the file, and for reading, so pages can be loaded and readers may stay open
+	FileHandle.Reset(FSaveFileFormat::OpenForUpdate(InFilePath, true));
+	if (!FileHandle)
+	{
+		return false;
+	}
+
+	FilePath = InFilePath;
+	bWritable = true;
+
+	if (FileHandle->Size() == 0)
+	{
+		InitEmptyPages();
+	}
+	else if (!ReadCurrentImage(true))
+	{
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FSavePageStore::Create(const FString& InFilePath)
+{
+	Reset();
+
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*InFilePath, false, true));
+	if (!FileHandle)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write file: %s"), *InFilePath);
+		return false;
+	}
+
+	FilePath = InFilePath;
+	bWritable = true;
+	InitEmptyPages();
+	return true;
+}
+
+bool FSavePageStore::Read(int64 Offset, void* Destination, int64 Length)
+{
+	if (!FileHandle || Offset < 0 || Length < 0 || Offset + Length > LogicalSize)
+	{
+		return false;
+	}
+
+	uint8* Bytes = static_cast<uint8*>(Destination);
+	while (Length > 0)
+	{
+		const int32 LogicalPage = static_cast<int32>(Offset / PageSize);
+		const int32 PageOffset = static_cast<int32>(Offset % PageSize);
+		int64 ChunkSize = FMath::Min<int64>(Length, PageSize - PageOffset);
+
+		FPageEntry Entry;
+		if (!DirtyPages.Contains(LogicalPage) && !GetPageEntry(LogicalPage, Entry))
+		{
+			return false;
+		}
+
+		if (const TArray<uint8>* DirtyPage = DirtyPages.Find(LogicalPage))
+		{
+			FMemory::Memcpy(Bytes, DirtyPage->GetData() + PageOffset, ChunkSize);
+		}
+		else if (Entry.PhysicalPage == 0)
+		{
+			FMemory::Memzero(Bytes, ChunkSize);
+		}
+		else if (ChunkSize == PageSize)
+		{
+			// Whole pages are read straight into the destination, in one read for as long as they follow each other in the file
+			const int32 MaxRunLength = static_cast<int32>(FMath::Min<int64>(Length / PageSize, MAX_int32 / PageSize));
+			int32 RunLength = 1;
+			FPageEntry NextEntry;
+			while (RunLength < MaxRunLength && !DirtyPages.Contains(LogicalPage + RunLength) && GetPageEntry(LogicalPage + RunLength, NextEntry)
+				&& NextEntry.PhysicalPage == Entry.PhysicalPage + RunLength)
+			{
+				++RunLength;
+			}
+
+			if (!ReadPhysical(Entry.PhysicalPage, Bytes, RunLength))
+			{
+				return false;
+			}
+
+			ChunkSize = static_cast<int64>(RunLength) * PageSize;
+		}
+		else
+		{
+			if (ReadCache.Num() != PageSize || ReadCachePage != Entry.PhysicalPage)
+			{
+				ReadCache.SetNumUninitialized(PageSize);
+				if (!ReadPhysical(Entry.PhysicalPage, ReadCache.GetData(), 1))
+				{
+					ReadCache.Reset();
+					return false;
+				}
+
+				ReadCachePage = Entry.PhysicalPage;
+			}
+
+			FMemory::Memcpy(Bytes, ReadCache.GetData() + PageOffset, ChunkSize);
+		}
+
+		Offset += ChunkSize;
+		Bytes += ChunkSize;
+		Length -= ChunkSize;
+	}
+
+	return true;
+}
+
+bool FSavePageStore::Write(int64 Offset, const void* Source, int64 Length)
+{
+	if (!bWritable || Offset < 0 || Length < 0)
+	{
+		return false;
+	}
+
+	if (Offset + Length > LogicalSize && !SetSize(Offset + Length))
+	{
+		return false;
+	}
+
+	const uint8* Bytes = static_cast<const uint8*>(Source);
+	while (Length > 0)
+	{
+		const int32 LogicalPage = static_cast<int32>(Offset / PageSize);
+		const int32 PageOffset = static_cast<int32>(Offset % PageSize);
+		const int32 ChunkSize = static_cast<int32>(FMath::Min<int64>(Length, PageSize - PageOffset));
+
+		TArray<uint8>* DirtyPage = GetDirtyPage(LogicalPage, ChunkSize == PageSize);
+		if (!DirtyPage)
+		{
+			return false;
+		}
+
+		FMemory::Memcpy(DirtyPage->GetData() + PageOffset, Bytes, ChunkSize);
+
+		Offset += ChunkSize;
+		Bytes += ChunkSize;
+		Length -= ChunkSize;
+	}
+
+	// Bound the memory held by large writes, the pages written out early are still private until the commit
+	return DirtyPages.Num() <= MaxBufferedPages || WriteDirtyPages();
+}
+
+bool FSavePageStore::SetSize(int64 NewSize)
+{
+	if (!bWritable)
+	{
+		return false;
+	}
+
+	NewSize = FMath::Clamp<int64>(NewSize, 0, static_cast<int64>(MAX_int32) * PageSize);
+	const int32 NewPageCount = static_cast<int32>(FMath::DivideAndRoundUp<int64>(NewSize, PageSize));
+
+	if (NewSize >= LogicalSize)
+	{
+		// New pages start as holes
+		LogicalSize = NewSize;
+		return true;
+	}
+
+	for (TMap<int32, FPageEntry>::TIterator It = ChangedPages.CreateIterator(); It; ++It)
+	{
+		if (It.Key() >= NewPageCount)
+		{
+			if (PrivatePages.Contains(It.Value().PhysicalPage))
+			{
+				ReleasePage(It.Value().PhysicalPage);
+			}
+
+			It.RemoveCurrent();
+		}
+	}
+
+	for (TMap<int32, TArray<uint8>>::TIterator It = DirtyPages.CreateIterator(); It; ++It)
+	{
+		if (It.Key() >= NewPageCount)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// Committed pages past the new end no longer show through, even if the image grows again
+	PreservedPageCount = FMath::Min(PreservedPageCount, NewPageCount);
+	LogicalSize = NewSize;
+
+	// The bytes past the end of the last page must read as zeros if the image grows again
+	const int32 TailOffset = static_cast<int32>(NewSize % PageSize);
+	if (TailOffset != 0)
+	{
+		TArray<uint8>* DirtyPage = GetDirtyPage(NewPageCount - 1, false);
+		if (!DirtyPage)
+		{
+			return false;
+		}
+
+		FMemory::Memzero(DirtyPage->GetData() + TailOffset, PageSize - TailOffset);
+	}
+
+	return true;
+}
+
+bool FSavePageStore::Commit()
+{
+	if (!bWritable || !WriteDirtyPages())
+	{
+		return false;
+	}
+
+	FTableUpdate Update;
+	Update.PageCount = static_cast<int32>(FMath::DivideAndRoundUp<int64>(LogicalSize, PageSize));
+	Update.CommittedPageCount = static_cast<int32>(FMath::DivideAndRoundUp<int64>(CommittedSize, PageSize));
+
+	// Nothing to publish if every modified page turned out unchanged, but a new store is committed empty so it can be opened
+	if (Generation > 0 && LogicalSize == CommittedSize && PreservedPageCount == Update.CommittedPageCount && ChangedPages.Num() == 0)
+	{
+		return true;
+	}
+
+	ChangedPages.GenerateKeyArray(Update.ChangedLogicalPages);
+	Update.ChangedLogicalPages.Sort();
+
+	// The table gets as deep as it takes for its root to cover every page
+	int32 NewDepth = Update.PageCount > 0 ? 1 : 0;
+	for (int64 Capacity = EntriesPerTablePage; Capacity < Update.PageCount; Capacity *= EntriesPerTablePage)
+	{
+		++NewDepth;
+	}
+
+	// A shrinking table drops its top levels, whose slots past the first only hold pages past the new end
+	Update.OldRoot = TableRoot;
+	Update.OldDepth = TableDepth;
+	while (Update.OldDepth > NewDepth && Update.OldRoot.PhysicalPage != 0)
+	{
+		if (NewDepth == 0)
+		{
+			if (!ReleaseTablePage(Update.OldDepth - 1, Update.OldRoot))
+			{
+				return false;
+			}
+
+			Update.OldRoot = FPageEntry();
+			break;
+		}
+
+		const TArray<FPageEntry>* RootEntries = ReadTablePage(Update.OldRoot);
+		if (!RootEntries)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted page store: %s"), *FilePath);
+			return false;
+		}
+
+		const TArray<FPageEntry> Entries = *RootEntries;
+		for (int32 Slot = 1; Slot < Entries.Num(); ++Slot)
+		{
+			if (!ReleaseTablePage(Update.OldDepth - 2, Entries[Slot]))
+			{
+				return false;
+			}
+		}
+
+		ReleasedPages.Add(Update.OldRoot.PhysicalPage);
+		Update.OldRoot = Entries[0];
+		--Update.OldDepth;
+	}
+
+	if (Update.OldRoot.PhysicalPage == 0)
+	{
+		Update.OldDepth = 0;
+	}
+
+	// Write the table pages above every remapped page to free pages, the committed ones stay valid until the superblock points away from them
+	FSuperblock Superblock;
+	Superblock.Generation = Generation + 1;
+	Superblock.LogicalSize = LogicalSize;
+	Superblock.TableDepth = NewDepth;
+
+	FPageEntry NewRoot;
+	const bool bAboveOldRoot = Update.OldDepth > 0 && NewDepth > Update.OldDepth;
+	if (NewDepth > 0 && !WriteTablePage(NewDepth - 1, 0, bAboveOldRoot ? FPageEntry() : Update.OldRoot, bAboveOldRoot, Update, NewRoot))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to write the page table of file: %s"), *FilePath);
+		return false;
+	}
+
+	Superblock.TableRoot = NewRoot.PhysicalPage;
+	Superblock.TableHash = NewRoot.Hash;
+
+	// The committed bitmap is replaced like every other page of the image
+	ReleasedPages.Append(BitmapPages);
+	if (!WriteBitmap(Superblock.BitmapPages, Superblock.BitmapHash))
+	{
+		return false;
+	}
+
+	Superblock.PhysicalPageCount = UsedPages.Num();
+
+	// Every page of the new image must be on disk before the superblock publishes it
+	if (!FileHandle->Flush(true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to flush file: %s"), *FilePath);
+		return false;
+	}
+
+	// The superblock of the previous generation is overwritten, the current one stays valid if this write is torn
+	TArray<uint8> SuperblockBytes;
+	FMemoryWriter SuperblockWriter(SuperblockBytes);
+	Superblock.Serialize(SuperblockWriter, SuperblockBytes);
+	SuperblockBytes.SetNumZeroed(PageSize);
+
+	const uint32 SuperblockPage = static_cast<uint32>((Superblock.Generation + 1) % 2);
+	if (!WritePhysical(SuperblockPage, SuperblockBytes.GetData(), 1) || !FileHandle->Flush(true))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to publish the page table of file: %s"), *FilePath);
+		return false;
+	}
+
+	Generation = Superblock.Generation;
+	CommittedSize = LogicalSize;
+	TableRoot = NewRoot;
+	TableDepth = NewDepth;
+	BitmapPages = Superblock.BitmapPages;
+	PreservedPageCount = Update.PageCount;
+	ChangedPages.Reset();
+	PrivatePages.Reset();
+
+	// The pages only the previous image used are free from now on
+	for (const uint32 ReleasedPage : ReleasedPages)
+	{
+		UsedPages[ReleasedPage] = false;
+		TablePages.Remove(ReleasedPage);
+	}
+
+	ReleasedPages.Reset();
+	FirstFreeCandidate = 2;
+	return true;
+}
+
+int64 FSavePageStore::GetTotalPagesWritten()
+{
+	return TotalPagesWritten.load();
+}
+
+void FSavePageStore::Reset()
+{
+	FileHandle.Reset();
+	FilePath.Reset();
+	bWritable = false;
+	Generation = 0;
+	CommittedSize = 0;
+	TableRoot = FPageEntry();
+	TableDepth = 0;
+	BitmapPages.Reset();
+	LogicalSize = 0;
+	PreservedPageCount = 0;
+	ChangedPages.Reset();
+	DirtyPages.Reset();
+	TablePages.Reset();
+	UsedPages.Empty();
+	PrivatePages.Reset();
+	ReleasedPages.Reset();
+	FirstFreeCandidate = 0;
+	ReadCache.Reset();
+	ReadCachePage = 0;
+}
+
+void FSavePageStore::InitEmptyPages()
+{
+	UsedPages.Init(false, 2);
+	UsedPages[0] = true;
+	UsedPages[1] = true;
+	FirstFreeCandidate = 2;
+}
+
+bool FSavePageStore::ReadCurrentImage(bool bLoadBitmap)
+{
+	const int64 PhysicalPageCount = FileHandle->Size() / PageSize;
+
+	// Parse both superblocks, a torn or never written one fails its checksum
+	TArray<FSuperblock, TInlineAllocator<2>> Candidates;
+	TArray<uint8> SuperblockBytes;
+	SuperblockBytes.SetNumUninitialized(PageSize);
+	for (uint32 SuperblockPage = 0; SuperblockPage < 2 && SuperblockPage < PhysicalPageCount; ++SuperblockPage)
+	{
+		if (!ReadPhysical(SuperblockPage, SuperblockBytes.GetData(), 1))
+		{
+			continue;
+		}
+
+		// The magic number and version lead every layout, so a store written by another version is refused as a whole before its layout is parsed. Taking the image of the
+		// other superblock instead would silently roll the file back
+		uint32 Magic = 0;
+		uint16 Version = 0;
+		FMemoryReader VersionReader(SuperblockBytes);
+		VersionReader << Magic;
+		VersionReader << Version;
+		if (Magic == MagicNumber && Version != CurrentVersion)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unsupported page store version %d: %s"), Version, *FilePath);
+			return false;
+		}
+
+		FSuperblock Superblock;
+		FMemoryReader SuperblockReader(SuperblockBytes);
+		if (Superblock.Serialize(SuperblockReader, SuperblockBytes) && Superblock.Magic == MagicNumber && Superblock.PageSize == PageSize
+			&& Superblock.LogicalSize >= 0 && Superblock.LogicalSize <= static_cast<int64>(MAX_int32) * PageSize
+			&& Superblock.TableDepth >= 0 && Superblock.TableDepth <= MaxTableDepth
+			&& Superblock.PhysicalPageCount >= 2 && Superblock.PhysicalPageCount <= PhysicalPageCount
+			&& Superblock.BitmapPages.Num() == FMath::DivideAndRoundUp(Superblock.PhysicalPageCount, PagesPerBitmapPage))
+		{
+			Candidates.Add(MoveTemp(Superblock));
+		}
+	}
+
+	// The newest generation wins, unless its page table or its bitmap is damaged
+	Candidates.Sort([](const FSuperblock& A, const FSuperblock& B) { return A.Generation > B.Generation; });
+	for (int32 CandidateIndex = 0; CandidateIndex < Candidates.Num(); ++CandidateIndex)
+	{
+		const FSuperblock& Superblock = Candidates[CandidateIndex];
+		const FPageEntry Root { Superblock.TableRoot, Superblock.TableHash };
+		const bool bValidRoot = Superblock.TableDepth == 0 ? Root.PhysicalPage == 0
+			: Root.PhysicalPage == 0 || (Root.PhysicalPage >= 2 && Root.PhysicalPage < static_cast<uint32>(Superblock.PhysicalPageCount) && ReadTablePage(Root));
+
+		if (!bValidRoot || (bLoadBitmap && !ReadBitmap(Superblock.BitmapPages, Superblock.PhysicalPageCount, Superblock.BitmapHash)))
+		{
+			// Table pages of a rejected image are not pages of the one finally taken
+			TablePages.Reset();
+			continue;
+		}
+
+		Generation = Superblock.Generation;
+		CommittedSize = Superblock.LogicalSize;
+		TableRoot = Root;
+		TableDepth = Superblock.TableDepth;
+		BitmapPages = Superblock.BitmapPages;
+		LogicalSize = CommittedSize;
+		PreservedPageCount = static_cast<int32>(FMath::DivideAndRoundUp<int64>(CommittedSize, PageSize));
+
+		// A newer image was published after this one, so commits since then may have reused the pages only this image used. It is only taken if none of them changed
+		if (CandidateIndex > 0)
+		{
+			if (!VerifyCommittedPages())
+			{
+				break;
+			}
+
+			UE_LOG(LogTemp, Warning, TEXT("Damaged page table in file, falling back to the previous image: %s"), *FilePath);
+		}
+
+		return true;
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("Corrupted page store: %s"), *FilePath);
+	return false;
+}
+
+bool FSavePageStore::VerifyCommittedPages()
+{
+	TArray<uint8> Bytes;
+	Bytes.SetNumUninitialized(PageSize);
+
+	const int32 CommittedPageCount = static_cast<int32>(FMath::DivideAndRoundUp<int64>(CommittedSize, PageSize));
+	for (int32 LogicalPage = 0; LogicalPage < CommittedPageCount; ++LogicalPage)
+	{
+		FPageEntry Entry;
+		if (!GetCommittedEntry(LogicalPage, Entry))
+		{
+			return false;
+		}
+
+		if (Entry.PhysicalPage != 0 && (!ReadPhysical(Entry.PhysicalPage, Bytes.GetData(), 1) || CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), PageSize) != Entry.Hash))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int64 FSavePageStore::GetTableSpan(int32 Level)
+{
+	int64 Span = 1;
+	for (int32 Index = 0; Index < Level; ++Index)
+	{
+		Span *= EntriesPerTablePage;
+	}
+
+	return Span;
+}
+
+const TArray<FSavePageStore::FPageEntry>* FSavePageStore::ReadTablePage(const FPageEntry& TablePage)
+{
+	if (const TArray<FPageEntry>* Entries = TablePages.Find(TablePage.PhysicalPage))
+	{
+		return Entries;
+	}
+
+	TArray<uint8> Bytes;
+	Bytes.SetNumUninitialized(PageSize);
+	if (!ReadPhysical(TablePage.PhysicalPage, Bytes.GetData(), 1) || CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), PageSize) != TablePage.Hash)
+	{
+		return nullptr;
+	}
+
+	const uint32 PhysicalPageCount = static_cast<uint32>(FMath::Min<int64>(FileHandle->Size() / PageSize, MAX_uint32));
+	TArray<FPageEntry> Entries;
+	Entries.SetNum(EntriesPerTablePage);
+	FMemoryReader TableReader(Bytes);
+	for (FPageEntry& Entry : Entries)
+	{
+		TableReader << Entry.PhysicalPage;
+		TableReader << Entry.Hash;
+
+		if (Entry.PhysicalPage == 1 || (Entry.PhysicalPage != 0 && Entry.PhysicalPage >= PhysicalPageCount))
+		{
+			return nullptr;
+		}
+	}
+
+	return &TablePages.Add(TablePage.PhysicalPage, MoveTemp(Entries));
+}
+
+bool FSavePageStore::GetCommittedEntry(int32 LogicalPage, FPageEntry& OutEntry)
+{
+	OutEntry = FPageEntry();
+	if (LogicalPage >= FMath::DivideAndRoundUp<int64>(CommittedSize, PageSize))
+	{
+		return true;
+	}
+
+	// Walk down from the root, a hole at any level is a hole for every page below it
+	FPageEntry Entry = TableRoot;
+	for (int32 Level = TableDepth - 1; Level >= 0 && Entry.PhysicalPage != 0; --Level)
+	{
+		const TArray<FPageEntry>* Entries = ReadTablePage(Entry);
+		if (!Entries)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted page table in file: %s"), *FilePath);
+			return false;
+		}
+
+		Entry = (*Entries)[static_cast<int32>((LogicalPage / GetTableSpan(Level)) % EntriesPerTablePage)];
+	}
+
+	OutEntry = Entry;
+	return true;
+}
+
+bool FSavePageStore::GetPageEntry(int32 LogicalPage, FPageEntry& OutEntry)
+{
+	if (const FPageEntry* ChangedPage = ChangedPages.Find(LogicalPage))
+	{
+		OutEntry = *ChangedPage;
+		return true;
+	}
+
+	if (LogicalPage >= PreservedPageCount)
+	{
+		OutEntry = FPageEntry();
+		return true;
+	}
+
+	return GetCommittedEntry(LogicalPage, OutEntry);
+}
+
+bool FSavePageStore::IsRangeModified(int64 FirstPage, int64 EndPage, const FTableUpdate& Update) const
+{
+	const int32 ChangedIndex = Algo::LowerBound(Update.ChangedLogicalPages, FirstPage);
+	if (ChangedIndex < Update.ChangedLogicalPages.Num() && Update.ChangedLogicalPages[ChangedIndex] < EndPage)
+	{
+		return true;
+	}
+
+	return FirstPage < Update.CommittedPageCount && EndPage > PreservedPageCount;
+}
+
+bool FSavePageStore::WriteTablePage(int32 Level, int64 FirstPage, const FPageEntry& OldTablePage, bool bAboveOldRoot, const FTableUpdate& Update, FPageEntry& OutTablePage)
+{
+	const int64 SlotSpan = GetTableSpan(Level);
+
+	// Table pages above nothing that changed are kept as they are
+	if (!bAboveOldRoot && !IsRangeModified(FirstPage, FirstPage + SlotSpan * EntriesPerTablePage, Update))
+	{
+		OutTablePage = OldTablePage;
+		return true;
+	}
+
+	TArray<FPageEntry> OldEntries;
+	if (OldTablePage.PhysicalPage != 0)
+	{
+		const TArray<FPageEntry>* CommittedEntries = ReadTablePage(OldTablePage);
+		if (!CommittedEntries)
+		{
+			return false;
+		}
+
+		OldEntries = *CommittedEntries;
+	}
+	else
+	{
+		OldEntries.SetNum(EntriesPerTablePage);
+	}
+
+	TArray<FPageEntry> Entries = OldEntries;
+	for (int32 Slot = 0; Slot < EntriesPerTablePage; ++Slot)
+	{
+		const int64 SlotFirstPage = FirstPage + Slot * SlotSpan;
+		const FPageEntry OldEntry = Entries[Slot];
+
+		if (bAboveOldRoot && Slot == 0)
+		{
+			// The first slot leads down to the committed root, through more new table pages if the table grew by several levels
+			const bool bChildAboveOldRoot = Level - 1 >= Update.OldDepth;
+			if (!WriteTablePage(Level - 1, SlotFirstPage, bChildAboveOldRoot ? FPageEntry() : Update.OldRoot, bChildAboveOldRoot, Update, Entries[Slot]))
+			{
+				return false;
+			}
+		}
+		else if (SlotFirstPage >= Update.PageCount)
+		{
+			if (!ReleaseTablePage(Level - 1, OldEntry))
+			{
+				return false;
+			}
+
+			Entries[Slot] = FPageEntry();
+		}
+		else if (Level > 0)
+		{
+			if (!WriteTablePage(Level - 1, SlotFirstPage, OldEntry, false, Update, Entries[Slot]))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			// Remapped pages take their new place, committed pages past the preserved ones become holes
+			const int32 LogicalPage = static_cast<int32>(SlotFirstPage);
+			const FPageEntry* ChangedPage = ChangedPages.Find(LogicalPage);
+			Entries[Slot] = ChangedPage ? *ChangedPage : LogicalPage < PreservedPageCount ? OldEntry : FPageEntry();
+
+			if (OldEntry.PhysicalPage != 0 && OldEntry.PhysicalPage != Entries[Slot].PhysicalPage)
+			{
+				ReleasedPages.Add(OldEntry.PhysicalPage);
+			}
+		}
+	}
+
+	if (OldTablePage.PhysicalPage != 0 && Entries == OldEntries)
+	{
+		OutTablePage = OldTablePage;
+		return true;
+	}
+
+	if (OldTablePage.PhysicalPage != 0)
+	{
+		ReleasedPages.Add(OldTablePage.PhysicalPage);
+	}
+
+	// A table page of holes is a hole itself
+	if (!Entries.ContainsByPredicate([](const FPageEntry& Entry) { return Entry.PhysicalPage != 0; }))
+	{
+		OutTablePage = FPageEntry();
+		return true;
+	}
+
+	TArray<uint8> Bytes;
+	FMemoryWriter TableWriter(Bytes);
+	for (FPageEntry& Entry : Entries)
+	{
+		TableWriter << Entry.PhysicalPage;
+		TableWriter << Entry.Hash;
+	}
+
+	Bytes.SetNumZeroed(PageSize);
+	OutTablePage.PhysicalPage = AllocatePage();
+	OutTablePage.Hash = CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), PageSize);
+	return WritePhysical(OutTablePage.PhysicalPage, Bytes.GetData(), 1);
+}
+
+bool FSavePageStore::ReleaseTablePage(int32 Level, const FPageEntry& TablePage)
+{
+	if (TablePage.PhysicalPage == 0)
+	{
+		return true;
+	}
+
+	if (Level >= 0)
+	{
+		const TArray<FPageEntry>* CommittedEntries = ReadTablePage(TablePage);
+		if (!CommittedEntries)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Corrupted page table in file: %s"), *FilePath);
+			return false;
+		}
+
+		const TArray<FPageEntry> Entries = *CommittedEntries;
+		for (const FPageEntry& Entry : Entries)
+		{
+			if (!ReleaseTablePage(Level - 1, Entry))
+			{
+				return false;
+			}
+		}
+	}
+
+	ReleasedPages.Add(TablePage.PhysicalPage);
+	return true;
+}
+
+bool FSavePageStore::ReadBitmap(const TArray<uint32>& InBitmapPages, int32 PhysicalPageCount, uint64 BitmapHash)
+{
+	TArray<uint8> Bytes;
+	Bytes.SetNumUninitialized(InBitmapPages.Num() * PageSize);
+	for (int32 Index = 0; Index < InBitmapPages.Num(); ++Index)
+	{
+		if (InBitmapPages[Index] < 2 || InBitmapPages[Index] >= static_cast<uint32>(PhysicalPageCount) || !ReadPhysical(InBitmapPages[Index], Bytes.GetData() + Index * PageSize, 1))
+		{
+			return false;
+		}
+	}
+
+	if (CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), static_cast<uint32>(Bytes.Num())) != BitmapHash)
+	{
+		return false;
+	}
+
+	UsedPages.Init(false, PhysicalPageCount);
+	for (int32 PhysicalPage = 0; PhysicalPage < PhysicalPageCount; ++PhysicalPage)
+	{
+		UsedPages[PhysicalPage] = (Bytes[PhysicalPage / 8] & (1 << (PhysicalPage % 8))) != 0;
+	}
+
+	UsedPages[0] = true;
+	UsedPages[1] = true;
+	FirstFreeCandidate = 2;
+	return true;
+}
+
+bool FSavePageStore::WriteBitmap(TArray<uint32>& OutBitmapPages, uint64& OutBitmapHash)
+{
+	// The bitmap pages are pages of the image they describe, so they are taken before the bits are gathered
+	OutBitmapPages.Reset();
+	while (static_cast<int64>(OutBitmapPages.Num()) * PagesPerBitmapPage < UsedPages.Num())
+	{
+		OutBitmapPages.Add(AllocatePage());
+	}
+
+	if (OutBitmapPages.Num() > MaxBitmapPages)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Page store too large: %s"), *FilePath);
+		return false;
+	}
+
+	// Pages dropped by the new image are free in its bitmap, though they stay in use until it is committed
+	TArray<uint8> Bytes;
+	Bytes.SetNumZeroed(OutBitmapPages.Num() * PageSize);
+	for (TConstSetBitIterator<> It(UsedPages); It; ++It)
+	{
+		Bytes[It.GetIndex() / 8] |= 1 << (It.GetIndex() % 8);
+	}
+
+	for (const uint32 ReleasedPage : ReleasedPages)
+	{
+		Bytes[ReleasedPage / 8] &= ~(1 << (ReleasedPage % 8));
+	}
+
+	OutBitmapHash = CityHash64(reinterpret_cast<const char*>(Bytes.GetData()), static_cast<uint32>(Bytes.Num()));
+	for (int32 Index = 0; Index < OutBitmapPages.Num(); ++Index)
+	{
+		if (!WritePhysical(OutBitmapPages[Index], Bytes.GetData() + Index * PageSize, 1))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to write the page bitmap of file: %s"), *FilePath);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint32 FSavePageStore::AllocatePage()
+{
+	int32 PhysicalPage = UsedPages.FindAndSetFirstZeroBit(FirstFreeCandidate);
+	if (PhysicalPage == INDEX_NONE)
+	{
+		PhysicalPage = UsedPages.Add(true);
+	}
+
+	FirstFreeCandidate = PhysicalPage + 1;
+	return static_cast<uint32>(PhysicalPage);
+}
+
+void FSavePageStore::ReleasePage(uint32 PhysicalPage)
+{
+	UsedPages[PhysicalPage] = false;
+	PrivatePages.Remove(PhysicalPage);
+	FirstFreeCandidate = FMath::Min(FirstFreeCandidate, static_cast<int32>(PhysicalPage));
+}
+
+TArray<uint8>* FSavePageStore::GetDirtyPage(int32 LogicalPage, bool bOverwriteAll)
+{
+	if (TArray<uint8>* DirtyPage = DirtyPages.Find(LogicalPage))
+	{
+		return DirtyPage;
+	}
+
+	FPageEntry Entry;
+	if (!bOverwriteAll && !GetPageEntry(LogicalPage, Entry))
+	{
+		return nullptr;
+	}
+
+	TArray<uint8>& DirtyPage = DirtyPages.Add(LogicalPage);
+
+	if (bOverwriteAll)
+	{
+		DirtyPage.SetNumUninitialized(PageSize);
+	}
+	else if (Entry.PhysicalPage == 0)
+	{
+		DirtyPage.SetNumZeroed(PageSize);
+	}
+	else
+	{
+		DirtyPage.SetNumUninitialized(PageSize);
+		if (!ReadPhysical(Entry.PhysicalPage, DirtyPage.GetData(), 1))
+		{
+			DirtyPages.Remove(LogicalPage);
+			return nullptr;
+		}
+	}
+
+	return &DirtyPage;
+}
+
+bool FSavePageStore::WriteDirtyPages()
+{
+	// Written in page order, so new pages land in the file in the order they are read back
+	DirtyPages.KeySort(TLess<int32>());
+
+	TArray<uint8> CommittedPage;
+	for (const TPair<int32, TArray<uint8>>& Pair : DirtyPages)
+	{
+		const int32 LogicalPage = Pair.Key;
+		const uint64 Hash = CityHash64(reinterpret_cast<const char*>(Pair.Value.GetData()), PageSize);
+
+		FPageEntry Entry;
+		FPageEntry CommittedEntry;
+		if (!GetPageEntry(LogicalPage, Entry) || !GetCommittedEntry(LogicalPage, CommittedEntry))
+		{
+			return false;
+		}
+
+		// A page that ends up as it is in the committed image is not written again, the hash only picks which pages are worth comparing
+		if (CommittedEntry.PhysicalPage != 0 && CommittedEntry.Hash == Hash)
+		{
+			CommittedPage.SetNumUninitialized(PageSize);
+			if (!ReadPhysical(CommittedEntry.PhysicalPage, CommittedPage.GetData(), 1))
+			{
+				return false;
+			}
+
+			if (FMemory::Memcmp(CommittedPage.GetData(), Pair.Value.GetData(), PageSize) == 0)
+			{
+				if (PrivatePages.Contains(Entry.PhysicalPage))
+				{
+					ReleasePage(Entry.PhysicalPage);
+				}
+
+				// Past the preserved pages the committed page no longer shows through by itself, so it is mapped back explicitly
+				if (LogicalPage < PreservedPageCount)
+				{
+					ChangedPages.Remove(LogicalPage);
+				}
+				else
+				{
+					ChangedPages.Add(LogicalPage, CommittedEntry);
+				}
+
+				continue;
+			}
+		}
+
+		// Pages of the committed image are never overwritten, pages allocated since the last commit are
+		uint32 PhysicalPage = Entry.PhysicalPage;
+		if (!PrivatePages.Contains(PhysicalPage))
+		{
+			PhysicalPage = AllocatePage();
+			PrivatePages.Add(PhysicalPage);
+		}
+
+		if (!WritePhysical(PhysicalPage, Pair.Value.GetData(), 1))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Failed to write a page of file: %s"), *FilePath);
+			return false;
+		}
+
+		ChangedPages.Add(LogicalPage, FPageEntry { PhysicalPage, Hash });
+	}
+
+	DirtyPages.Reset();
+	return true;
+}
+
+bool FSavePageStore::ReadPhysical(uint32 PhysicalPage, uint8* Destination, int32 PageCount)
+{
+	return FileHandle->Seek(static_cast<int64>(PhysicalPage) * PageSize) && FileHandle->Read(Destination, static_cast<int64>(PageCount) * PageSize);
+}
+
+bool FSavePageStore::WritePhysical(uint32 PhysicalPage, const uint8* Source, int32 PageCount)
+{
+	if (ReadCachePage >= PhysicalPage && ReadCachePage < PhysicalPage + PageCount)
+	{
+		ReadCache.Reset();
+	}
+
+	TotalPagesWritten += PageCount;
+	return FileHandle->Seek(static_cast<int64>(PhysicalPage) * PageSize) && FileHandle->Write(Source, static_cast<int64>(PageCount) * PageSize);
+}
+
+FSavePageStoreReader::FSavePageStoreReader(TUniquePtr<FSavePageStore> InStore, const FString& InFilePath)
+	: Store(MoveTemp(InStore))
+	, FilePath(InFilePath)
+{
+	SetIsLoading(true);
+	SetIsPersistent(true);
+}
+
+void FSavePageStoreReader::Serialize(void* Data, int64 Num)
+{
+	if (Num <= 0)
+	{
+		return;
+	}
+
+	if (!Store || IsError() || !Store->Read(Pos, Data, Num))
+	{
+		FMemory::Memzero(Data, Num);
+		SetError();
+		return;
+	}
+
+	Pos += Num;
+}
+
+bool FSavePageStoreReader::Close()
+{
+	Store.Reset();
+	return !IsError();
+}
+
+FSavePageStoreWriter::FSavePageStoreWriter(TUniquePtr<FSavePageStore> InStore, const FString& InFilePath)
+	: Store(MoveTemp(InStore))
+	, FilePath(InFilePath)
+{
+	SetIsSaving(true);
+	SetIsPersistent(true);
+
+	// The image is written from scratch, pages that come out the same are matched against the committed image by the store
+	if (!Store || !Store->SetSize(0))
+	{
+		SetError();
+	}
+}
+
+void FSavePageStoreWriter::Serialize(void* Data, int64 Num)
+{
+	if (Num <= 0)
+	{
+		return;
+	}
+
+	if (!Store || IsError() || !Store->Write(Pos, Data, Num))
+	{
+		SetError();
+		return;
+	}
+
+	Pos += Num;
+	Size = FMath::Max(Size, Pos);
+}
+
+bool FSavePageStoreWriter::Close()
+{
+	if (!Store)
+	{
+		return !IsError();
+	}
+
+	const bool bCommitted = !IsError() && Store->SetSize(Size) && Store->Commit();
+	Store.Reset();
+
+	if (!bCommitted)
+	{
+		SetError();
+	}
+
+	return bCommitted;
+}
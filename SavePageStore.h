@@ -0,0 +1,284 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+#include "Templates/UniquePtr.h"
+
+class IFileHandle;
+
+
+/**
+ * \class FSavePageStore
+ * \brief A copy-on-write block store that keeps the bytes of a save file in fixed-size pages, placed through a page table.
+ *
+ * The store holds one logical byte image, an indexed save file or a B+tree, cut into pages of PageSize bytes. The page table maps every logical page to the physical page of the
+ * file that holds it, along with a hash of its content. It is a tree of table pages, EntriesPerTablePage entries each, whose inner entries hold the hash of the table page they
+ * point at. The first two physical pages are superblocks, each pointing at the root of a page table and at a bitmap of the physical pages in use, and tagged with a generation.
+ *
+ * Writes never touch a page referenced by the current image. Modified pages go to free pages, and Commit publishes them by writing the table pages above them, a new bitmap,
+ * then the older of the two superblocks. A crash before the superblock is written leaves the previous image intact, and a torn superblock fails its checksum, so opening always
+ * finds a complete image. Pages whose content did not change are never written, and table pages are only loaded when a lookup goes through them, so the cost of opening the
+ * store and of a commit follows the pages that are read and changed rather than the size of the file.
+ *
+ * Freed pages are reused by later commits, so the file holds at most the current image, the pages of the previous image and their page tables and bitmaps.
+ */
+class FSavePageStore
+{
+public:
+
+	/** \brief Magic number identifying a page store ('SLPS' on disk). Its first byte is neither a valid EDataType nor the first byte of an indexed save file. */
+	static constexpr uint32 MagicNumber = 0x53504C53;
+
+	/** \brief The current version of the page store layout. */
+	static constexpr uint16 CurrentVersion = 1;
+
+	/** \brief The size of a page in bytes. */
+	static constexpr int32 PageSize = 4096;
+
+	/** \brief The number of modified pages held in memory before they are written out to free pages, ahead of the commit that publishes them. */
+	static constexpr int32 MaxBufferedPages = 256;
+
+	FSavePageStore() = default;
+	~FSavePageStore();
+
+	FSavePageStore(const FSavePageStore&) = delete;
+	FSavePageStore& operator=(const FSavePageStore&) = delete;
+
+	/**
+	 * \brief Returns true if the archive starts like a page store. The archive is left at its start.
+	 */
+	static bool IsPageStore(FArchive& Ar);
+
+	/**
+	 * \brief Returns true if the file is a page store.
+	 */
+	static bool IsPageStore(const FString& FilePath);
+
+	/**
+	 * \brief Opens an existing page store for reading. Other handles may keep writing to the file, readers keep seeing the image that was current when they opened it.
+	 * \return True if the store was opened and its current image is valid.
+	 */
+	bool OpenRead(const FString& FilePath);
+
+	/**
+	 * \brief Opens a page store for reading and writing. A missing or empty file is opened as an empty store.
+	 *
+	 * Pages are written at their own positions, so this requires FSaveFileFormat::CanUpdateInPlace. Other platforms only write page stores through Create and a move.
+	 *
+	 * \return True if the store was opened. Fails if the file exists and is not a page store, or if files cannot be updated in place on this platform.
+	 */
+	bool OpenWrite(const FString& FilePath);
+
+	/**
+	 * \brief Creates an empty page store, replacing any file at the path.
+	 * \return True if the file was created.
+	 */
+	bool Create(const FString& FilePath);
+
+	/** \brief Returns the size of the stored image in bytes, including uncommitted writes. */
+	int64 GetSize() const { return LogicalSize; }
+
+	/**
+	 * \brief Reads bytes of the stored image, including uncommitted writes.
+	 * \return False if the range lies outside the image or the file could not be read.
+	 */
+	bool Read(int64 Offset, void* Destination, int64 Length);
+
+	/**
+	 * \brief Writes bytes of the image. The image grows as needed. Nothing is visible to other handles until Commit.
+	 * \return False if the store was opened for reading or modified pages could not be written out.
+	 */
+	bool Write(int64 Offset, const void* Source, int64 Length);
+
+	/**
+	 * \brief Truncates or extends the image. Bytes added by extending it read as zeros.
+	 * \return False if the store was opened for reading or the new last page could not be read.
+	 */
+	bool SetSize(int64 NewSize);
+
+	/**
+	 * \brief Publishes the modified pages: writes the pages that changed, then a new page table, then the superblock pointing at it, flushing the file in between.
+	 * \return True if the new image is committed. On failure the previous image stays current and the store must not be written to anymore.
+	 */
+	bool Commit();
+
+	/** \brief Returns the number of pages written by every page store of the process, page tables and superblocks included. */
+	static int64 GetTotalPagesWritten();
+
+private:
+
+	/** \brief The number of entries in a page of the page table. */
+	static constexpr int32 EntriesPerTablePage = PageSize / (sizeof(uint32) + sizeof(uint64));
+
+	/** \brief The number of physical pages tracked by a page of the free page bitmap. */
+	static constexpr int32 PagesPerBitmapPage = PageSize * 8;
+
+	/** \brief Where a logical page or a table page is stored. A physical page of 0 is a hole that reads as zeros, the superblock in that page is never part of an image. */
+	struct FPageEntry
+	{
+		uint32 PhysicalPage = 0;
+		uint64 Hash = 0;
+
+		bool operator==(const FPageEntry& Other) const { return PhysicalPage == Other.PhysicalPage && Hash == Other.Hash; }
+	};
+
+	/** \brief What a commit changes in the page table: the sizes of the old and new images, the old root and the remapped logical pages in order. */
+	struct FTableUpdate
+	{
+		int32 PageCount = 0;
+		int32 CommittedPageCount = 0;
+		FPageEntry OldRoot;
+		int32 OldDepth = 0;
+		TArray<int32> ChangedLogicalPages;
+	};
+
+	/** \brief Releases the handle and resets the store to an empty, closed state. */
+	void Reset();
+
+	/** \brief Marks the superblocks as the only used pages, for a store without a committed image. */
+	void InitEmptyPages();
+
+	/**
+	 * \brief Reads both superblocks and takes the newest valid image. Writers also load its bitmap of used pages. The older image is only taken when every one of its data
+	 * pages still matches its hash, since the pages only it used may have been reused since.
+	 */
+	bool ReadCurrentImage(bool bLoadBitmap);
+
+	/** \brief Reads every data page of the committed image and checks it against the hash in its page table. */
+	bool VerifyCommittedPages();
+
+	/** \brief Returns the number of logical pages covered by one entry of a table page at a level, level 0 pointing at data pages. */
+	static int64 GetTableSpan(int32 Level);
+
+	/** \brief Returns the entries of a committed table page, reading and checking it against its hash on first use. Null if it could not be read or is damaged. */
+	const TArray<FPageEntry>* ReadTablePage(const FPageEntry& TablePage);
+
+	/** \brief Looks up where the committed image stores a logical page. */
+	bool GetCommittedEntry(int32 LogicalPage, FPageEntry& OutEntry);
+
+	/** \brief Looks up where the image being written stores a logical page. */
+	bool GetPageEntry(int32 LogicalPage, FPageEntry& OutEntry);
+
+	/** \brief Returns true if a range of logical pages holds a remapped page, or a committed page the new image drops. */
+	bool IsRangeModified(int64 FirstPage, int64 EndPage, const FTableUpdate& Update) const;
+
+	/**
+	 * \brief Writes the new version of a table page and of the table pages below it that changed, copying each to a free page.
+	 * \param bAboveOldRoot True for the table pages added above the committed root when the table grows, whose first slot leads down to it.
+	 */
+	bool WriteTablePage(int32 Level, int64 FirstPage, const FPageEntry& OldTablePage, bool bAboveOldRoot, const FTableUpdate& Update, FPageEntry& OutTablePage);
+
+	/** \brief Releases a committed table page and everything below it at the next commit. Level -1 releases a single data page. */
+	bool ReleaseTablePage(int32 Level, const FPageEntry& TablePage);
+
+	/** \brief Loads the bitmap of used pages of the committed image, checking it against its hash. */
+	bool ReadBitmap(const TArray<uint32>& InBitmapPages, int32 PhysicalPageCount, uint64 BitmapHash);
+
+	/** \brief Writes the bitmap of the pages the new image uses to free pages. */
+	bool WriteBitmap(TArray<uint32>& OutBitmapPages, uint64& OutBitmapHash);
+
+	/** \brief Takes the first free physical page, growing the file if there is none. */
+	uint32 AllocatePage();
+
+	/** \brief Returns a page allocated since the last commit to the free pages. */
+	void ReleasePage(uint32 PhysicalPage);
+
+	/** \brief Returns the in-memory buffer of a logical page, loading its current content first unless it is about to be overwritten as a whole. Null if it could not be read. */
+	TArray<uint8>* GetDirtyPage(int32 LogicalPage, bool bOverwriteAll);
+
+	/** \brief Writes the buffered pages out to free pages, or drops them when their content matches the committed image. */
+	bool WriteDirtyPages();
+
+	/** \brief Reads one or more physical pages. */
+	bool ReadPhysical(uint32 PhysicalPage, uint8* Destination, int32 PageCount);
+
+	/** \brief Writes one or more physical pages. */
+	bool WritePhysical(uint32 PhysicalPage, const uint8* Source, int32 PageCount);
+
+	TUniquePtr<IFileHandle> FileHandle;
+	FString FilePath;
+	bool bWritable = false;
+
+	/** \brief The committed image: its generation, size, the root and depth of its page table, and where its bitmap of used pages is stored. */
+	uint64 Generation = 0;
+	int64 CommittedSize = 0;
+	FPageEntry TableRoot;
+	int32 TableDepth = 0;
+	TArray<uint32> BitmapPages;
+
+	/**
+	 * \brief The image being written: its size, how many of its leading pages are still those of the committed image, the pages remapped since the last commit and the
+	 * modified pages not written out yet.
+	 */
+	int64 LogicalSize = 0;
+	int32 PreservedPageCount = 0;
+	TMap<int32, FPageEntry> ChangedPages;
+	TMap<int32, TArray<uint8>> DirtyPages;
+
+	/** \brief The table pages of the committed image read so far, by physical page. */
+	TMap<uint32, TArray<FPageEntry>> TablePages;
+
+	/**
+	 * \brief The physical pages in use by the committed image or allocated since the last commit, and where to start looking for a free one. Pages allocated for logical
+	 * pages since the last commit can be overwritten in place, committed pages dropped by the image being written only become free once it is committed.
+	 */
+	TBitArray<> UsedPages;
+	TSet<uint32> PrivatePages;
+	TArray<uint32> ReleasedPages;
+	int32 FirstFreeCandidate = 0;
+
+	/** \brief The last physical page read, so small sequential reads do not each go to the file. */
+	TArray<uint8> ReadCache;
+	uint32 ReadCachePage = 0;
+};
+
+/**
+ * \class FSavePageStoreReader
+ * \brief An archive reading the image of a page store, so the indexed format can be read from it like from a plain file.
+ */
+class FSavePageStoreReader : public FArchive
+{
+public:
+
+	FSavePageStoreReader(TUniquePtr<FSavePageStore> InStore, const FString& InFilePath);
+
+	virtual void Serialize(void* Data, int64 Num) override;
+	virtual void Seek(int64 InPos) override { Pos = InPos; }
+	virtual int64 Tell() override { return Pos; }
+	virtual int64 TotalSize() override { return Store ? Store->GetSize() : 0; }
+	virtual bool Close() override;
+	virtual FString GetArchiveName() const override { return FilePath; }
+
+private:
+
+	TUniquePtr<FSavePageStore> Store;
+	FString FilePath;
+	int64 Pos = 0;
+};
+
+/**
+ * \class FSavePageStoreWriter
+ * \brief An archive replacing the image of a page store, so the indexed format can be written to it like to a plain file.
+ *
+ * The image is replaced as a whole and committed by Close. Destroying the writer without closing it, or after an error, leaves the previous image in place.
+ */
+class FSavePageStoreWriter : public FArchive
+{
+public:
+
+	FSavePageStoreWriter(TUniquePtr<FSavePageStore> InStore, const FString& InFilePath);
+
+	virtual void Serialize(void* Data, int64 Num) override;
+	virtual void Seek(int64 InPos) override { Pos = InPos; }
+	virtual int64 Tell() override { return Pos; }
+	virtual int64 TotalSize() override { return Size; }
+	virtual bool Close() override;
+	virtual FString GetArchiveName() const override { return FilePath; }
+
+private:
+
+	TUniquePtr<FSavePageStore> Store;
+	FString FilePath;
+	int64 Pos = 0;
+	int64 Size = 0;
+};
@@ -0,0 +1,347 @@
+﻿#include "SaveSpatialCodec.h"
+#include "SaveCodec.h"
+#include "Math/Float16.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+
+namespace
+{
+	/** \brief Bits per component of a quantized quaternion, the remaining 2 bits hold the index of the dropped component. */
+	constexpr int32 QuaternionComponentBits = 10;
+	constexpr uint32 QuaternionComponentMask = (1u << QuaternionComponentBits) - 1;
+
+	/** \brief The three smallest components of a unit quaternion lie within [-1/sqrt(2), 1/sqrt(2)]. */
+	constexpr double QuaternionComponentRange = 0.70710678118654752;
+
+	/**
+	 * \brief Appends fixed-width components to a compact payload.
+	 */
+	struct FCompactWriter
+	{
+		TArray<uint8>& Bytes;
+
+		template <typename ValueType>
+		void Write(ValueType Value)
+		{
+			const int32 Offset = Bytes.AddUninitialized(FSaveFixedWidthCodec::GetSize<ValueType>());
+			FSaveFixedWidthCodec::Encode(Value, MakeArrayView(Bytes).RightChop(Offset));
+		}
+
+		void WriteReal(double Value, bool bHalf)
+		{
+			if (bHalf)
+			{
+				Write<uint16>(FFloat16(static_cast<float>(Value)).Encoded);
+			}
+			else
+			{
+				Write<float>(static_cast<float>(Value));
+			}
+		}
+
+		void WriteVector(const FVector& Value, bool bHalf)
+		{
+			WriteReal(Value.X, bHalf);
+			WriteReal(Value.Y, bHalf);
+			WriteReal(Value.Z, bHalf);
+		}
+
+		void WriteQuaternion(const FQuat& Value, bool bHalf)
+		{
+			WriteReal(Value.X, bHalf);
+			WriteReal(Value.Y, bHalf);
+			WriteReal(Value.Z, bHalf);
+			WriteReal(Value.W, bHalf);
+		}
+	};
+
+	/**
+	 * \brief Reads fixed-width components from a compact payload. Reading past the end sets bError and returns zeros.
+	 */
+	struct FCompactReader
+	{
+		TConstArrayView<uint8> Bytes;
+		int32 Offset = 0;
+		bool bError = false;
+
+		template <typename ValueType>
+		ValueType Read()
+		{
+			ValueType Value = 0;
+			bError |= !FSaveFixedWidthCodec::Decode(Bytes.RightChop(Offset), Value);
+			Offset += FSaveFixedWidthCodec::GetSize<ValueType>();
+			return Value;
+		}
+
+		double ReadReal(bool bHalf)
+		{
+			if (bHalf)
+			{
+				FFloat16 Value;
+				Value.Encoded = Read<uint16>();
+				return Value.GetFloat();
+			}
+
+			return Read<float>();
+		}
+
+		FVector ReadVector(bool bHalf)
+		{
+			const double X = ReadReal(bHalf);
+			const double Y = ReadReal(bHalf);
+			const double Z = ReadReal(bHalf);
+			return FVector(X, Y, Z);
+		}
+
+		FQuat ReadQuaternion(bool bHalf)
+		{
+			const double X = ReadReal(bHalf);
+			const double Y = ReadReal(bHalf);
+			const double Z = ReadReal(bHalf);
+			const double W = ReadReal(bHalf);
+			FQuat Value(X, Y, Z, W);
+			Value.Normalize();
+			return Value;
+		}
+
+		/** \brief Returns true if every byte was read and nothing more. */
+		bool IsComplete() const { return !bError && Offset == Bytes.Num(); }
+
+		/** \brief Reads the leading encoding of a compact payload. Returns false if it is not a compact encoding. */
+		bool ReadEncoding(ESaveSpatialEncoding& OutEncoding)
+		{
+			OutEncoding = static_cast<ESaveSpatialEncoding>(Read<uint8>());
+			return !bError && OutEncoding != ESaveSpatialEncoding::FileDefault && OutEncoding != ESaveSpatialEncoding::Archive && OutEncoding <= ESaveSpatialEncoding::Quantized;
+		}
+
+		FVector ReadVectorValue(ESaveSpatialEncoding Encoding)
+		{
+			return ReadVector(Encoding == ESaveSpatialEncoding::Half);
+		}
+
+		FRotator ReadRotatorValue(ESaveSpatialEncoding Encoding)
+		{
+			if (Encoding == ESaveSpatialEncoding::Quantized)
+			{
+				return FSaveSpatialCodec::UnpackQuaternion(Read<uint32>()).Rotator();
+			}
+
+			const bool bHalf = Encoding == ESaveSpatialEncoding::Half;
+			FRotator Value;
+			Value.Pitch = ReadReal(bHalf);
+			Value.Yaw = ReadReal(bHalf);
+			Value.Roll = ReadReal(bHalf);
+			return Value;
+		}
+
+		FTransform ReadTransformValue(ESaveSpatialEncoding Encoding)
+		{
+			const bool bHalf = Encoding == ESaveSpatialEncoding::Half;
+			const bool bQuantized = Encoding == ESaveSpatialEncoding::Quantized;
+			const FQuat Rotation = bQuantized ? FSaveSpatialCodec::UnpackQuaternion(Read<uint32>()) : ReadQuaternion(bHalf);
+			const FVector Translation = ReadVector(false);
+			const FVector Scale = ReadVector(bHalf || bQuantized);
+			return FTransform(Rotation, Translation, Scale);
+		}
+	};
+}
+
+bool FSaveSpatialCodec::Encode(EDataType DataType, ESaveSpatialEncoding Encoding, TConstArrayView<uint8> ArchiveData, TArray<uint8>& OutCompactData)
+{
+	if (!IsSpatialType(DataType) || Encoding == ESaveSpatialEncoding::FileDefault || Encoding == ESaveSpatialEncoding::Archive)
+	{
+		return false;
+	}
+
+	const bool bHalf = Encoding == ESaveSpatialEncoding::Half;
+	const bool bQuantized = Encoding == ESaveSpatialEncoding::Quantized;
+
+	FMemoryReaderView Reader(ArchiveData, true);
+	OutCompactData.Reset();
+	FCompactWriter Writer{ OutCompactData };
+	Writer.Write<uint8>(static_cast<uint8>(Encoding));
+
+	switch (DataType)
+	{
+	case EDataType::VectorType:
+	{
+		FVector Value;
+		Reader << Value;
+		Writer.WriteVector(Value, bHalf);
+		break;
+	}
+	case EDataType::RotatorType:
+	{
+		FRotator Value;
+		Reader << Value;
+		if (bQuantized)
+		{
+			Writer.Write<uint32>(PackQuaternion(Value.Quaternion()));
+		}
+		else
+		{
+			Writer.WriteReal(Value.Pitch, bHalf);
+			Writer.WriteReal(Value.Yaw, bHalf);
+			Writer.WriteReal(Value.Roll, bHalf);
+		}
+		break;
+	}
+	default:
+	{
+		FTransform Value;
+		Reader << Value;
+		if (bQuantized)
+		{
+			Writer.Write<uint32>(PackQuaternion(Value.GetRotation()));
+		}
+		else
+		{
+			Writer.WriteQuaternion(Value.GetRotation(), bHalf);
+		}
+		Writer.WriteVector(Value.GetTranslation(), false);
+		Writer.WriteVector(Value.GetScale3D(), bHalf || bQuantized);
+		break;
+	}
+	}
+
+	// Anything but exactly one value of the data type is stored as is, rather than losing the bytes that do not fit
+	if (Reader.IsError() || !Reader.AtEnd())
+	{
+		OutCompactData.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveSpatialCodec::Decode(EDataType DataType, TConstArrayView<uint8> CompactData, TArray<uint8>& OutArchiveData, ESaveSpatialEncoding& OutEncoding)
+{
+	FCompactReader Reader{ CompactData };
+	if (!Reader.ReadEncoding(OutEncoding) || !IsSpatialType(DataType))
+	{
+		return false;
+	}
+
+	OutArchiveData.Reset();
+	FMemoryWriter Writer(OutArchiveData, true);
+
+	switch (DataType)
+	{
+	case EDataType::VectorType:
+	{
+		FVector Value = Reader.ReadVectorValue(OutEncoding);
+		Writer << Value;
+		break;
+	}
+	case EDataType::RotatorType:
+	{
+		FRotator Value = Reader.ReadRotatorValue(OutEncoding);
+		Writer << Value;
+		break;
+	}
+	default:
+	{
+		FTransform Value = Reader.ReadTransformValue(OutEncoding);
+		Writer << Value;
+		break;
+	}
+	}
+
+	return Reader.IsComplete();
+}
+
+bool FSaveSpatialCodec::DecodeValue(TConstArrayView<uint8> CompactData, FVector& OutValue)
+{
+	FCompactReader Reader{ CompactData };
+	ESaveSpatialEncoding Encoding;
+	if (!Reader.ReadEncoding(Encoding))
+	{
+		return false;
+	}
+
+	OutValue = Reader.ReadVectorValue(Encoding);
+	return Reader.IsComplete();
+}
+
+bool FSaveSpatialCodec::DecodeValue(TConstArrayView<uint8> CompactData, FRotator& OutValue)
+{
+	FCompactReader Reader{ CompactData };
+	ESaveSpatialEncoding Encoding;
+	if (!Reader.ReadEncoding(Encoding))
+	{
+		return false;
+	}
+
+	OutValue = Reader.ReadRotatorValue(Encoding);
+	return Reader.IsComplete();
+}
+
+bool FSaveSpatialCodec::DecodeValue(TConstArrayView<uint8> CompactData, FTransform& OutValue)
+{
+	FCompactReader Reader{ CompactData };
+	ESaveSpatialEncoding Encoding;
+	if (!Reader.ReadEncoding(Encoding))
+	{
+		return false;
+	}
+
+	OutValue = Reader.ReadTransformValue(Encoding);
+	return Reader.IsComplete();
+}
+
+uint32 FSaveSpatialCodec::PackQuaternion(FQuat Rotation)
+{
+	Rotation.Normalize();
+	const double Components[4] = { Rotation.X, Rotation.Y, Rotation.Z, Rotation.W };
+
+	int32 LargestIndex = 0;
+	for (int32 Index = 1; Index < 4; ++Index)
+	{
+		if (FMath::Abs(Components[Index]) > FMath::Abs(Components[LargestIndex]))
+		{
+			LargestIndex = Index;
+		}
+	}
+
+	// q and -q are the same rotation, flip the quaternion so the dropped component is positive
+	const double Sign = Components[LargestIndex] < 0.0 ? -1.0 : 1.0;
+
+	uint32 PackedRotation = static_cast<uint32>(LargestIndex);
+	for (int32 Index = 0; Index < 4; ++Index)
+	{
+		if (Index != LargestIndex)
+		{
+			const double Normalized = (Components[Index] * Sign / QuaternionComponentRange + 1.0) * 0.5;
+			const uint32 Quantized = static_cast<uint32>(FMath::RoundToInt(FMath::Clamp(Normalized, 0.0, 1.0) * QuaternionComponentMask));
+			PackedRotation = (PackedRotation << QuaternionComponentBits) | Quantized;
+		}
+	}
+
+	return PackedRotation;
+}
+
+FQuat FSaveSpatialCodec::UnpackQuaternion(uint32 PackedRotation)
+{
+	const int32 LargestIndex = static_cast<int32>(PackedRotation >> (3 * QuaternionComponentBits));
+
+	// Components were packed in ascending order, so the last one sits in the lowest bits
+	double Components[4] = {};
+	double SumOfSquares = 0.0;
+	for (int32 Index = 3; Index >= 0; --Index)
+	{
+		if (Index != LargestIndex)
+		{
+			const double Normalized = static_cast<double>(PackedRotation & QuaternionComponentMask) / QuaternionComponentMask;
+			Components[Index] = (Normalized * 2.0 - 1.0) * QuaternionComponentRange;
+			SumOfSquares += Components[Index] * Components[Index];
+			PackedRotation >>= QuaternionComponentBits;
+		}
+	}
+
+	Components[LargestIndex] = FMath::Sqrt(FMath::Max(1.0 - SumOfSquares, 0.0));
+
+	FQuat Rotation(Components[0], Components[1], Components[2], Components[3]);
+	Rotation.Normalize();
+	return Rotation;
+}
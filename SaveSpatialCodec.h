@@ -0,0 +1,82 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SaveLoadManager.h"
+
+
+/**
+ * \struct FSaveSpatialCodec
+ * \brief Converts vector, rotator and transform payloads between their archive layout and the compact encodings of ESaveSpatialEncoding.
+ *
+ * The compact layout starts with the ESaveSpatialEncoding (uint8), followed by the components:
+ * - Vector: 3 floats, or 3 halves for Half.
+ * - Rotator: pitch, yaw and roll as 3 floats, as 3 halves for Half, or a 32-bit smallest-three quaternion for Quantized.
+ * - Transform: the rotation quaternion as 4 floats, 4 halves for Half or a 32-bit smallest-three quaternion for Quantized, then the translation as 3 floats, then the scale as
+ *   3 floats, or 3 halves for Half and Quantized.
+ *
+ * A quantized quaternion stores the index of its largest component in 2 bits and the three others in 10 bits each. The largest component is rebuilt from the unit length.
+ */
+struct FSaveSpatialCodec
+{
+	/** \brief Returns true for the data types that have compact encodings. */
+	static bool IsSpatialType(EDataType DataType)
+	{
+		return DataType == EDataType::VectorType || DataType == EDataType::RotatorType || DataType == EDataType::TransformType;
+	}
+
+	/**
+	 * \brief Converts a payload in archive layout to a compact encoding.
+	 * \param DataType The data type of the payload.
+	 * \param Encoding The encoding to use.
+	 * \param ArchiveData The payload as written by the archive.
+	 * \param OutCompactData Receives the compact payload.
+	 * \return False if the data type has no compact encoding, Encoding is Archive, or the payload does not hold exactly one value of the data type. The payload is then stored as is.
+	 */
+	static bool Encode(EDataType DataType, ESaveSpatialEncoding Encoding, TConstArrayView<uint8> ArchiveData, TArray<uint8>& OutCompactData);
+
+	/**
+	 * \brief Converts a compact payload back to its archive layout.
+	 * \param DataType The data type of the payload.
+	 * \param CompactData The compact payload.
+	 * \param OutArchiveData Receives the payload as the archive would write it.
+	 * \param OutEncoding Receives the encoding the payload was stored with.
+	 * \return False if the compact payload is corrupted.
+	 */
+	static bool Decode(EDataType DataType, TConstArrayView<uint8> CompactData, TArray<uint8>& OutArchiveData, ESaveSpatialEncoding& OutEncoding);
+
+	/**
+	 * \brief Decodes a compact payload straight into a value, without going through the archive layout. Used by the codecs of USaveLoadManager::LoadValue.
+	 * \param CompactData The compact payload of a vector entry.
+	 * \param OutValue Receives the decoded value.
+	 * \return False if the compact payload is corrupted.
+	 */
+	static bool DecodeValue(TConstArrayView<uint8> CompactData, FVector& OutValue);
+
+	/** \brief Same as the overload above, for the compact payload of a rotator entry. */
+	static bool DecodeValue(TConstArrayView<uint8> CompactData, FRotator& OutValue);
+
+	/** \brief Same as the overload above, for the compact payload of a transform entry. */
+	static bool DecodeValue(TConstArrayView<uint8> CompactData, FTransform& OutValue);
+
+	/** \brief Returns the size of the archive layout of a vector, rotator or transform, which Decode always expands a compact payload to. Zero for other data types. */
+	static int32 GetArchiveSize(EDataType DataType)
+	{
+		switch (DataType)
+		{
+		case EDataType::VectorType:
+			return 3 * sizeof(FVector::FReal);
+		case EDataType::RotatorType:
+			return 3 * sizeof(FRotator::FReal);
+		case EDataType::TransformType:
+			return 10 * sizeof(FTransform::FReal);
+		default:
+			return 0;
+		}
+	}
+
+	/** \brief Packs a rotation into a 32-bit smallest-three quaternion. */
+	static uint32 PackQuaternion(FQuat Rotation);
+
+	/** \brief Unpacks a 32-bit smallest-three quaternion. */
+	static FQuat UnpackQuaternion(uint32 PackedRotation);
+};
@@ -0,0 +1,183 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SaveCodec.h"
+#include "SaveLoadManager.h"
+#include "SaveSpatialCodec.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include <type_traits>
+
+
+/**
+ * \struct TSaveCodec
+ * \brief Compile-time encoder of a value type, used by USaveLoadManager::SaveValue and USaveLoadManager::LoadValue.
+ *
+ * Every specialization provides the data type it is stored as and two functions:
+ * - static void Encode(const ValueType& Value, TArray<uint8>& OutBytes), which appends the bytes of the value.
+ * - static bool Decode(TConstArrayView<uint8> Bytes, ValueType& OutValue), which returns false if the bytes do not hold a value.
+ *
+ * The bytes match the ones of the matching ToByteArray converter, so values saved either way load back through the other. The primary template is left undefined, so saving or
+ * loading a type without a codec fails to compile.
+ *
+ * Codecs stored as VectorType, RotatorType or TransformType also provide static bool DecodeCompact(TConstArrayView<uint8> Bytes, ValueType& OutValue), which decodes the
+ * compact payload of an entry stored with an ESaveSpatialEncoding other than Archive.
+ *
+ * User types are supported by specializing TSaveCodec for them. Types that already serialize through operator<< can simply derive from TSaveArchiveCodec:
+ * \code
+ * template <>
+ * struct TSaveCodec<FInventorySlot> : TSaveArchiveCodec<FInventorySlot> {};
+ * \endcode
+ */
+template <typename ValueType, typename Enable>
+struct TSaveCodec;
+
+
+/**
+ * \struct TSaveFixedWidthValueCodec
+ * \brief Codec of a primitive value, encoded by FSaveFixedWidthCodec with a single allocation of the exact size.
+ */
+template <typename ValueType, EDataType InDataType>
+struct TSaveFixedWidthValueCodec
+{
+	static constexpr EDataType DataType = InDataType;
+
+	static void Encode(ValueType Value, TArray<uint8>& OutBytes)
+	{
+		const int32 Offset = OutBytes.AddUninitialized(FSaveFixedWidthCodec::GetSize<ValueType>());
+		FSaveFixedWidthCodec::Encode(Value, MakeArrayView(OutBytes).RightChop(Offset));
+	}
+
+	static bool Decode(TConstArrayView<uint8> Bytes, ValueType& OutValue)
+	{
+		return FSaveFixedWidthCodec::Decode(Bytes, OutValue);
+	}
+};
+
+
+/**
+ * \struct TSaveArchiveCodec
+ * \brief Codec of a value that serializes through operator<<, written straight into the output array by a memory writer.
+ *
+ * User structs derive their TSaveCodec from this to be stored as EDataType::CustomType.
+ */
+template <typename ValueType, EDataType InDataType = EDataType::CustomType>
+struct TSaveArchiveCodec
+{
+	static constexpr EDataType DataType = InDataType;
+
+	static void Encode(const ValueType& Value, TArray<uint8>& OutBytes)
+	{
+		// Appends behind any bytes already in the array
+		FMemoryWriter MemoryWriter(OutBytes, true, true);
+		MemoryWriter << const_cast<ValueType&>(Value);
+	}
+
+	static bool Decode(TConstArrayView<uint8> Bytes, ValueType& OutValue)
+	{
+		FMemoryReaderView MemoryReader(Bytes, true);
+		MemoryReader << OutValue;
+		return !MemoryReader.IsError();
+	}
+};
+
+
+template <>
+struct TSaveCodec<float> : TSaveFixedWidthValueCodec<float, EDataType::FloatType> {};
+
+template <>
+struct TSaveCodec<double> : TSaveFixedWidthValueCodec<double, EDataType::DoubleType> {};
+
+template <>
+struct TSaveCodec<bool> : TSaveFixedWidthValueCodec<bool, EDataType::BoolType> {};
+
+template <>
+struct TSaveCodec<int32> : TSaveFixedWidthValueCodec<int32, EDataType::IntType> {};
+
+template <>
+struct TSaveCodec<uint8> : TSaveFixedWidthValueCodec<uint8, EDataType::EnumType> {};
+
+template <>
+struct TSaveCodec<FString> : TSaveArchiveCodec<FString, EDataType::FStringType> {};
+
+
+/**
+ * \struct TSaveSpatialValueCodec
+ * \brief Codec of a vector, rotator or transform, stored in archive layout and decoded by FSaveSpatialCodec when the entry was stored compact.
+ */
+template <typename ValueType, EDataType InDataType>
+struct TSaveSpatialValueCodec : TSaveArchiveCodec<ValueType, InDataType>
+{
+	static bool DecodeCompact(TConstArrayView<uint8> Bytes, ValueType& OutValue)
+	{
+		return FSaveSpatialCodec::DecodeValue(Bytes, OutValue);
+	}
+};
+
+template <>
+struct TSaveCodec<FVector> : TSaveSpatialValueCodec<FVector, EDataType::VectorType> {};
+
+template <>
+struct TSaveCodec<FRotator> : TSaveSpatialValueCodec<FRotator, EDataType::RotatorType> {};
+
+template <>
+struct TSaveCodec<FTransform> : TSaveSpatialValueCodec<FTransform, EDataType::TransformType> {};
+
+
+/**
+ * \struct TSavePackedArrayValueCodec
+ * \brief Codec of a homogeneous array, stored as one packed block by FSavePackedArrayCodec.
+ */
+template <typename ElementType, EDataType InDataType>
+struct TSavePackedArrayValueCodec
+{
+	static constexpr EDataType DataType = InDataType;
+
+	static void Encode(const TArray<ElementType>& Value, TArray<uint8>& OutBytes)
+	{
+		FSavePackedArrayCodec::Encode(MakeArrayView(Value), OutBytes);
+	}
+
+	static bool Decode(TConstArrayView<uint8> Bytes, TArray<ElementType>& OutValue)
+	{
+		return FSavePackedArrayCodec::Decode(Bytes, OutValue);
+	}
+};
+
+template <>
+struct TSaveCodec<TArray<float>> : TSavePackedArrayValueCodec<float, EDataType::FloatArrayType> {};
+
+template <>
+struct TSaveCodec<TArray<FVector>> : TSavePackedArrayValueCodec<FVector, EDataType::VectorArrayType> {};
+
+template <>
+struct TSaveCodec<TArray<FTransform>> : TSavePackedArrayValueCodec<FTransform, EDataType::TransformArrayType> {};
+
+
+/**
+ * \brief Codec of every enum, stored as the single byte that ByteArrayToEnum reads back.
+ */
+template <typename EnumType>
+struct TSaveCodec<EnumType, std::enable_if_t<std::is_enum_v<EnumType>>>
+{
+	static_assert(sizeof(EnumType) == sizeof(uint8), "Only enums with a uint8 underlying type can be stored as EnumType.");
+
+	static constexpr EDataType DataType = EDataType::EnumType;
+
+	static void Encode(EnumType Value, TArray<uint8>& OutBytes)
+	{
+		TSaveCodec<uint8>::Encode(static_cast<uint8>(Value), OutBytes);
+	}
+
+	static bool Decode(TConstArrayView<uint8> Bytes, EnumType& OutValue)
+	{
+		uint8 EnumValue = 0;
+		if (!TSaveCodec<uint8>::Decode(Bytes, EnumValue))
+		{
+			return false;
+		}
+
+		OutValue = static_cast<EnumType>(EnumValue);
+		return true;
+	}
+};